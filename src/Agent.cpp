@@ -2,7 +2,7 @@
 #include "InsectAI.h"
 
 namespace InsectAI {
-	Agent::Agent() {
+	Agent::Agent() : m_KeepSenses(false), m_UpdateDue(true), m_UpdateLevel(0), m_ElapsedTime(0) {
 	}
 
 	Agent::~Agent() {
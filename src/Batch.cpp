@@ -0,0 +1,173 @@
+
+#include "Batch.h"
+#include "BrainDescription.h"
+#include "World.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+static double Seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BatchExperiment::BatchExperiment() :
+	brainType(8), pBrain(0), maxSpeed(0), population(20), seed(1), ticks(1800), dt(1.0f / 60.0f),
+	width(1000.0f), height(600.0f),
+	reachRadius(20.0f), contactRadius(10.0f)
+{
+}
+
+BatchResult::BatchResult() :
+	firstReach(-1.0f), meanReach(-1.0f), reached(0), meanClosest(0), collisions(0), wallSeconds(0)
+{
+}
+
+BatchRunner::BatchRunner(int threadCount)
+: m_ThreadCount(threadCount)
+{
+	if (m_ThreadCount <= 0) {
+		m_ThreadCount = PMath::Max(1, (int) std::thread::hardware_concurrency());
+	}
+}
+
+void BatchRunner::Add(const BatchExperiment& experiment)
+{
+	m_Experiments.push_back(experiment);
+}
+
+void BatchRunner::Clear()
+{
+	m_Experiments.clear();
+	m_Results.clear();
+}
+
+BatchResult BatchRunner::RunExperiment(const BatchExperiment& experiment)
+{
+	BatchResult result;
+	result.experiment = experiment;
+	double start = Seconds();
+
+	World world;
+	world.Seed(experiment.seed);
+	world.SetBounds(experiment.width, experiment.height);
+	if (experiment.pBrain) {
+		world.CreatePopulation(experiment.brainType, 0);
+		world.SpawnVehicles(*experiment.pBrain, experiment.population);
+	}
+	else {
+		world.CreatePopulation(experiment.brainType, experiment.population);
+	}
+
+	int count = world.GetEntityCount();
+	if (experiment.maxSpeed > 0.0f) {
+		for (int i = 0; i < count; ++i) {
+			if (world.GetEntityState(i).m_Vehicle) {
+				world.GetEntityState(i).m_Vehicle->mMaxSpeed = experiment.maxSpeed;
+			}
+		}
+	}
+	std::vector<float> reachTime(count, -1.0f);
+	std::vector<float> closest(count, 1.0e30f);
+	std::vector<bool> inContact(count, false);
+	float reachSquared = experiment.reachRadius * experiment.reachRadius;
+	float totalReach = 0.0f;
+
+	for (int tick = 1; tick <= experiment.ticks; ++tick) {
+		world.Step(experiment.dt);
+		float time = tick * experiment.dt;
+
+		for (int i = 0; i < count; ++i) {
+			const PhysState& state = world.GetEntityState(i);
+			if (state.m_Kind != World::kVehicle)
+				continue;
+
+			if (reachTime[i] < 0.0f) {
+				for (int l = 0; l < world.GetLightCount(); ++l) {
+					PhysState const& light = world.GetEntityState(world.GetLight(l));
+					float distanceSquared = state.DistanceSquared(&light);
+					closest[i] = PMath::Min(closest[i], distanceSquared);
+					if (distanceSquared < reachSquared) {
+						reachTime[i] = time;
+						totalReach += time;
+						if (result.reached == 0) {
+							result.firstReach = time;
+						}
+						++result.reached;
+						break;
+					}
+				}
+			}
+
+			// count the onset of each contact, not every tick spent touching
+			bool touching = world.m_pNN->FindNearestNeighbour(state.GetPosition(), experiment.contactRadius, World::kVehicle, &state) != 0;
+			if (touching && !inContact[i]) {
+				++result.collisions;
+			}
+			inContact[i] = touching;
+		}
+	}
+
+	if (result.reached > 0) {
+		result.meanReach = totalReach / result.reached;
+	}
+	int vehicles = 0;
+	for (int i = 0; i < count; ++i) {
+		if (world.GetEntityState(i).m_Kind == World::kVehicle) {
+			result.meanClosest += sqrtf(closest[i]);
+			++vehicles;
+		}
+	}
+	if (vehicles > 0) {
+		result.meanClosest /= vehicles;
+	}
+	result.wallSeconds = Seconds() - start;
+	return result;
+}
+
+double BatchRunner::Run()
+{
+	double start = Seconds();
+	int count = (int) m_Experiments.size();
+	m_Results.assign(count, BatchResult());
+
+	// each worker claims the next unrun experiment, and writes only its result slot
+	std::atomic<int> next(0);
+	int threadCount = PMath::Min(m_ThreadCount, count);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threadCount; ++t) {
+		workers.push_back(std::thread([this, &next, count]() {
+			for (int i = next++; i < count; i = next++) {
+				m_Results[i] = RunExperiment(m_Experiments[i]);
+			}
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); ++t) {
+		workers[t].join();
+	}
+
+	return Seconds() - start;
+}
+
+bool BatchRunner::WriteCSV(const char* path) const
+{
+	FILE* pFile = fopen(path, "w");
+	if (!pFile) {
+		return false;
+	}
+
+	fprintf(pFile, "experiment,brain,population,seed,ticks,dt,first_reach_s,mean_reach_s,reached,mean_closest,collisions,wall_ms\n");
+	for (size_t i = 0; i < m_Results.size(); ++i) {
+		const BatchResult& r = m_Results[i];
+		const BatchExperiment& e = r.experiment;
+		// a described brain has no topology number, so it is written as -1
+		fprintf(pFile, "%d,%d,%d,%u,%d,%g,%g,%g,%d,%g,%d,%.3f\n",
+				(int) i, e.pBrain ? -1 : (int) e.brainType, e.population, e.seed, e.ticks, e.dt,
+				r.firstReach, r.meanReach, r.reached, r.meanClosest, r.collisions, r.wallSeconds * 1000.0);
+	}
+
+	bool ok = !ferror(pFile);
+	fclose(pFile);
+	return ok;
+}
@@ -0,0 +1,83 @@
+
+/** @file	Batch.h
+	@brief	Runs many independent simulations concurrently, and gathers a result from each
+	*/
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "PMath.h"
+
+#include <vector>
+
+class BrainDescription;
+
+/// @struct	BatchExperiment
+/// @brief	Describes one short simulation: a single light in the middle of the world,
+///			and a population of vehicles sharing one of the test brains or a described brain
+struct BatchExperiment {
+	BatchExperiment();
+
+	uint32	brainType;			///< the World::BuildTestBrain topology of every vehicle
+	BrainDescription const*	pBrain;	///< the brain of every vehicle instead, if not null; not owned
+	float	maxSpeed;			///< the top speed of every vehicle, if above zero
+	int		population;			///< number of vehicles
+	uint32	seed;				///< seed of the world's random number stream
+	int		ticks;				///< number of steps to simulate
+	float	dt;					///< seconds per step
+	float	width, height;		///< extent of the world
+	float	reachRadius;		///< a vehicle has reached the light when it is this close to it
+	float	contactRadius;		///< vehicles closer than this to each other are colliding
+};
+
+/// @struct	BatchResult
+/// @brief	The metrics gathered from one BatchExperiment
+struct BatchResult {
+	BatchResult();
+
+	BatchExperiment	experiment;
+	float			firstReach;		///< seconds until the first vehicle reached the light, or -1
+	float			meanReach;		///< mean seconds to reach the light over the vehicles that did, or -1
+	int				reached;		///< number of vehicles that reached the light
+	float			meanClosest;	///< mean over every vehicle of its closest approach to a light
+	int				collisions;		///< number of times a vehicle came into contact with another
+	double			wallSeconds;	///< real time spent running the experiment
+};
+
+/** @class	BatchRunner
+	@brief	Steps many independent worlds on a pool of threads.
+			Every experiment builds its own Engine, World and NearestNeighbours, and owns its
+			random number stream, so the workers share nothing but the index of the next
+			experiment to run. Results are deterministic regardless of the number of threads.
+	*/
+
+class BatchRunner {
+public:
+	/// @param threadCount	number of worker threads, or zero for one per hardware thread
+	explicit BatchRunner(int threadCount = 0);
+
+	void	Add(const BatchExperiment& experiment);
+	void	Clear();
+
+	/// Run every experiment that has been added
+	/// @return the wall clock seconds taken
+	double	Run();
+
+	int		GetThreadCount() const { return m_ThreadCount; }
+	const std::vector<BatchResult>& GetResults() const { return m_Results; }
+
+	/// Write one row per experiment, in the order they were added; the brain column is -1 for
+	/// an experiment run with a described brain
+	/// @return false if the file could not be written
+	bool	WriteCSV(const char* path) const;
+
+	/// Run a single experiment on the calling thread
+	static BatchResult RunExperiment(const BatchExperiment& experiment);
+
+private:
+	int								m_ThreadCount;
+	std::vector<BatchExperiment>	m_Experiments;
+	std::vector<BatchResult>		m_Results;
+};
+
+#endif
@@ -0,0 +1,569 @@
+
+#include "BrainDescription.h"
+#include "InsectAI.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using InsectAI::Actuator;
+using InsectAI::CollisionSensor;
+using InsectAI::FieldSensor;
+using InsectAI::Function;
+using InsectAI::LightSensor;
+using InsectAI::Sensor;
+using InsectAI::Switch;
+using InsectAI::Vehicle;
+
+// The binary form. As in a snapshot, every record is a fixed size, four byte aligned POD, and
+// every section is found through an offset from the start, so a mapped file is used as it is.
+
+static const uint32 kBrainMagic		= 'IBrn';
+static const uint32 kBrainVersion	= 3;
+
+struct BrainHeader {
+	uint32	magic;
+	uint32	version;
+	uint32	size;					///< of the whole description in bytes, header included
+	uint32	sensorCount,	sensorOffset;
+	uint32	actuatorCount,	actuatorOffset;
+	uint32	inputCount,		inputOffset;
+	uint32	weightCount,	weightOffset;
+};
+
+enum {
+	kDirectional		= 1
+};
+
+struct BrainSensor {
+	uint32	kind;					///< Sensor::GetKind
+	uint32	function;				///< Function::mFunction
+	float	radius;					///< sensitive radius of light and collision sensors, antenna length of field sensors
+	float	angle;					///< antenna angle of field sensors, rate of buffers
+	float	gain;					///< gain of field sensors, slope of sigmoids
+	uint32	flags;
+	uint32	firstInput,		inputCount;		///< a Switch's inputs are control, A, B
+};
+
+struct BrainActuator {
+	uint32	kind;
+	float	lag;					///< Actuator::SetDynamics
+	float	rateLimit;
+	uint32	firstInput,		inputCount;		///< the inputs it mixes
+	uint32	firstWeight;			///< a weight for each input
+};
+
+// input table entries are sensor indices within the brain; the weight table holds the
+// actuators' input weights
+
+template <class Record>
+static Record const* Section(void const* pData, uint32 offset) {
+	return (Record const*) ((unsigned char const*) pData + offset);
+}
+
+static size_t Align(size_t offset) {
+	return (offset + 7) & ~(size_t) 7;
+}
+
+BrainDescription::BrainDescription()
+: m_pData(0), m_Size(0), m_pMapping(0), m_MappingSize(0)
+{
+	m_Error[0] = 0;
+}
+
+BrainDescription::~BrainDescription()
+{
+	Clear();
+}
+
+void BrainDescription::Clear()
+{
+#ifndef _WIN32
+	if (m_pMapping) {
+		munmap(m_pMapping, m_MappingSize);
+	}
+#endif
+	m_pMapping = 0;
+	m_MappingSize = 0;
+	m_Buffer.clear();
+	m_pData = 0;
+	m_Size = 0;
+}
+
+bool BrainDescription::Fail(int line, const char* pReason)
+{
+	if (line > 0) {
+		snprintf(m_Error, sizeof(m_Error), "line %d: %s", line, pReason);
+	}
+	else {
+		snprintf(m_Error, sizeof(m_Error), "%s", pReason);
+	}
+	Clear();
+	return false;
+}
+
+namespace {
+	/// A sensor as parsed, before its inputs are resolved from names to indices
+	struct ParsedSensor {
+		BrainSensor					record;
+		std::string					name;
+		std::vector<std::string>	inputs;
+		int							line;
+	};
+
+	struct ParsedActuator {
+		uint32						kind;
+		std::vector<std::string>	inputs;
+		std::vector<float>			weights;
+		float						lag, rateLimit;
+		int							line;
+	};
+
+	/// Split a line at white space, dropping any comment
+	void Tokenize(std::string const& line, std::vector<std::string>& tokens) {
+		tokens.clear();
+		size_t end = line.find('#');
+		if (end == std::string::npos) {
+			end = line.size();
+		}
+		size_t i = 0;
+		while (i < end) {
+			while (i < end && isspace((unsigned char) line[i])) ++i;
+			size_t start = i;
+			while (i < end && !isspace((unsigned char) line[i])) ++i;
+			if (i > start) {
+				tokens.push_back(line.substr(start, i - start));
+			}
+		}
+	}
+
+	bool ParseNumber(std::string const& token, float& value) {
+		char* pEnd;
+		value = strtof(token.c_str(), &pEnd);
+		return !token.empty() && *pEnd == 0;
+	}
+}
+
+bool BrainDescription::Parse(const char* pText)
+{
+	Clear();
+	m_Error[0] = 0;
+
+	std::vector<ParsedSensor> sensors;
+	std::vector<ParsedActuator> actuators;
+	std::vector<std::string> tokens;
+
+	int lineNumber = 0;
+	for (const char* p = pText; *p; ) {
+		const char* pEnd = strchr(p, '\n');
+		if (!pEnd) {
+			pEnd = p + strlen(p);
+		}
+		std::string line(p, pEnd);
+		p = *pEnd ? pEnd + 1 : pEnd;
+		++lineNumber;
+
+		Tokenize(line, tokens);
+		if (tokens.empty())
+			continue;
+
+		std::string const& type = tokens[0];
+
+		uint32 actuatorKind = 0;
+		if (type == "motor")			actuatorKind = Actuator::kMotor;
+		else if (type == "steering")	actuatorKind = Actuator::kSteering;
+		else if (type == "deposit")		actuatorKind = Actuator::kDeposit;
+		if (actuatorKind) {
+			ParsedActuator a;
+			a.kind = actuatorKind;
+			a.lag = a.rateLimit = 0.0f;
+			a.line = lineNumber;
+			for (size_t i = 1; i < tokens.size(); ++i) {
+				float weight;
+				if (tokens[i] == "lag" || tokens[i] == "rate") {
+					float* pValue = tokens[i] == "lag" ? &a.lag : &a.rateLimit;
+					if (++i == tokens.size() || !ParseNumber(tokens[i], *pValue) || *pValue < 0.0f)
+						return Fail(lineNumber, "the setting needs a number of at least 0");
+				}
+				else if (ParseNumber(tokens[i], weight)) {
+					if (a.inputs.empty() || a.weights.size() == a.inputs.size())
+						return Fail(lineNumber, "a weight follows the input it weighs");
+					a.weights.push_back(weight);
+				}
+				else {
+					if (a.weights.size() < a.inputs.size()) {
+						a.weights.push_back(1.0f);
+					}
+					a.inputs.push_back(tokens[i]);
+				}
+			}
+			if (a.inputs.empty())
+				return Fail(lineNumber, "an actuator names at least one input");
+			if (a.weights.size() < a.inputs.size()) {
+				a.weights.push_back(1.0f);
+			}
+			actuators.push_back(a);
+			continue;
+		}
+
+		if (tokens.size() < 2)
+			return Fail(lineNumber, "a sensor needs a name");
+
+		ParsedSensor s;
+		memset(&s.record, 0, sizeof(s.record));
+		s.name = tokens[1];
+		s.line = lineNumber;
+		for (size_t i = 0; i < sensors.size(); ++i) {
+			if (sensors[i].name == s.name)
+				return Fail(lineNumber, "the name is already used");
+		}
+
+		if (type == "light" || type == "collision" || type == "field") {
+			bool light = type == "light", collision = type == "collision";
+			s.record.kind = light ? LightSensor::GetStaticKind() : collision ? CollisionSensor::GetStaticKind() : FieldSensor::GetStaticKind();
+
+			// the test brains' defaults, in widths of the world
+			s.record.radius = light ? 1.0f : collision ? 0.1f : 0.02f;
+			s.record.angle = 0.6f;
+			s.record.gain = 1.0f;
+			for (size_t i = 2; i < tokens.size(); ++i) {
+				if (light && tokens[i] == "directional") {
+					s.record.flags |= kDirectional;
+					continue;
+				}
+				float* pValue = 0;
+				if ((light || collision) && tokens[i] == "radius")	pValue = &s.record.radius;
+				else if (!light && !collision) {
+					if (tokens[i] == "length")			pValue = &s.record.radius;
+					else if (tokens[i] == "angle")		pValue = &s.record.angle;
+					else if (tokens[i] == "gain")		pValue = &s.record.gain;
+				}
+				if (!pValue)
+					return Fail(lineNumber, "unknown sensor setting");
+				if (++i == tokens.size() || !ParseNumber(tokens[i], *pValue))
+					return Fail(lineNumber, "the setting needs a number");
+			}
+		}
+		else if (type == "buffer" || type == "invert" || type == "sigmoid") {
+			s.record.kind = Function::GetStaticKind();
+			s.record.function = type == "buffer" ? Function::kBuffer : type == "invert" ? Function::kInvert : Function::kSigmoid;
+			s.record.angle = 4.0f;
+			s.record.gain = 24.0f;
+			for (size_t i = 2; i < tokens.size(); ++i) {
+				float* pValue = 0;
+				if (type == "buffer" && tokens[i] == "rate")			pValue = &s.record.angle;
+				else if (type == "sigmoid" && tokens[i] == "slope")	pValue = &s.record.gain;
+				if (!pValue) {
+					s.inputs.push_back(tokens[i]);
+					continue;
+				}
+				if (++i == tokens.size() || !ParseNumber(tokens[i], *pValue))
+					return Fail(lineNumber, "the setting needs a number");
+			}
+			if (s.inputs.empty())
+				return Fail(lineNumber, "a function needs at least one input");
+		}
+		else if (type == "switch") {
+			if (tokens.size() != 5)
+				return Fail(lineNumber, "a switch names its control and two inputs");
+			s.record.kind = Switch::GetStaticKind();
+			s.inputs.assign(tokens.begin() + 2, tokens.end());
+		}
+		else {
+			return Fail(lineNumber, "unknown node type");
+		}
+		sensors.push_back(s);
+	}
+
+	if (sensors.empty() && actuators.empty())
+		return Fail(0, "the brain is empty");
+
+	// resolve the wiring now that every sensor is declared
+	std::vector<BrainSensor> sensorRecords;
+	std::vector<BrainActuator> actuatorRecords;
+	std::vector<int> inputs;
+	std::vector<float> weights;
+	for (size_t i = 0; i < sensors.size(); ++i) {
+		BrainSensor r = sensors[i].record;
+		r.firstInput = (uint32) inputs.size();
+		for (size_t in = 0; in < sensors[i].inputs.size(); ++in) {
+			int index = -1;
+			for (size_t j = 0; j < sensors.size() && index < 0; ++j) {
+				if (sensors[j].name == sensors[i].inputs[in]) {
+					index = (int) j;
+				}
+			}
+			if (index < 0)
+				return Fail(sensors[i].line, "an input names no sensor");
+			inputs.push_back(index);
+		}
+		r.inputCount = (uint32) inputs.size() - r.firstInput;
+		sensorRecords.push_back(r);
+	}
+	for (size_t i = 0; i < actuators.size(); ++i) {
+		BrainActuator r;
+		r.kind = actuators[i].kind;
+		r.lag = actuators[i].lag;
+		r.rateLimit = actuators[i].rateLimit;
+		r.firstInput = (uint32) inputs.size();
+		r.inputCount = (uint32) actuators[i].inputs.size();
+		r.firstWeight = (uint32) weights.size();
+		for (size_t in = 0; in < actuators[i].inputs.size(); ++in) {
+			int index = -1;
+			for (size_t j = 0; j < sensors.size() && index < 0; ++j) {
+				if (sensors[j].name == actuators[i].inputs[in]) {
+					index = (int) j;
+				}
+			}
+			if (index < 0)
+				return Fail(actuators[i].line, "an input names no sensor");
+			inputs.push_back(index);
+			weights.push_back(actuators[i].weights[in]);
+		}
+		actuatorRecords.push_back(r);
+	}
+
+	BrainHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = kBrainMagic;
+	h.version = kBrainVersion;
+
+	size_t offset = Align(sizeof(h));
+	h.sensorCount = (uint32) sensorRecords.size();
+	h.sensorOffset = (uint32) offset;
+	offset = Align(offset + sensorRecords.size() * sizeof(BrainSensor));
+	h.actuatorCount = (uint32) actuatorRecords.size();
+	h.actuatorOffset = (uint32) offset;
+	offset = Align(offset + actuatorRecords.size() * sizeof(BrainActuator));
+	h.inputCount = (uint32) inputs.size();
+	h.inputOffset = (uint32) offset;
+	offset = Align(offset + inputs.size() * sizeof(int));
+	h.weightCount = (uint32) weights.size();
+	h.weightOffset = (uint32) offset;
+	offset = Align(offset + weights.size() * sizeof(float));
+	h.size = (uint32) offset;
+
+	m_Buffer.assign(offset, 0);
+	unsigned char* p = &m_Buffer[0];
+	memcpy(p, &h, sizeof(h));
+	if (!sensorRecords.empty())		memcpy(p + h.sensorOffset, &sensorRecords[0], sensorRecords.size() * sizeof(BrainSensor));
+	if (!actuatorRecords.empty())	memcpy(p + h.actuatorOffset, &actuatorRecords[0], actuatorRecords.size() * sizeof(BrainActuator));
+	if (!inputs.empty())			memcpy(p + h.inputOffset, &inputs[0], inputs.size() * sizeof(int));
+	if (!weights.empty())			memcpy(p + h.weightOffset, &weights[0], weights.size() * sizeof(float));
+
+	m_pData = p;
+	m_Size = offset;
+	return true;
+}
+
+bool BrainDescription::ParseFile(const char* path)
+{
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile)
+		return Fail(0, "could not open the file");
+
+	std::string text;
+	char chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), pFile)) > 0) {
+		text.append(chunk, read);
+	}
+	fclose(pFile);
+	return Parse(text.c_str());
+}
+
+bool BrainDescription::Write(const char* path) const
+{
+	if (!m_pData)
+		return false;
+
+	FILE* pFile = fopen(path, "wb");
+	if (!pFile)
+		return false;
+	bool written = fwrite(m_pData, 1, m_Size, pFile) == m_Size;
+	return (fclose(pFile) == 0) && written;
+}
+
+bool BrainDescription::Load(void const* pData, size_t size)
+{
+	Clear();
+	if (!pData || size < sizeof(BrainHeader))
+		return false;
+
+	m_Buffer.assign((unsigned char const*) pData, (unsigned char const*) pData + size);
+	m_pData = &m_Buffer[0];
+	m_Size = size;
+	if (!IsValid()) {
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+bool BrainDescription::Map(const char* path)
+{
+	Clear();
+
+#ifdef _WIN32
+	// no mapping here; read the file instead, the instantiation is the same
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile)
+		return false;
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	if (size > 0) {
+		m_Buffer.resize(size);
+		if (fread(&m_Buffer[0], 1, size, pFile) != (size_t) size) {
+			m_Buffer.clear();
+		}
+	}
+	fclose(pFile);
+	if (m_Buffer.empty())
+		return false;
+	m_pData = &m_Buffer[0];
+	m_Size = m_Buffer.size();
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void* pMapping = mmap(0, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pMapping == MAP_FAILED)
+		return false;
+
+	m_pMapping = pMapping;
+	m_MappingSize = (size_t) info.st_size;
+	m_pData = pMapping;
+	m_Size = m_MappingSize;
+#endif
+
+	if (!IsValid()) {
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+int BrainDescription::GetSensorCount() const
+{
+	return m_pData ? (int) ((BrainHeader const*) m_pData)->sensorCount : 0;
+}
+
+int BrainDescription::GetActuatorCount() const
+{
+	return m_pData ? (int) ((BrainHeader const*) m_pData)->actuatorCount : 0;
+}
+
+bool BrainDescription::IsValid() const
+{
+	if (!m_pData || m_Size < sizeof(BrainHeader))
+		return false;
+
+	BrainHeader const* h = (BrainHeader const*) m_pData;
+	if (h->magic != kBrainMagic || h->version != kBrainVersion || h->size != m_Size)
+		return false;
+
+	// every section must lie within the description
+	if ((size_t) h->sensorOffset + (size_t) h->sensorCount * sizeof(BrainSensor) > m_Size)			return false;
+	if ((size_t) h->actuatorOffset + (size_t) h->actuatorCount * sizeof(BrainActuator) > m_Size)		return false;
+	if ((size_t) h->inputOffset + (size_t) h->inputCount * sizeof(int) > m_Size)						return false;
+	if ((size_t) h->weightOffset + (size_t) h->weightCount * sizeof(float) > m_Size)					return false;
+
+	// and the wiring must stay within the brain, so Instantiate need not check it
+	BrainSensor const* pSensors = Section<BrainSensor>(m_pData, h->sensorOffset);
+	BrainActuator const* pActuators = Section<BrainActuator>(m_pData, h->actuatorOffset);
+	int const* pInputs = Section<int>(m_pData, h->inputOffset);
+	for (uint32 i = 0; i < h->inputCount; ++i) {
+		if (pInputs[i] < 0 || (uint32) pInputs[i] >= h->sensorCount)		return false;
+	}
+	for (uint32 i = 0; i < h->sensorCount; ++i) {
+		BrainSensor const& r = pSensors[i];
+		if ((size_t) r.firstInput + r.inputCount > h->inputCount)		return false;
+		if (r.kind == Function::GetStaticKind() && r.inputCount == 0)		return false;
+		if (r.kind == Switch::GetStaticKind() && r.inputCount != 3)		return false;
+		if (r.kind != LightSensor::GetStaticKind() && r.kind != CollisionSensor::GetStaticKind() &&
+			r.kind != FieldSensor::GetStaticKind() && r.kind != Function::GetStaticKind() &&
+			r.kind != Switch::GetStaticKind())
+			return false;
+	}
+	for (uint32 i = 0; i < h->actuatorCount; ++i) {
+		BrainActuator const& r = pActuators[i];
+		if (r.inputCount == 0 || (size_t) r.firstInput + r.inputCount > h->inputCount)	return false;
+		if ((size_t) r.firstWeight + r.inputCount > h->weightCount)		return false;
+	}
+	return true;
+}
+
+bool BrainDescription::Instantiate(Vehicle* pVehicle, float lengthScale) const
+{
+	if (!m_pData)
+		return false;
+
+	BrainHeader const* h = (BrainHeader const*) m_pData;
+	BrainSensor const* pSensors = Section<BrainSensor>(m_pData, h->sensorOffset);
+	BrainActuator const* pActuators = Section<BrainActuator>(m_pData, h->actuatorOffset);
+	int const* pInputs = Section<int>(m_pData, h->inputOffset);
+	float const* pWeights = Section<float>(m_pData, h->weightOffset);
+
+	pVehicle->AllocBrain(h->sensorCount, h->actuatorCount);
+
+	// create all the sensors first, so that the wiring can refer to any of them
+	for (uint32 s = 0; s < h->sensorCount; ++s) {
+		BrainSensor const& r = pSensors[s];
+		Sensor* pSensor;
+		if (r.kind == LightSensor::GetStaticKind())				pSensor = new LightSensor((r.flags & kDirectional) != 0, r.radius * lengthScale);
+		else if (r.kind == CollisionSensor::GetStaticKind())	pSensor = new CollisionSensor(r.radius * lengthScale);
+		else if (r.kind == FieldSensor::GetStaticKind())		pSensor = new FieldSensor(r.radius * lengthScale, r.angle, r.gain);
+		else if (r.kind == Switch::GetStaticKind())				pSensor = new Switch();
+		else {
+			Function* pFunction = new Function(r.function);
+			pFunction->mRate = r.angle;
+			pFunction->mSlope = r.gain;
+			pSensor = pFunction;
+		}
+		pVehicle->AddSensor(pSensor);
+	}
+
+	for (uint32 s = 0; s < h->sensorCount; ++s) {
+		BrainSensor const& r = pSensors[s];
+		int const* pIn = pInputs + r.firstInput;
+		Sensor* pSensor = pVehicle->GetSensor(s);
+		if (r.kind == Function::GetStaticKind()) {
+			for (uint32 in = 0; in < r.inputCount; ++in) {
+				((Function*) pSensor)->AddInput(pVehicle->GetSensor(pIn[in]));
+			}
+		}
+		else if (r.kind == Switch::GetStaticKind()) {
+			((Switch*) pSensor)->SetControl(pVehicle->GetSensor(pIn[0]));
+			((Switch*) pSensor)->SetInputs(pVehicle->GetSensor(pIn[1]), pVehicle->GetSensor(pIn[2]));
+		}
+	}
+
+	for (uint32 a = 0; a < h->actuatorCount; ++a) {
+		BrainActuator const& r = pActuators[a];
+		Actuator* pActuator = new Actuator(r.kind);
+		for (uint32 in = 0; in < r.inputCount; ++in) {
+			pActuator->AddInput(pVehicle->GetSensor(pInputs[r.firstInput + in]), pWeights[r.firstWeight + in]);
+		}
+		pActuator->SetDynamics(r.lag, r.rateLimit);
+		pVehicle->AddActuator(pActuator);
+	}
+	return true;
+}
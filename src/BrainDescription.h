@@ -0,0 +1,99 @@
+
+/** @file	BrainDescription.h
+	@brief	Vehicle brains described as data, in a text form for authoring and a binary form for deployment
+	*/
+
+#ifndef _BRAINDESCRIPTION_H_
+#define _BRAINDESCRIPTION_H_
+
+#include "PMath.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace InsectAI {
+	class Vehicle;
+}
+
+/** @class	BrainDescription
+	@brief	The sensors, functions, switches and actuators of a brain, and their wiring, as one
+			flat block of fixed size records addressed by offsets, laid out as a Snapshot is.
+			Parsing the text form builds the block; Write saves it, and Map maps a saved block
+			and uses it in place, so a deployed brain is never parsed. One description builds
+			any number of vehicles.
+
+			The text form has one node per line, and # starts a comment:
+
+			@code
+			collision	avoid	radius 0.1
+			light		seek	directional
+			switch		choose	avoid seek avoid	# control, then the inputs below and above 1/2
+			motor		choose
+			@endcode
+
+			Sensors are "light name [directional] [radius r]", "collision name [radius r]" and
+			"field name [length l] [angle a] [gain g]". Functions are "buffer", "invert" and
+			"sigmoid", each a name and one or more inputs, and then "rate r" for a buffer, 4 by
+			default, or "slope s" for a sigmoid, 24 by default; a switch is a name, its control and
+			its two inputs. Actuators are "motor", "steering" and "deposit" and name one or more
+			inputs, each optionally followed by its weight, which is otherwise 1, then optionally
+			"lag t" and "rate r" for their dynamics, as in "motor seek 0.5 avoid 0.5 lag 0.2".
+			Sensors are added in the order they are declared, and may refer to sensors declared
+			after them. Lengths are in units given when the brain is instantiated, such as the
+			width of the world
+	*/
+
+class BrainDescription {
+public:
+	BrainDescription();
+	~BrainDescription();
+
+	/// Build the description from its text form
+	/// @return false if the text is invalid, with the reason in GetError
+	bool	Parse(const char* pText);
+
+	/// Parse the text form from a file
+	bool	ParseFile(const char* path);
+
+	/// Write the binary form to a file
+	bool	Write(const char* path) const;
+
+	/// Map a file written by Write; the description refers to the mapping until it is released
+	bool	Map(const char* path);
+
+	/// Copy the binary form out of memory
+	bool	Load(void const* pData, size_t size);
+
+	/// Release the description's memory or mapping
+	void	Clear();
+
+	void const*	GetData() const { return m_pData; }
+	size_t		GetSize() const { return m_Size; }
+	const char*	GetError() const { return m_Error; }
+
+	int		GetSensorCount() const;
+	int		GetActuatorCount() const;
+
+	/// @return true if the data is a complete description of the current version, whose wiring
+	/// refers only to its own sensors
+	bool	IsValid() const;
+
+	/// Give a vehicle without a brain this one, with every length multiplied by lengthScale
+	/// @return false if the description is empty
+	bool	Instantiate(InsectAI::Vehicle* pVehicle, float lengthScale) const;
+
+private:
+	BrainDescription(BrainDescription const&);
+	BrainDescription& operator=(BrainDescription const&);
+
+	bool	Fail(int line, const char* pReason);
+
+	std::vector<unsigned char>	m_Buffer;		///< storage for parsed or loaded descriptions
+	void const*					m_pData;
+	size_t						m_Size;
+	void*						m_pMapping;		///< non null while a file is mapped
+	size_t						m_MappingSize;
+	char						m_Error[128];
+};
+
+#endif
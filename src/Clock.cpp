@@ -49,7 +49,7 @@
 
 
 #include "Clock.h"
-#include <raylib.h>
+#include <chrono>
 
 
 // ----------------------------------------------------------------------------
@@ -200,7 +200,10 @@ void Clock::advanceSimulationTime (const float seconds)
 
 TimeVal Clock::realTimeSinceFirstClockUpdate()
 {
-    return GetTime();
+    // steady_clock rather than a windowing library's timer, so that headless
+    // simulations can use the clock too
+    static const std::chrono::steady_clock::time_point first = std::chrono::steady_clock::now();
+    return (TimeVal) std::chrono::duration<double>(std::chrono::steady_clock::now() - first).count();
 }
 
 // ----------------------------------------------------------------------------
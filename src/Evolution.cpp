@@ -0,0 +1,298 @@
+
+#include "Evolution.h"
+#include "Batch.h"
+#include "BrainDescription.h"
+#include "InsectAI.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+using InsectAI::Function;
+
+// The checkpoint format: a header, then the genomes of the generation to be scored next
+
+static const uint32 kCheckpointMagic	= 'IEvo';
+static const uint32 kCheckpointVersion	= 1;
+
+struct CheckpointHeader {
+	uint32				magic;
+	uint32				version;
+	EvolutionSettings	settings;
+	uint32				randomState;
+	int					generation;
+	int					evaluations;
+	int					genomeCount;
+};
+
+// the range of each gene
+static const float kMinLightRadius = 0.2f,		kMaxLightRadius = 2.0f;
+static const float kMinCollisionRadius = 0.02f,	kMaxCollisionRadius = 0.3f;
+static const float kMinSlope = 2.0f,			kMaxSlope = 48.0f;
+static const float kMinRate = 0.5f,				kMaxRate = 16.0f;
+static const float kMinSpeed = 0.3f,			kMaxSpeed = 2.0f;
+
+static const uint32 kFunctions[] = { 0, Function::kBuffer, Function::kInvert, Function::kSigmoid };
+
+static uint32 RandomFunction() {
+	return kFunctions[PMath::Min((int) (PMath::randf() * 4.0f), 3)];
+}
+
+/// Scale a gene by up to half again or a third less, within its range
+static float Perturb(float gene, float minValue, float maxValue) {
+	return PMath::Clamp(gene * expf(PMath::randf(-0.4f, 0.4f)), minValue, maxValue);
+}
+
+void Genome::Randomize()
+{
+	function = RandomFunction();
+	flags = (PMath::randf() < 0.5f ? kDirectional : 0) | (PMath::randf() < 0.5f ? kAvoids : 0);
+	lightRadius = PMath::randf(kMinLightRadius, kMaxLightRadius);
+	collisionRadius = PMath::randf(kMinCollisionRadius, kMaxCollisionRadius);
+	slope = PMath::randf(kMinSlope, kMaxSlope);
+	rate = PMath::randf(kMinRate, kMaxRate);
+	maxSpeed = PMath::randf(kMinSpeed, kMaxSpeed);
+}
+
+void Genome::Mutate(float probability)
+{
+	if (PMath::randf() < probability)	function = RandomFunction();
+	if (PMath::randf() < probability)	flags ^= kDirectional;
+	if (PMath::randf() < probability)	flags ^= kAvoids;
+	if (PMath::randf() < probability)	lightRadius = Perturb(lightRadius, kMinLightRadius, kMaxLightRadius);
+	if (PMath::randf() < probability)	collisionRadius = Perturb(collisionRadius, kMinCollisionRadius, kMaxCollisionRadius);
+	if (PMath::randf() < probability)	slope = Perturb(slope, kMinSlope, kMaxSlope);
+	if (PMath::randf() < probability)	rate = Perturb(rate, kMinRate, kMaxRate);
+	if (PMath::randf() < probability)	maxSpeed = Perturb(maxSpeed, kMinSpeed, kMaxSpeed);
+}
+
+Genome Genome::Cross(Genome const& a, Genome const& b)
+{
+	Genome child;
+	child.function = PMath::randf() < 0.5f ? a.function : b.function;
+	child.flags = ((PMath::randf() < 0.5f ? a.flags : b.flags) & kDirectional) |
+				  ((PMath::randf() < 0.5f ? a.flags : b.flags) & kAvoids);
+	child.lightRadius = PMath::randf() < 0.5f ? a.lightRadius : b.lightRadius;
+	child.collisionRadius = PMath::randf() < 0.5f ? a.collisionRadius : b.collisionRadius;
+	child.slope = PMath::randf() < 0.5f ? a.slope : b.slope;
+	child.rate = PMath::randf() < 0.5f ? a.rate : b.rate;
+	child.maxSpeed = PMath::randf() < 0.5f ? a.maxSpeed : b.maxSpeed;
+	return child;
+}
+
+std::string Genome::Describe() const
+{
+	// nine significant digits carry a float through the text exactly
+	char line[128];
+	std::string text;
+	snprintf(line, sizeof(line), "light\t\tseek\t%sradius %.9g\n", (flags & kDirectional) ? "directional " : "", lightRadius);
+	text += line;
+
+	const char* pDrive = "seek";
+	if (function == Function::kBuffer)			snprintf(line, sizeof(line), "buffer\t\tdrive\tseek rate %.9g\n", rate);
+	else if (function == Function::kInvert)		snprintf(line, sizeof(line), "invert\t\tdrive\tseek\n");
+	else if (function == Function::kSigmoid)	snprintf(line, sizeof(line), "sigmoid\t\tdrive\tseek slope %.9g\n", slope);
+	if (function) {
+		text += line;
+		pDrive = "drive";
+	}
+
+	if (flags & kAvoids) {
+		snprintf(line, sizeof(line), "collision\tavoid\tradius %.9g\n", collisionRadius);
+		text += line;
+		snprintf(line, sizeof(line), "switch\t\tchoose\tavoid %s avoid\n", pDrive);
+		text += line;
+		pDrive = "choose";
+	}
+
+	snprintf(line, sizeof(line), "motor\t\t%s\n", pDrive);
+	text += line;
+	return text;
+}
+
+EvolutionSettings::EvolutionSettings() :
+	genomes(64), elites(4), tournament(3), mutation(0.2f), seed(1),
+	trials(2), vehicles(8), ticks(600), threads(0)
+{
+}
+
+Evolution::Evolution(EvolutionSettings const& settings)
+: m_Settings(settings)
+{
+	Reset();
+}
+
+void Evolution::Reset()
+{
+	m_RandomState = PMath::RandomSeed(m_Settings.seed);
+	m_Generation = 0;
+	m_Evaluations = 0;
+	m_Scored.clear();
+	m_Fitness.clear();
+
+	PMath::RandomScope random(m_RandomState);
+	m_Genomes.resize(PMath::Max(m_Settings.genomes, 1));
+	for (size_t i = 0; i < m_Genomes.size(); ++i) {
+		m_Genomes[i].Randomize();
+	}
+}
+
+double Evolution::Step()
+{
+	int count = (int) m_Genomes.size();
+	int trials = PMath::Max(m_Settings.trials, 1);
+
+	std::vector<BrainDescription> brains(count);
+	BatchRunner runner(m_Settings.threads);
+	for (int g = 0; g < count; ++g) {
+		brains[g].Parse(m_Genomes[g].Describe().c_str());
+		for (int t = 0; t < trials; ++t) {
+			// every genome of a generation meets the same worlds
+			BatchExperiment experiment;
+			experiment.pBrain = &brains[g];
+			experiment.maxSpeed = m_Genomes[g].maxSpeed;
+			experiment.population = m_Settings.vehicles;
+			experiment.ticks = m_Settings.ticks;
+			experiment.seed = PMath::RandomSeed(m_Settings.seed * 2654435761u + (uint32) m_Generation * 40503u + (uint32) t);
+			runner.Add(experiment);
+		}
+	}
+	double seconds = runner.Run();
+
+	// reaching the light scores one, and up to one more for reaching it at once; the closest
+	// approach scores up to a half, and contacts with other vehicles cost a little
+	std::vector<BatchResult> const& results = runner.GetResults();
+	m_Fitness.assign(count, 0.0f);
+	for (int g = 0; g < count; ++g) {
+		float fitness = 0.0f;
+		for (int t = 0; t < trials; ++t) {
+			BatchResult const& r = results[g * trials + t];
+			BatchExperiment const& e = r.experiment;
+			float vehicles = (float) PMath::Max(e.population, 1);
+			float duration = e.ticks * e.dt;
+			if (r.reached > 0) {
+				fitness += (r.reached / vehicles) * (2.0f - r.meanReach / duration);
+			}
+			fitness += 0.5f * PMath::Max(0.0f, 1.0f - r.meanClosest / (0.5f * e.width));
+			fitness -= 0.01f * r.collisions / vehicles;
+		}
+		m_Fitness[g] = fitness / trials;
+	}
+	m_Scored = m_Genomes;
+	m_Evaluations += count * trials;
+	++m_Generation;
+
+	// the elites survive as they are, and the rest of the next generation are mutated children
+	std::vector<int> ranked(count);
+	for (int g = 0; g < count; ++g) {
+		ranked[g] = g;
+	}
+	std::stable_sort(ranked.begin(), ranked.end(), [this](int a, int b) { return m_Fitness[a] > m_Fitness[b]; });
+
+	PMath::RandomScope random(m_RandomState);
+	int elites = PMath::Clamp(m_Settings.elites, 0, count);
+	for (int g = 0; g < count; ++g) {
+		if (g < elites) {
+			m_Genomes[g] = m_Scored[ranked[g]];
+			continue;
+		}
+		Genome const& a = m_Scored[Tournament()];
+		Genome const& b = m_Scored[Tournament()];
+		m_Genomes[g] = Genome::Cross(a, b);
+		m_Genomes[g].Mutate(m_Settings.mutation);
+	}
+	return seconds;
+}
+
+int Evolution::Tournament()
+{
+	int count = (int) m_Scored.size();
+	int best = -1;
+	for (int i = 0; i < PMath::Max(m_Settings.tournament, 1); ++i) {
+		int g = PMath::Min((int) (PMath::randf() * count), count - 1);
+		if (best < 0 || m_Fitness[g] > m_Fitness[best]) {
+			best = g;
+		}
+	}
+	return best;
+}
+
+Genome const& Evolution::GetBest() const
+{
+	static Genome const kNone = Genome();
+	if (m_Fitness.empty())
+		return kNone;
+	return m_Scored[std::max_element(m_Fitness.begin(), m_Fitness.end()) - m_Fitness.begin()];
+}
+
+float Evolution::GetBestFitness() const
+{
+	return m_Fitness.empty() ? 0.0f : *std::max_element(m_Fitness.begin(), m_Fitness.end());
+}
+
+float Evolution::GetMeanFitness() const
+{
+	float sum = 0.0f;
+	for (size_t g = 0; g < m_Fitness.size(); ++g) {
+		sum += m_Fitness[g];
+	}
+	return m_Fitness.empty() ? 0.0f : sum / m_Fitness.size();
+}
+
+bool Evolution::SaveCheckpoint(const char* path) const
+{
+	FILE* pFile = fopen(path, "wb");
+	if (!pFile)
+		return false;
+
+	CheckpointHeader h = CheckpointHeader();
+	h.magic = kCheckpointMagic;
+	h.version = kCheckpointVersion;
+	h.settings = m_Settings;
+	h.settings.threads = 0;			// the machine's, not the run's
+	h.randomState = m_RandomState;
+	h.generation = m_Generation;
+	h.evaluations = m_Evaluations;
+	h.genomeCount = (int) m_Genomes.size();
+
+	bool ok = fwrite(&h, sizeof(h), 1, pFile) == 1;
+	ok = ok && fwrite(&m_Genomes[0], sizeof(Genome), m_Genomes.size(), pFile) == m_Genomes.size();
+	ok = (fclose(pFile) == 0) && ok;
+	return ok;
+}
+
+bool Evolution::LoadCheckpoint(const char* path)
+{
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile)
+		return false;
+
+	// the genomes must fill the rest of the file, which bounds their count
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+
+	CheckpointHeader h;
+	bool ok = size >= (long) sizeof(h) && fread(&h, sizeof(h), 1, pFile) == 1 &&
+			  h.magic == kCheckpointMagic && h.version == kCheckpointVersion && h.genomeCount > 0 &&
+			  (size_t) h.genomeCount == (size - sizeof(h)) / sizeof(Genome);
+	std::vector<Genome> genomes;
+	if (ok) {
+		genomes.resize(h.genomeCount);
+		ok = fread(&genomes[0], sizeof(Genome), genomes.size(), pFile) == genomes.size();
+	}
+	fclose(pFile);
+	if (!ok)
+		return false;
+
+	int threads = m_Settings.threads;
+	m_Settings = h.settings;
+	m_Settings.threads = threads;
+	m_Settings.genomes = h.genomeCount;
+	m_RandomState = PMath::RandomSeed(h.randomState);
+	m_Generation = h.generation;
+	m_Evaluations = h.evaluations;
+	m_Genomes.swap(genomes);
+	m_Scored.clear();
+	m_Fitness.clear();
+	return true;
+}
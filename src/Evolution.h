@@ -0,0 +1,120 @@
+
+/** @file	Evolution.h
+	@brief	Evolves vehicle brains by selection and mutation, scoring them in parallel worlds
+	*/
+
+#ifndef _EVOLUTION_H_
+#define _EVOLUTION_H_
+
+#include "PMath.h"
+
+#include <string>
+#include <vector>
+
+/// @struct	Genome
+/// @brief	A brain's topology and parameters. A light sensor feeds an optional function, a
+///			buffer, an inverter or a sigmoid, which drives the motor; a genome that avoids puts a
+///			collision sensor and a switch in between, turning the vehicle away from whatever it
+///			is about to hit, as test brain 8 does. Lengths are in widths of the world
+struct Genome {
+	enum {
+		kDirectional	= 1,		///< the light sensor steers towards the light
+		kAvoids			= 2			///< a collision sensor takes over the motor when close
+	};
+
+	uint32	function;				///< Function::kBuffer, kInvert or kSigmoid, or 0 for none
+	uint32	flags;
+	float	lightRadius;
+	float	collisionRadius;
+	float	slope;					///< Function::mSlope of a sigmoid
+	float	rate;					///< Function::mRate of a buffer
+	float	maxSpeed;				///< Vehicle::mMaxSpeed
+
+	/// A genome drawn at random from the current random stream
+	void		Randomize();
+
+	/// Change each gene with the given probability, drawing from the current random stream
+	void		Mutate(float probability);
+
+	/// A genome taking each gene from one parent or the other
+	static Genome	Cross(Genome const& a, Genome const& b);
+
+	/// The brain in the text form of a BrainDescription
+	std::string	Describe() const;
+};
+
+/// @struct	EvolutionSettings
+/// @brief	The size of the population, how each genome is scored, and how the next generation
+///			is bred
+struct EvolutionSettings {
+	EvolutionSettings();
+
+	int		genomes;				///< per generation
+	int		elites;					///< the best genomes, carried into the next generation unchanged
+	int		tournament;				///< genomes drawn to choose each parent, the fittest winning
+	float	mutation;				///< the probability that a gene of a child changes
+	uint32	seed;					///< of the first generation and of every draw since
+	int		trials;					///< worlds each genome is scored in, the same worlds for every genome
+	int		vehicles;				///< of the genome in each world
+	int		ticks;					///< simulated in each world
+	int		threads;				///< running the worlds, or zero for one per hardware thread
+};
+
+/** @class	Evolution
+	@brief	Breeds generations of genomes. Each genome of a generation is scored in the same
+			few worlds, run in parallel by a BatchRunner: a light in the middle and a handful of
+			vehicles with the genome's brain. Vehicles score for reaching the light, and for
+			reaching it sooner, or for how close they came. The fittest genomes are kept and the
+			rest replaced by mutated crosses of tournament winners.
+			Every draw comes from the evolution's own random stream, and the worlds' seeds from
+			the settings' seed and the generation, so a run is the same on any number of
+			threads, and a run resumed from a checkpoint is the same as one never stopped
+	*/
+
+class Evolution {
+public:
+	explicit Evolution(EvolutionSettings const& settings);
+
+	/// Start again from a random first generation
+	void	Reset();
+
+	/// Score the current generation and breed the next from it
+	/// @return the wall clock seconds the scoring took
+	double	Step();
+
+	int		GetGeneration() const					{ return m_Generation; }
+	int		GetEvaluationCount() const				{ return m_Evaluations; }
+	EvolutionSettings const& GetSettings() const	{ return m_Settings; }
+
+	/// The generation last scored, and its fitnesses, in the same order
+	std::vector<Genome> const&	GetScored() const	{ return m_Scored; }
+	std::vector<float> const&	GetFitness() const	{ return m_Fitness; }
+
+	/// The fittest genome of the generation last scored, and its fitness
+	Genome const&	GetBest() const;
+	float			GetBestFitness() const;
+	float			GetMeanFitness() const;
+
+	/// Save the generation to be scored next and the random stream, with the settings
+	/// @return false if the file could not be written
+	bool	SaveCheckpoint(const char* path) const;
+
+	/// Carry on from a checkpoint, replacing the settings with those it was saved with, but
+	/// for the thread count
+	/// @return false, leaving the evolution as it was, if the file is not a valid checkpoint
+	bool	LoadCheckpoint(const char* path);
+
+private:
+	/// The index of the fittest of a few genomes of the scored generation, drawn at random
+	int		Tournament();
+
+	EvolutionSettings	m_Settings;
+	uint32				m_RandomState;
+	int					m_Generation;		///< the number of generations scored
+	int					m_Evaluations;		///< worlds run, over every generation
+	std::vector<Genome>	m_Genomes;			///< the generation to be scored next
+	std::vector<Genome>	m_Scored;
+	std::vector<float>	m_Fitness;
+};
+
+#endif
@@ -1,27 +1,81 @@
 
 #include "InsectAI.h"
+#include "Profiler.h"
 
+#include <algorithm>
 #include <map>
+#include <vector>
 
 namespace InsectAI {
-static uint32 UniqueID()
-{
-	static uint32 id = 0;
-	return ++id;
-}
 
 typedef std::map<int, Entity*> EntityMap;		//!< maps unique IDs to RigidBody pointers.
+typedef std::vector<Entity*> EntityList;
 
 /// @class	EngineAux
 /// @brief	Extra data for the agent manager, not exposed in the header file
 class EngineAux {
 public:
-	EngineAux() { }
+	static bool ByKind(Actuator const* pA, Actuator const* pB) { return pA->GetKind() < pB->GetKind(); }
+
+	EngineAux() : mLastID(0), mTick(0), mpPriority(0), mLevels(1), mUpdated(0), mbActuatorsDirty(true) { }
 	~EngineAux() { }
 
+	/// Each engine numbers its own entities, so independent engines share no state
+	uint32 UniqueID() { return ++mLastID; }
+
+	/// Replace an entity in the visiting order, or append it if it isn't there
+	void Insert(Entity* pOld, Entity* pEntity) {
+		for (size_t i = 0; pOld && i < mOrder.size(); ++i) {
+			if (mOrder[i] == pOld) {
+				mOrder[i] = pEntity;
+				return;
+			}
+		}
+		mOrder.push_back(pEntity);
+	}
+
+	/// Gather the actuators with dynamics from every agent, grouped by kind
+	void CollectActuators() {
+		mDynamicActuators.clear();
+		for (size_t i = 0; i < mOrder.size(); ++i) {
+			if (!(mOrder[i]->GetKind() & kKindAgent))
+				continue;
+			Agent* pAgent = (Agent*) mOrder[i];
+			for (int a = 0; a < pAgent->GetActuatorCount(); ++a) {
+				if (pAgent->GetActuator(a)->HasDynamics()) {
+					mDynamicActuators.push_back(pAgent->GetActuator(a));
+				}
+			}
+		}
+		std::stable_sort(mDynamicActuators.begin(), mDynamicActuators.end(), ByKind);
+		mbActuatorsDirty = false;
+	}
+
 	EntityMap mEntities;
+	EntityList mOrder;			//!< the entities in the order the phases visit them
+	uint32 mLastID;
+	uint32 mTick;				//!< ticks scheduled
+	UpdatePriority* mpPriority;
+	int mLevels;
+	int mUpdated;				//!< agents due in the current tick
+	std::vector<Actuator*> mDynamicActuators;	//!< the actuators with dynamics, a kind at a time
+	bool mbActuatorsDirty;		//!< the entities changed since the actuators were collected
 };
 
+int FocusPriority::GetUpdateLevel(Agent* pAgent)
+{
+	Real const* pPosition = pAgent->GetDynamicState()->GetPosition();
+	float dx = pPosition[0] - mFocus[0];
+	float dy = pPosition[1] - mFocus[1];
+	float distanceSquared = dx * dx + dy * dy;
+
+	int level = 0;
+	for (float limit = mNearDistance * mNearDistance; distanceSquared > limit && level < 16; limit *= 4.0f) {
+		++level;
+	}
+	return level;
+}
+
 Engine::Engine()
 {
 	m_pAux = new EngineAux();
@@ -35,11 +89,33 @@ Engine::~Engine()
 
 int Engine::AddEntity(Entity* pEntity)
 {
-	uint32 id				= UniqueID();
+	uint32 id				= m_pAux->UniqueID();
 	m_pAux->mEntities[id]		= pEntity;				// add it to the sim
+	m_pAux->mOrder.push_back(pEntity);
+	m_pAux->mbActuatorsDirty = true;
 	return id;
 }
 
+void Engine::AddEntity(Entity* pEntity, int id)
+{
+	m_pAux->Insert(GetEntity(id), pEntity);
+	m_pAux->mEntities[id]		= pEntity;
+	m_pAux->mbActuatorsDirty = true;
+	if ((uint32) id > m_pAux->mLastID) {
+		m_pAux->mLastID = id;
+	}
+}
+
+uint32 Engine::GetLastID() const
+{
+	return m_pAux->mLastID;
+}
+
+void Engine::SetLastID(uint32 id)
+{
+	m_pAux->mLastID = id;
+}
+
 Entity* Engine::GetEntity(int id)
 {
     auto it = m_pAux->mEntities.find(id);
@@ -51,44 +127,195 @@ Entity* Engine::GetEntity(int id)
 
 void Engine::RemoveEntity(int id)
 {
-	if (m_pAux->mEntities.count(id) != 0) {
+	Entity* pEntity = GetEntity(id);
+	if (pEntity) {
 		m_pAux->mEntities.erase(id);
+		EntityList& order = m_pAux->mOrder;
+		for (size_t i = 0; i < order.size(); ++i) {
+			if (order[i] == pEntity) {
+				order.erase(order.begin() + i);
+				break;
+			}
+		}
+		m_pAux->mbActuatorsDirty = true;
 	}
 }
 
 void Engine::RemoveAllEntities()
 {
 	m_pAux->mEntities.clear();
+	m_pAux->mOrder.clear();
+	m_pAux->mDynamicActuators.clear();
+	m_pAux->mbActuatorsDirty = true;
+}
+
+bool Engine::SetEntityOrder(int const* pIDs, int count)
+{
+	if (count != (int) m_pAux->mEntities.size())
+		return false;
+
+	EntityList order;
+	order.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		Entity* pEntity = GetEntity(pIDs[i]);
+		if (!pEntity)
+			return false;
+		order.push_back(pEntity);
+	}
+	m_pAux->mOrder.swap(order);
+	return true;
+}
+
+void Engine::SetUpdatePriority(UpdatePriority* pPriority, int levels)
+{
+	m_pAux->mpPriority = pPriority;
+	m_pAux->mLevels = PMath::Clamp(levels, 1, 16);
+
+	// everything is brought up to date on the next tick
+	EntityList const& order = m_pAux->mOrder;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if (order[i]->GetKind() & kKindAgent) {
+			((Agent*) order[i])->m_UpdateLevel = 0;
+		}
+	}
+}
+
+int Engine::GetUpdatedCount() const
+{
+	return m_pAux->mUpdated;
+}
+
+int Engine::GetUpdateLevelCount(int level) const
+{
+	int count = 0;
+	EntityList const& order = m_pAux->mOrder;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if ((order[i]->GetKind() & kKindAgent) && ((Agent*) order[i])->m_UpdateLevel == level) {
+			++count;
+		}
+	}
+	return count;
 }
 
 void Engine::UpdateEntities(float dt, EntityDatabase* pDB)
 {
+	INSECTAI_PROFILE_SCOPE("UpdateEntities");
+	ScheduleAll(dt);
+	ClearAllSenses(dt);
+	SenseAll(pDB);
+	UpdateAll(dt);
+	IntegrateActuators(dt);
+}
+
+void Engine::ScheduleAll(float dt)
+{
+	INSECTAI_PROFILE_SCOPE("Schedule");
+	uint32 tick = ++m_pAux->mTick;
+	EntityList const& order = m_pAux->mOrder;
+	int updated = 0;
+
+	// an agent at level n is due when the tick and its place in the order agree in their low n bits
+	for (size_t i = 0; i < order.size(); ++i) {
+		Entity* pEntity = order[i];
+		if (pEntity->GetKind() & kKindAgent) {
+			Agent* pAgent = (Agent*) pEntity;
+			uint32 mask = (1u << pAgent->m_UpdateLevel) - 1;
+			pAgent->m_ElapsedTime += dt;
+			pAgent->m_UpdateDue = ((tick + (uint32) i) & mask) == 0;
+			if (pAgent->m_UpdateDue) {
+				++updated;
+			}
+		}
+	}
+	m_pAux->mUpdated = updated;
+}
+
+void Engine::ClearAllSenses(float dt)
+{
+	INSECTAI_PROFILE_SCOPE("ClearSenses");
 	Agent* pAgent;
-	EntityMap::iterator aIter;
-	EntityMap::iterator aIter2;
+	EntityList const& order = m_pAux->mOrder;
 
-	// clear senses
-	for (aIter = m_pAux->mEntities.begin(); aIter != m_pAux->mEntities.end(); ++aIter) {
-		Entity* pEntity = aIter->second;
+	for (size_t i = 0; i < order.size(); ++i) {
+		Entity* pEntity = order[i];
 		if (pEntity->GetKind() & kKindAgent) {
 			pAgent = (Agent*) pEntity;
-			pAgent->ClearSenses(dt);
+			if (pAgent->m_UpdateDue && !pAgent->GetKeepSenses()) {
+				pAgent->ClearSenses(dt);
+			}
 		}
 	}
+}
+
+void Engine::SenseAll(EntityDatabase* pDB)
+{
+	INSECTAI_PROFILE_SCOPE("Sense");
+	Agent* pAgent;
+	EntityList const& order = m_pAux->mOrder;
 
 	// publish stimuli to senses
-	for (aIter = m_pAux->mEntities.begin(); aIter != m_pAux->mEntities.end(); ++aIter) {
-		Entity* pAi = aIter->second;
+	for (size_t i = 0; i < order.size(); ++i) {
+		Entity* pAi = order[i];
 		if (pAi->GetKind() & kKindAgent) {
 			pAgent = (Agent*) pAi;
-			pAgent->Sense(pDB);
+			if (pAgent->m_UpdateDue && !pAgent->GetKeepSenses()) {
+				pAgent->Sense(pDB);
+			}
 		}
 	}
+}
+
+void Engine::UpdateAll(float dt)
+{
+	INSECTAI_PROFILE_SCOPE("Update");
+	EntityList const& order = m_pAux->mOrder;
+	UpdatePriority* pPriority = m_pAux->mpPriority;
+
+	for (size_t i = 0; i < order.size(); ++i) {
+		Entity* pEntity = order[i];
+		if (!(pEntity->GetKind() & kKindAgent)) {
+			pEntity->Update(dt);
+			continue;
+		}
+
+		// agents think with all the time that has passed since they last did
+		Agent* pAgent = (Agent*) pEntity;
+		if (!pAgent->m_UpdateDue)
+			continue;
+
+		pAgent->Update(pPriority ? pAgent->m_ElapsedTime : dt);
+		pAgent->m_ElapsedTime = 0;
+		if (pPriority) {
+			pAgent->m_UpdateLevel = PMath::Clamp(pPriority->GetUpdateLevel(pAgent), 0, m_pAux->mLevels - 1);
+		}
+	}
+}
+
+void Engine::InvalidateActuators()
+{
+	m_pAux->mbActuatorsDirty = true;
+}
+
+int Engine::GetDynamicActuatorCount()
+{
+	if (m_pAux->mbActuatorsDirty) {
+		m_pAux->CollectActuators();
+	}
+	return (int) m_pAux->mDynamicActuators.size();
+}
+
+void Engine::IntegrateActuators(float dt)
+{
+	INSECTAI_PROFILE_SCOPE("IntegrateActuators");
+	if (m_pAux->mbActuatorsDirty) {
+		m_pAux->CollectActuators();
+	}
 
-	// update agents
-	for (aIter = m_pAux->mEntities.begin(); aIter != m_pAux->mEntities.end(); ++aIter) {
-		Entity* pEntity = aIter->second;
-		pEntity->Update(dt);
+	// every agent's actuators advance every tick, so outputs stay smooth between the
+	// updates of agents at slower levels
+	std::vector<Actuator*> const& actuators = m_pAux->mDynamicActuators;
+	for (size_t i = 0; i < actuators.size(); ++i) {
+		actuators[i]->Integrate(dt);
 	}
 }
 
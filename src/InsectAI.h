@@ -37,6 +37,25 @@ namespace InsectAI {
 		virtual ~EntityDatabase() { }
 
 		virtual DynamicState* GetNearest(Entity*, uint32 filter) = 0;
+
+		/// The nearest entity ahead, within the half angle of the entity's heading whose cosine is
+		/// given, or anywhere within nearRadius. Databases without a sector query fall back to the nearest
+		virtual DynamicState* GetNearestInView(Entity* pE, uint32 filter, Real cosHalfAngle, Real nearRadius) {
+			return GetNearest(pE, filter);
+		}
+
+		/// The summed activation of every light at a position, for light sensors of the given
+		/// radius, and the vector they steer by, in world space
+		/// @return false if the database keeps no light field for that radius
+		virtual bool SampleLightField(Real const* pPosition, Real radius, Real& activation, Real* pSteering) {
+			return false;
+		}
+
+		/// The concentration of scent at a position
+		/// @return false if the database keeps no scent field
+		virtual bool SampleScent(Real const* pPosition, Real& concentration) {
+			return false;
+		}
 	};
 
 }	// end namespace InsectAI
@@ -1,38 +1,83 @@
 #ifndef __ACTUATOR_H_
 #define __ACTUATOR_H_
 
+#include <vector>
+
 namespace InsectAI {
 
 	class Sensor;
 
 	/// @class	Actuator
-	/// @brief	Actuators are things like steering wheels and motors
+	/// @brief	Actuators are things like steering wheels and motors.
+	///			An actuator drives towards a weighted mix of its inputs. Without dynamics its outputs
+	///			are the mix at once; with a lag or a rate limit they ease towards it, integrated by
+	///			the engine in one pass over every such actuator after the agents are updated
 	class Actuator {
 	public:
-		enum { kMotor = 'Motr', kSteering = 'Ster' };
+		enum { kMotor = 'Motr', kSteering = 'Ster', kDeposit = 'Dpst' };	///< a deposit lays scent, as much as its activation
 
 		Actuator(uint32 kind);
 		virtual ~Actuator();
 
+		/// Mix the inputs into the target
 		void	Update(float dt);
-		void	SetInput(Sensor* pSensor)	{ mpInput = pSensor; }
+
+		/// Make a sensor the only input, with a weight of one
+		void	SetInput(Sensor* pSensor);
+
+		/// Mix in another input; the first input added is also mpInput
+		void	AddInput(Sensor* pSensor, float weight);
+
+		int		GetInputCount() const		{ return (int) mInputs.size(); }
+		Sensor*	GetInput(int i) const		{ return mInputs[i]; }
+		float	GetInputWeight(int i) const	{ return mWeights[i]; }
+
+		/// @return true if any input changed since it was last propagated
+		bool	InputsChanged() const;
+
+		/// Ease the outputs towards the target, first-order with a time constant of lag seconds,
+		/// changing by at most rateLimit per second; 0 disables either. An actuator given
+		/// dynamics after its agent was added to an engine is integrated once the engine's
+		/// actuators are invalidated
+		void	SetDynamics(float lag, float rateLimit)	{ mLag = lag; mRateLimit = rateLimit; }
+		float	GetLag() const				{ return mLag; }
+		float	GetRateLimit() const		{ return mRateLimit; }
+		bool	HasDynamics() const			{ return mLag > 0.0f || mRateLimit > 0.0f; }
+
+		/// Advance the outputs towards the target by dt; a paused clock leaves them where they are
+		void	Integrate(float dt) {
+			if (dt <= 0.0f)
+				return;
+			float alpha = dt / (mLag + dt);		// implicit first-order step, stable for any dt
+			float limit = mRateLimit > 0.0f ? mRateLimit * dt : 1.0e30f;
+			mActivation += Step(alpha * (mTarget - mActivation), limit);
+			mSteeringActivation += Step(alpha * (mSteeringTarget - mSteeringActivation), limit);
+		}
+
 		uint32	GetKind() const				{ return mKind; }
 
         
 		Sensor*					mpInput;
 		float					mActivation, mSteeringActivation;
+		float					mTarget, mSteeringTarget;	///< the mix of the inputs
 
         virtual const char* name() const {
             switch (mKind) {
                 case kMotor: return "Motor";
                 case kSteering: return "Steering";
+                case kDeposit: return "Deposit";
                 default: return "Unknown Actuator";
             }
         }
 
         
 	protected:
+		static float	Step(float delta, float limit) { return delta > limit ? limit : (delta < -limit ? -limit : delta); }
+
 		uint32					mKind;
+		std::vector<Sensor*>	mInputs;
+		std::vector<float>		mWeights;
+		float					mLag, mRateLimit;
 	};
 
 } // end namespace InsectAI
@@ -69,6 +69,16 @@ namespace InsectAI {
 				Sensor*			GetSensor(int i) const		{ return m_Sensors[i]; }
 				Actuator*		GetActuator(int i) const	{ return m_Actuators[i]; }
 
+				/// A host that tracks what has moved sets this when nothing the agent senses has
+				/// changed since it last sensed; the engine then neither clears nor senses it again
+				void			SetKeepSenses(bool keep)	{ m_KeepSenses = keep; }
+				bool			GetKeepSenses() const		{ return m_KeepSenses; }
+
+				/// Kept by the engine's scheduler: whether the agent senses and thinks this tick,
+				/// and how often it does, as a level of Engine::SetUpdatePriority
+				bool			IsUpdateDue() const			{ return m_UpdateDue; }
+				int				GetUpdateLevel() const		{ return m_UpdateLevel; }
+
     static const  char* static_name() { return "Agent"; }
     virtual const char* name() const override { return static_name(); }
         
@@ -79,6 +89,13 @@ namespace InsectAI {
 				Actuator**		m_Actuators;
 				Sensor**		m_Sensors;
 				uint32			m_Kind;
+				bool			m_KeepSenses;
+
+	private:
+		friend class Engine;
+				bool			m_UpdateDue;
+				int				m_UpdateLevel;
+				float			m_ElapsedTime;				///< since the agent last thought
 	};
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
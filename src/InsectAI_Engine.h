@@ -10,6 +10,37 @@ namespace InsectAI {
 
 	class EngineAux;
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// @class	UpdatePriority
+/// @brief	Decides how often the engine has each agent sense and think. Agents are put in
+///			buckets by level: level 0 agents are updated every tick, level 1 every other tick,
+///			and level n every 2^n ticks, with the time since their last update
+	class UpdatePriority {
+	public:
+		virtual ~UpdatePriority() { }
+
+		/// Asked after each update of the agent, for the level until its next
+		virtual int		GetUpdateLevel(Agent* pAgent) = 0;
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// @class	FocusPriority
+/// @brief	Updates agents less often the further they are from a focus point, such as the
+///			camera: every tick within the near distance, and half as often for each doubling
+///			of the distance beyond it
+	class FocusPriority : public UpdatePriority {
+	public:
+		explicit FocusPriority(float nearDistance) : mNearDistance(nearDistance) { mFocus[0] = mFocus[1] = 0.0f; }
+
+		void	SetFocus(float x, float y)	{ mFocus[0] = x; mFocus[1] = y; }
+
+		virtual int		GetUpdateLevel(Agent* pAgent) override;
+
+	private:
+		float	mNearDistance;
+		float	mFocus[2];
+	};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 /// @class	Engine
 /// @brief	The AI simulator
@@ -22,10 +53,48 @@ namespace InsectAI {
 		/// @return the ID of the Entity
 		int		AddEntity(Entity* pEntity);
 
+		/// Add an Entity under an ID it was given earlier, as when restoring a saved simulation
+		void	AddEntity(Entity* pEntity, int id);
+
+		/// The most recently issued ID; save and restore it along with the entities so that
+		/// IDs issued after a restore don't collide with restored ones
+		uint32	GetLastID() const;
+		void	SetLastID(uint32 id);
+
 		void	RemoveEntity(int id);
 		void	RemoveAllEntities();
+
+		/// Set the order in which the phases visit the entities, which is otherwise the order
+		/// they were added in. A host can order them so that neighbours are sensed together.
+		/// @return false, leaving the order alone, unless the IDs are those of every entity
+		bool	SetEntityOrder(int const* pIDs, int count);
 		int		GetEntityCount();
 		void	UpdateEntities(float dt, EntityDatabase* pDB);
+
+		/// Update agents at the rates the priority chooses, which is not owned; 0 updates every
+		/// agent every tick. The slowest of the levels updates every 2^(levels-1) ticks.
+		/// Each level's agents are spread evenly over the ticks by their place in the visiting
+		/// order, so the load is the same every tick. Levels are not saved with the entities;
+		/// a restored agent starts at level 0
+		void	SetUpdatePriority(UpdatePriority* pPriority, int levels = 3);
+
+		/// The agents updated in the last tick, and the number at a level
+		int		GetUpdatedCount() const;
+		int		GetUpdateLevelCount(int level) const;
+
+		/// The phases of UpdateEntities, in the order it runs them.
+		/// They are exposed so that a host can time or interleave them; a host running them
+		/// itself starts every tick with ScheduleAll, which chooses the agents that are due
+		void	ScheduleAll(float dt);
+		void	ClearAllSenses(float dt);
+		void	SenseAll(EntityDatabase* pDB);
+		void	UpdateAll(float dt);
+		void	IntegrateActuators(float dt);
+
+		/// Collect the actuators with dynamics again before the next integration, as after
+		/// changing the dynamics of agents already added
+		void	InvalidateActuators();
+		int		GetDynamicActuatorCount();
         
         Entity* GetEntity(int id);
 
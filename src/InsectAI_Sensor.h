@@ -2,6 +2,7 @@
 #ifndef _SENSOR_H_
 #define _SENSOR_H_
 
+#include <math.h>
 #include <vector>
 
 namespace InsectAI {
@@ -11,7 +12,8 @@ namespace InsectAI {
 ///			Sensors are sensitive to particular kinds of agents
 class Sensor {
 public:
-    Sensor() : m_Kind(0), m_SensedAgent(0), mbChooseClosest(false), mActivation(0.0f), mSteeringActivation(0.0f) {
+    Sensor() : m_Kind(0), m_SensedAgent(0), mbChooseClosest(false), mActivation(0.0f), mSteeringActivation(0.0f),
+               mbChanged(true), mPropagatedActivation(0.0f), mPropagatedSteering(0.0f) {
     }
 
     virtual ~Sensor() { }
@@ -28,6 +30,38 @@ public:
             uint32			GetKind() const { return m_Kind; }
     virtual	ESensorWidth	GetSensorWidth() const = 0;
 
+    /// A sensor that only reacts to what is ahead describes its field of view, so that the
+    /// database can look for the nearest entity in it rather than the nearest overall
+    virtual bool			GetFieldOfView(float& cosHalfAngle, float& nearRadius) const { return false; }
+
+    /// A sensor that can read what it senses from a field the database keeps does so here,
+    /// instead of being given the nearest entity
+    /// @return false if there is no field for it, and the nearest entity should be sensed
+    virtual bool			SenseField(DynamicState* pOriginState, EntityDatabase* pDB) { return false; }
+
+    /// For lazy evaluation: whether any of the sensors this one reads changed when they were
+    /// last evaluated. A sensor that doesn't say what it reads is always evaluated
+    virtual bool			InputsChanged() const { return true; }
+
+    /// For lazy evaluation: false while the output would still move with unchanged inputs,
+    /// by more than epsilon, as a sensor with time dynamics does, in an update of dt
+    virtual bool			IsSettled(float epsilon, float dt) const { return true; }
+
+    /// Note whether the output has moved more than epsilon from what was last passed on,
+    /// and if it has, pass it on
+    bool					Propagate(float epsilon) {
+        mbChanged = fabsf(mActivation - mPropagatedActivation) > epsilon ||
+                    fabsf(mSteeringActivation - mPropagatedSteering) > epsilon;
+        if (mbChanged) {
+            mPropagatedActivation = mActivation;
+            mPropagatedSteering = mSteeringActivation;
+        }
+        return mbChanged;
+    }
+
+    /// As Propagate, for the outputs of a node that has more than one
+    virtual bool			PropagateOutputs(float epsilon) { return Propagate(epsilon); }
+
     virtual const char* name() const = 0;
 
     bool					mbDirectional;
@@ -37,6 +71,9 @@ public:
     float					mClosestDistance;
     float					mActivation;
     float					mSteeringActivation;
+    bool					mbChanged;								///< by Propagate, at the last evaluation
+    float					mPropagatedActivation;					///< the outputs last passed on
+    float					mPropagatedSteering;
 
 protected:
 	uint32					m_Kind;									///< RTTI
@@ -67,6 +104,14 @@ public:
 	virtual ESensorWidth GetSensorWidth() const override { return kNearest; }
 
 	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override;
+
+	/// Senses every light at once, from the database's light field
+	virtual bool SenseField(DynamicState* pOriginState, EntityDatabase* pDB) override;
+
+	float GetSensitiveRadius() const { return mSensitiveRadius; }
+
+private:
+	void Accumulate(float distance, float activation, float steeringActivation);
 };
 
 /// @class	CollisionSensor
@@ -83,6 +128,48 @@ public:
 
 	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override;
 	virtual ESensorWidth GetSensorWidth() const override { return kNearest; }
+
+	/// Collisions matter in the half plane ahead, or when very very close, as Sense tests
+	virtual bool GetFieldOfView(float& cosHalfAngle, float& nearRadius) const override {
+		cosHalfAngle = 0.0f;
+		nearRadius = 0.5f * mSensitiveRadius;
+		return true;
+	}
+
+	float GetSensitiveRadius() const { return mSensitiveRadius; }
+};
+
+/// @class	FieldSensor
+/// @brief	Smells the database's scent field with two antennae, angled either side of the heading.
+///			The activation is the mean of the antennae and the steering their difference, so a
+///			vehicle steered by it turns towards the stronger scent and follows a trail
+class FieldSensor : public Sensor {
+    float mAntennaLength, mAntennaAngle, mGain;
+public:
+	FieldSensor(float antennaLength, float antennaAngle, float gain)
+    : Sensor()
+    , mAntennaLength(antennaLength), mAntennaAngle(antennaAngle), mGain(gain) {
+		m_Kind = GetStaticKind();
+		mbDirectional = true;
+		mbClearEachFrame = true;
+		mbInternalSensor = false;
+	}
+
+    virtual ~FieldSensor() = default;
+	static uint32 GetStaticKind() { return 'Fild'; }
+
+    static const  char* static_name() { return "Field Sensor"; }
+    virtual const char* name() const override { return static_name(); }
+
+	/// There are no entities to sense, only the field
+	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override { }
+	virtual ESensorWidth GetSensorWidth() const override { return kAverage; }
+
+	virtual bool SenseField(DynamicState* pOriginState, EntityDatabase* pDB) override;
+
+	float GetAntennaLength() const { return mAntennaLength; }
+	float GetAntennaAngle() const { return mAntennaAngle; }
+	float GetGain() const { return mGain; }
 };
 
 
@@ -105,6 +192,10 @@ public:
 		mSteeringActivation = useA ? mpA->mSteeringActivation : mpB->mSteeringActivation;
 	}
 
+	virtual bool InputsChanged() const override {
+		return mpSwitch->mbChanged || mpA->mbChanged || mpB->mbChanged;
+	}
+
     static const  char* static_name() { return "Switch"; }
     virtual const char* name() const override { return static_name(); }
 
@@ -134,6 +225,12 @@ public:
 
 	virtual void Update(float dt) override;
 
+	virtual bool InputsChanged() const override;
+
+	/// A buffer is settled once its activation is within epsilon of its input, or so near it
+	/// that an update of dt would leave it where it is
+	virtual bool IsSettled(float epsilon, float dt) const override;
+
     virtual const char* name() const override {
         switch (mFunction) {
             case kBuffer: return "Buffer function";
@@ -145,9 +242,140 @@ public:
 
 	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override { }
 	uint32 mFunction;
+	float mSlope;			///< of a sigmoid's step at 1/2
+	float mRate;			///< per second at which a buffer follows its input
 	std::vector <Sensor*> mInputs;
 };
 
+/// The activation functions of neurons and layers. A buffer eases towards the weighted sum
+/// with the hysteresis of Function's buffer; the others map the sum directly
+enum ENeuronActivation {
+	kNeuronSigmoid	= Function::kSigmoid,		///< the logistic function
+	kNeuronTanh		= 'tanh',
+	kNeuronRelu		= 'relu',
+	kNeuronBuffer	= Function::kBuffer
+};
+
+/// @class	Neuron
+/// @brief	A weighted sum of any number of sensors, plus a bias, through an activation function.
+///			The steering activation is the weighted sum of the inputs' steering, without the bias
+class Neuron : public Sensor {
+public:
+	explicit Neuron(uint32 activation);
+	virtual ~Neuron();
+	static uint32 GetStaticKind() { return 'Nrn '; }
+	virtual ESensorWidth GetSensorWidth() const override { return kNearest; }
+
+	void AddInput(Sensor* pSensor, float weight) {
+		mInputs.push_back(pSensor);
+		mWeights.push_back(weight);
+	}
+
+	virtual void Update(float dt) override;
+	virtual bool InputsChanged() const override;
+	virtual bool IsSettled(float epsilon, float dt) const override;
+
+    static const  char* static_name() { return "Neuron"; }
+    virtual const char* name() const override { return static_name(); }
+
+	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override { }
+
+	uint32 mActivationFunction;
+	float mBias;
+	float mRate;							///< per second at which a buffer follows its sum
+	std::vector <Sensor*> mInputs;
+	std::vector <float> mWeights;
+
+private:
+	float mSum;								///< at the last update, for a buffer to settle on
+};
+
+/// @class	Layer
+/// @brief	N neurons over the same M inputs, evaluated together as one matrix vector product,
+///			four neurons at a time with SSE2 where it is available. Each neuron adds its weighted
+///			inputs in the order they were added and then its bias, as a Neuron does, so a layer
+///			gives the same bits as the neurons it stands for. The layer's own activations are
+///			those of its first neuron; LayerOutput reads the others
+class Layer : public Sensor {
+public:
+	Layer(int neurons, uint32 activation);
+	virtual ~Layer();
+	static uint32 GetStaticKind() { return 'Layr'; }
+	virtual ESensorWidth GetSensorWidth() const override { return kNearest; }
+
+	/// Add an input, with a weight of zero to every neuron
+	void	AddInput(Sensor* pSensor);
+
+	void	SetWeight(int neuron, int input, float weight)	{ mWeights[input * mStride + neuron] = weight; }
+	float	GetWeight(int neuron, int input) const			{ return mWeights[input * mStride + neuron]; }
+	void	SetBias(int neuron, float bias)					{ mBiases[neuron] = bias; }
+	float	GetBias(int neuron) const						{ return mBiases[neuron]; }
+
+	int		GetNeuronCount() const							{ return mNeurons; }
+	int		GetInputCount() const							{ return (int) mInputs.size(); }
+	Sensor*	GetInput(int input) const						{ return mInputs[input]; }
+	float	GetOutput(int neuron) const						{ return mOutputs[neuron]; }
+	float	GetSteeringOutput(int neuron) const				{ return mSteering[neuron]; }
+
+	/// Set a neuron's outputs, as a snapshot restores them
+	void	SetOutput(int neuron, float activation, float steering);
+
+	/// Use the scalar product even where SSE2 is available, to compare them
+	void	SetVectorized(bool vectorized)					{ mbVectorized = vectorized; }
+	static bool IsVectorAvailable();
+
+	virtual void Update(float dt) override;
+	virtual bool InputsChanged() const override;
+	virtual bool IsSettled(float epsilon, float dt) const override;
+	virtual bool PropagateOutputs(float epsilon) override;
+
+    static const  char* static_name() { return "Layer"; }
+    virtual const char* name() const override { return static_name(); }
+
+	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override { }
+
+	uint32 mActivationFunction;
+	float mRate;							///< per second at which buffers follow their sums
+
+private:
+	int		mNeurons;
+	int		mStride;						///< neurons rounded up to a multiple of four
+	bool	mbVectorized;
+	std::vector <Sensor*> mInputs;
+	std::vector <float> mWeights;			///< a column of mStride weights per input
+	std::vector <float> mBiases;			///< each of these is mStride long
+	std::vector <float> mSums;
+	std::vector <float> mSteering;
+	std::vector <float> mOutputs;
+	std::vector <float> mPropagated;		///< outputs last passed on, activation then steering
+	std::vector <float> mActivations;		///< of the inputs, gathered for the product
+	std::vector <float> mSteeringActivations;
+};
+
+/// @class	LayerOutput
+/// @brief	One neuron of a layer, to wire to functions and actuators
+class LayerOutput : public Sensor {
+public:
+	LayerOutput(Layer* pLayer, int neuron);
+	virtual ~LayerOutput();
+	static uint32 GetStaticKind() { return 'LOut'; }
+	virtual ESensorWidth GetSensorWidth() const override { return kNearest; }
+
+	virtual void Update(float dt) override {
+		mActivation = mpLayer->GetOutput(mNeuron);
+		mSteeringActivation = mpLayer->GetSteeringOutput(mNeuron);
+	}
+	virtual bool InputsChanged() const override { return mpLayer->mbChanged; }
+
+    static const  char* static_name() { return "Layer Output"; }
+    virtual const char* name() const override { return static_name(); }
+
+	virtual void Sense(DynamicState* pOriginState, DynamicState* pSenseeState) override { }
+
+	Layer* mpLayer;
+	int mNeuron;
+};
+
 } // end namespace InsectAI
 
 #endif
@@ -0,0 +1,248 @@
+
+/** @file	InsectAI_StaticBrain.h
+	@brief	Brains whose topology is fixed at compile time. Only the static benchmark of
+			insect-ai-headless uses them, so InsectAI.h doesn't include them; the World runs
+			the dynamic brains, which gathering senses into and scattering outputs from these
+			would make slower, not faster
+	*/
+
+#ifndef _STATICBRAIN_H_
+#define _STATICBRAIN_H_
+
+#include "InsectAI.h"
+
+#include <math.h>
+#include <vector>
+
+namespace InsectAI {
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// Nodes of a static brain. Each is a type whose Evaluate the compiler inlines into its
+/// consumer, so a whole brain becomes one expression per vehicle, with no virtual calls and
+/// no pointers between nodes. A node reads its inputs from the lanes of a StaticBrain: one
+/// array per sense and per state, indexed by vehicle. Nodes compute exactly what Function,
+/// Switch and Actuator compute, in the same order, so a static brain matches a dynamic brain
+/// of the same topology bit for bit.
+///
+/// A node is a tree of its inputs, so an input used twice is written twice, as in
+/// StaticSwitch<StaticSense<0>, StaticSense<1>, StaticSense<0> >. That costs nothing for
+/// nodes without state, whose repeats the compiler folds; a buffer must not be repeated, as
+/// each copy would keep a state of its own.
+
+	struct StaticSignal {
+		float	activation, steering;
+	};
+
+	/// The brain's senses, states and time step for each vehicle
+	struct StaticLanes {
+		float const* const*	mActivations;		///< per sense
+		float const* const*	mSteering;
+		float* const*		mStates;			///< per state
+		float const*		mDt;
+	};
+
+	/// The vehicle's Ith raw sense, its Ith sensor that is not internal
+	template <int I>
+	struct StaticSense {
+		enum { kSenses = I + 1, kStates = 0 };
+
+		template <int State>
+		static StaticSignal Evaluate(StaticLanes const& l, int i) {
+			StaticSignal s = { l.mActivations[I][i], l.mSteering[I][i] };
+			return s;
+		}
+	};
+
+	/// A Function of one input, with the default slope and rate; a buffer keeps its activation in a state
+	template <uint32 F, class In>
+	struct StaticFunction {
+		enum { kSenses = In::kSenses, kStates = In::kStates + (F == Function::kInvert || F == Function::kSigmoid ? 0 : 1) };
+
+		template <int State>
+		static StaticSignal Evaluate(StaticLanes const& l, int i) {
+			StaticSignal in = In::template Evaluate<State>(l, i);
+			StaticSignal s;
+			s.steering = in.steering;
+			if (F == Function::kSigmoid) {
+				float input = in.activation;
+				s.activation = input <= 0.0f ? 0.0f : input >= 1.0f ? 1.0f : (1.0f / (1.0f + expf(-(input-0.5f)*24.0f)));
+			}
+			else if (F == Function::kInvert) {
+				s.activation = 1.0f - in.activation;
+			}
+			else {
+				float* pState = l.mStates[State + In::kStates];
+				s.activation = pState[i] + (in.activation - pState[i]) * 4.0f * l.mDt[i];
+				pState[i] = s.activation;
+			}
+			return s;
+		}
+	};
+
+	/// A Switch, choosing A while the control is at most 1/2, and B above
+	template <class Control, class A, class B>
+	struct StaticSwitch {
+		enum {
+			kSensesAB = (int) A::kSenses > (int) B::kSenses ? (int) A::kSenses : (int) B::kSenses,
+			kSenses = (int) Control::kSenses > kSensesAB ? (int) Control::kSenses : kSensesAB,
+			kStates = (int) Control::kStates + (int) A::kStates + (int) B::kStates
+		};
+
+		template <int State>
+		static StaticSignal Evaluate(StaticLanes const& l, int i) {
+			StaticSignal control = Control::template Evaluate<State>(l, i);
+			StaticSignal a = A::template Evaluate<State + Control::kStates>(l, i);
+			StaticSignal b = B::template Evaluate<State + Control::kStates + A::kStates>(l, i);
+			bool useA = control.activation <= 0.5f;
+			StaticSignal s = { useA ? a.activation : b.activation, useA ? a.steering : b.steering };
+			return s;
+		}
+	};
+
+	/// The nodes driving each actuator in turn, their states laid out one after another
+	template <class... Nodes>
+	struct StaticNodes {
+		enum { kSenses = 0, kStates = 0, kCount = 0 };
+
+		template <int State>
+		static void Evaluate(StaticLanes const&, int, float* const*, float* const*) { }
+	};
+
+	template <class Node, class... Nodes>
+	struct StaticNodes<Node, Nodes...> {
+		typedef StaticNodes<Nodes...> Rest;
+		enum {
+			kSenses = (int) Node::kSenses > (int) Rest::kSenses ? (int) Node::kSenses : (int) Rest::kSenses,
+			kStates = (int) Node::kStates + (int) Rest::kStates,
+			kCount = 1 + Rest::kCount
+		};
+
+		template <int State>
+		static void Evaluate(StaticLanes const& l, int i, float* const* pActivations, float* const* pSteering) {
+			StaticSignal s = Node::template Evaluate<State>(l, i);
+			pActivations[0][i] = s.activation;
+			pSteering[0][i] = s.steering;
+			Rest::template Evaluate<State + Node::kStates>(l, i, pActivations + 1, pSteering + 1);
+		}
+	};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+/// @class	StaticBrain
+/// @brief	A population of brains of one topology, given as the nodes driving each actuator in
+///			turn. Senses are loaded into the lanes, by Gather or directly, Evaluate runs every
+///			brain in one loop, and Scatter hands each vehicle's outputs to its actuators as their
+///			targets, as Actuator::Update would. Evaluation is cheap next to touching the
+///			sensor and actuator objects, so a static brain pays off where senses are written
+///			straight into its lanes, rather than gathered from sensors. The dynamic graph
+///			stays the form for brains authored at run time
+	template <class... Outputs>
+	class StaticBrain {
+		typedef StaticNodes<Outputs...> Nodes;
+	public:
+		enum { kSenses = Nodes::kSenses, kStates = Nodes::kStates, kOutputs = Nodes::kCount };
+
+		StaticBrain() : mCount(0) { }
+
+		void	Resize(int count) {
+			mCount = count;
+			for (int s = 0; s < kSenses; ++s) {
+				mSenses[s].resize(count);
+				mSenseSteering[s].resize(count);
+			}
+			for (int s = 0; s < kStates; ++s)	mStates[s].resize(count);
+			for (int o = 0; o < kOutputs; ++o) {
+				mOutputs[o].resize(count);
+				mOutputSteering[o].resize(count);
+			}
+			mDt.resize(count);
+		}
+
+		int		GetCount() const				{ return mCount; }
+
+		/// The lanes to load a sense or time step into for every vehicle at once
+		float*	GetSenses(int sense)			{ return &mSenses[sense][0]; }
+		float*	GetSenseSteering(int sense)		{ return &mSenseSteering[sense][0]; }
+		float*	GetDt()							{ return &mDt[0]; }
+
+		float	GetOutput(int vehicle, int output) const			{ return mOutputs[output][vehicle]; }
+		float	GetOutputSteering(int vehicle, int output) const	{ return mOutputSteering[output][vehicle]; }
+
+		/// Load a vehicle's raw senses and time step into its lanes
+		void	Gather(int vehicle, Vehicle const* pVehicle, float dt) {
+			for (int s = 0, sense = 0; s < pVehicle->GetSensorCount() && sense < kSenses; ++s) {
+				Sensor const* pSensor = pVehicle->GetSensor(s);
+				if (!pSensor->mbInternalSensor) {
+					mSenses[sense][vehicle] = pSensor->mActivation;
+					mSenseSteering[sense][vehicle] = pSensor->mSteeringActivation;
+					++sense;
+				}
+			}
+			mDt[vehicle] = dt;
+		}
+
+		/// Set a vehicle's buffers from its dynamic brain's functions, in the order the
+		/// outputs reach them, so it carries on where the dynamic brain left off
+		void	SetState(int vehicle, int state, float activation) { mStates[state][vehicle] = activation; }
+		float	GetState(int vehicle, int state) const { return mStates[state][vehicle]; }
+
+		/// Hand a vehicle's outputs to its actuators
+		void	Scatter(int vehicle, Vehicle* pVehicle) const {
+			for (int o = 0; o < kOutputs && o < pVehicle->GetActuatorCount(); ++o) {
+				Actuator* pActuator = pVehicle->GetActuator(o);
+				pActuator->mTarget = mOutputs[o][vehicle];
+				pActuator->mSteeringTarget = mOutputSteering[o][vehicle];
+				if (!pActuator->HasDynamics()) {
+					pActuator->mActivation = pActuator->mTarget;
+					pActuator->mSteeringActivation = pActuator->mSteeringTarget;
+				}
+			}
+		}
+
+		/// Evaluate every vehicle's brain
+		void	Evaluate() {
+			float const*	activations[kSenses > 0 ? kSenses : 1];
+			float const*	steering[kSenses > 0 ? kSenses : 1];
+			float*			states[kStates > 0 ? kStates : 1];
+			float*			outputs[kOutputs > 0 ? kOutputs : 1];
+			float*			outputSteering[kOutputs > 0 ? kOutputs : 1];
+			for (int s = 0; s < kSenses; ++s) {
+				activations[s] = mSenses[s].empty() ? 0 : &mSenses[s][0];
+				steering[s] = mSenseSteering[s].empty() ? 0 : &mSenseSteering[s][0];
+			}
+			for (int s = 0; s < kStates; ++s)	states[s] = mStates[s].empty() ? 0 : &mStates[s][0];
+			for (int o = 0; o < kOutputs; ++o) {
+				outputs[o] = mOutputs[o].empty() ? 0 : &mOutputs[o][0];
+				outputSteering[o] = mOutputSteering[o].empty() ? 0 : &mOutputSteering[o][0];
+			}
+
+			StaticLanes l = { activations, steering, states, mDt.empty() ? 0 : &mDt[0] };
+			for (int i = 0; i < mCount; ++i) {
+				Nodes::template Evaluate<0>(l, i, outputs, outputSteering);
+			}
+		}
+
+	private:
+		int					mCount;
+		std::vector<float>	mSenses[kSenses > 0 ? kSenses : 1];
+		std::vector<float>	mSenseSteering[kSenses > 0 ? kSenses : 1];
+		std::vector<float>	mStates[kStates > 0 ? kStates : 1];
+		std::vector<float>	mOutputs[kOutputs > 0 ? kOutputs : 1];
+		std::vector<float>	mOutputSteering[kOutputs > 0 ? kOutputs : 1];
+		std::vector<float>	mDt;
+	};
+
+	/// The test brains of World::BuildTestBrain, numbered as there. Brains 0 and 4 drive the
+	/// motor from a light sensor, 1 to 3 and 5 to 7 through a buffer, an inverter and a sigmoid.
+	/// Brain 8 seeks light and avoids collisions, its raw senses being the collision sensor then
+	/// the light sensor, and brain 9 follows and lays trails
+	typedef StaticBrain<StaticSense<0> >												StaticLightBrain;
+	typedef StaticBrain<StaticFunction<Function::kBuffer, StaticSense<0> > >			StaticBufferedLightBrain;
+	typedef StaticBrain<StaticFunction<Function::kInvert, StaticSense<0> > >			StaticInvertedLightBrain;
+	typedef StaticBrain<StaticFunction<Function::kSigmoid, StaticSense<0> > >			StaticThresholdLightBrain;
+	typedef StaticBrain<StaticSwitch<StaticSense<0>, StaticSense<1>, StaticSense<0> > >	StaticAvoiderBrain;
+	typedef StaticBrain<StaticFunction<Function::kInvert, StaticSense<0> >,
+						StaticFunction<Function::kInvert, StaticSense<0> > >			StaticTrailBrain;
+
+}	// end namespace InsectAI
+
+#endif
@@ -29,7 +29,36 @@ namespace InsectAI {
 				bool		Sense(EntityDatabase*);
 				void		ClearSenses(float dt);
 
+				/// Evaluate a function, switch or actuator only when one of its inputs has changed by
+				/// more than epsilon since it last read them, or while it has time dynamics that have not
+				/// settled to within epsilon. With an epsilon of zero the brain acts exactly as it does
+				/// when evaluated in full. A brain that evaluates every node for kBusyUpdates updates
+				/// running, as in a moving scene, is updated in full without the bookkeeping for
+				/// kMinFullUpdates, and then tries skipping again; each time it is still busy the wait
+				/// doubles, up to kMaxFullUpdates. Off by default
+				void		SetLazy(bool lazy, float epsilon = 0.0f);
+				bool		IsLazy() const				{ return mbLazy; }
+
+				/// Nodes evaluated and skipped by lazy updates, since the vehicle was made lazy
+				long long	GetEvaluatedCount() const	{ return mEvaluated; }
+				long long	GetSkippedCount() const		{ return mSkipped; }
+
 				float		mMaxSpeed;
+
+				enum { kBusyUpdates = 2, kMinFullUpdates = 16, kMaxFullUpdates = 256 };
+
+	private:
+				void		UpdateLazily(float dt);
+
+				bool		mbLazy;
+				bool		mbPrimed;					///< every node has been evaluated once
+				bool		mbQuiet;					///< every node was skipped in the last update
+				float		mEpsilon;
+				int			mBusyUpdates;				///< updates running in which no node was skipped
+				int			mFullUpdates;				///< left to update in full before skipping again
+				int			mFullPeriod;				///< to update in full the next time the brain is busy
+				long long	mEvaluated;
+				long long	mSkipped;
 	};
 
 }	// end namespace InsectAI
@@ -0,0 +1,131 @@
+
+#include "KDTree.h"
+
+#include <algorithm>
+
+void KDTree::Clear()
+{
+	m_Items.clear();
+	m_Axis.clear();
+	m_SubtreeMask.clear();
+	m_Built = true;
+}
+
+void KDTree::Add(float x, float y, int id, uint32 mask)
+{
+	Item item = { x, y, id, mask };
+	m_Items.push_back(item);
+	m_Built = false;
+}
+
+void KDTree::Build()
+{
+	m_Axis.assign(m_Items.size(), 0);
+	m_SubtreeMask.assign(m_Items.size(), 0);
+	Build(0, (int) m_Items.size());
+	m_Built = true;
+}
+
+void KDTree::Build(int begin, int end)
+{
+	if (begin >= end)
+		return;
+
+	// small ranges are leaves that are scanned, which is faster than descending to single points
+	if (end - begin <= kLeafSize) {
+		uint32 mask = 0;
+		for (int i = begin; i < end; ++i) {
+			mask |= m_Items[i].mask;
+		}
+		m_SubtreeMask[(begin + end) / 2] = mask;
+		return;
+	}
+
+	// split across the longer side of the points' bounds
+	float minx = m_Items[begin].x, maxx = minx;
+	float miny = m_Items[begin].y, maxy = miny;
+	for (int i = begin + 1; i < end; ++i) {
+		minx = PMath::Min(minx, m_Items[i].x);		maxx = PMath::Max(maxx, m_Items[i].x);
+		miny = PMath::Min(miny, m_Items[i].y);		maxy = PMath::Max(maxy, m_Items[i].y);
+	}
+	unsigned char axis = (maxx - minx >= maxy - miny) ? 0 : 1;
+
+	int mid = (begin + end) / 2;
+	std::nth_element(m_Items.begin() + begin, m_Items.begin() + mid, m_Items.begin() + end,
+		[axis](Item const& a, Item const& b) { return axis == 0 ? a.x < b.x : a.y < b.y; });
+	m_Axis[mid] = axis;
+
+	Build(begin, mid);
+	Build(mid + 1, end);
+
+	uint32 mask = m_Items[mid].mask;
+	if (begin < mid)		mask |= m_SubtreeMask[(begin + mid) / 2];
+	if (mid + 1 < end)		mask |= m_SubtreeMask[(mid + 1 + end) / 2];
+	m_SubtreeMask[mid] = mask;
+}
+
+int KDTree::FindNearest(float x, float y, uint32 mask, float maxDistanceSquared, float* pDistanceSquared) const
+{
+	Query query;
+	query.x = x;
+	query.y = y;
+	query.mask = mask;
+	query.bestDistanceSquared = maxDistanceSquared;
+	query.bestId = -1;
+
+	if (m_Built) {
+		Search(0, (int) m_Items.size(), query);
+	}
+	if (pDistanceSquared) {
+		*pDistanceSquared = query.bestDistanceSquared;
+	}
+	return query.bestId;
+}
+
+inline void KDTree::Test(Item const& item, Query& query)
+{
+	if ((item.mask & query.mask) != 0) {
+		float dx = query.x - item.x;
+		float dy = query.y - item.y;
+		float distanceSquared = dx * dx + dy * dy;
+		if (distanceSquared < query.bestDistanceSquared ||
+			(distanceSquared == query.bestDistanceSquared && query.bestId >= 0 && item.id < query.bestId)) {
+			query.bestDistanceSquared = distanceSquared;
+			query.bestId = item.id;
+		}
+	}
+}
+
+void KDTree::Search(int begin, int end, Query& query) const
+{
+	if (begin >= end)
+		return;
+
+	int mid = (begin + end) / 2;
+	if ((m_SubtreeMask[mid] & query.mask) == 0)
+		return;
+
+	if (end - begin <= kLeafSize) {
+		for (int i = begin; i < end; ++i) {
+			Test(m_Items[i], query);
+		}
+		return;
+	}
+
+	Item const& item = m_Items[mid];
+	Test(item, query);
+
+	// descend the side the query point is on first; the other side can only hold a nearer
+	// point, or an equally near one with a lower id, if the splitting line is close enough
+	float delta = (m_Axis[mid] == 0) ? query.x - item.x : query.y - item.y;
+	if (delta < 0.0f) {
+		Search(begin, mid, query);
+		if (delta * delta <= query.bestDistanceSquared)
+			Search(mid + 1, end, query);
+	}
+	else {
+		Search(mid + 1, end, query);
+		if (delta * delta <= query.bestDistanceSquared)
+			Search(begin, mid, query);
+	}
+}
@@ -0,0 +1,71 @@
+
+/** @file	KDTree.h
+	@brief	A static 2d tree for nearest point queries over entities that rarely move
+	*/
+
+#ifndef _KDTREE_H_
+#define _KDTREE_H_
+
+#include "PMath.h"
+
+#include <vector>
+
+/** @class	KDTree
+	@brief	A balanced 2d tree stored implicitly in an array: the node of a range of items is its
+			middle item, and the halves on either side of it are its subtrees. Ranges of up to
+			kLeafSize items are leaves, and are scanned. Each node also records the union of the
+			masks beneath it, so that masked queries skip whole subtrees.
+
+			The tree is built once from a set of points, and must be rebuilt when any of them
+			moves; it is meant for lights and other entities that stand still between edits.
+			Queries are O(log n), and don't depend on anything else in the world.
+	*/
+
+class KDTree {
+public:
+	KDTree() : m_Built(true) { }
+
+	void	Clear();
+
+	/// Add a point; the tree must be rebuilt before it is queried again
+	void	Add(float x, float y, int id, uint32 mask);
+
+	/// Balance the tree over the points added since the last Clear
+	void	Build();
+
+	bool	IsBuilt() const { return m_Built; }
+	int		GetCount() const { return (int) m_Items.size(); }
+
+	/// Find the nearest point whose mask intersects the given mask, closer than maxDistanceSquared.
+	/// Of equally near points, the one with the lowest id is chosen, so results don't depend on
+	/// the shape of the tree
+	/// @return the id of the point, or -1 if there is none
+	int		FindNearest(float x, float y, uint32 mask, float maxDistanceSquared, float* pDistanceSquared = 0) const;
+
+private:
+	enum { kLeafSize = 8 };
+
+	struct Item {
+		float	x, y;
+		int		id;
+		uint32	mask;
+	};
+
+	struct Query {
+		float	x, y;
+		uint32	mask;
+		float	bestDistanceSquared;
+		int		bestId;
+	};
+
+	void	Build(int begin, int end);
+	void	Search(int begin, int end, Query& query) const;
+	static void Test(Item const& item, Query& query);
+
+	std::vector<Item>			m_Items;
+	std::vector<unsigned char>	m_Axis;				///< splitting axis of the node at each index
+	std::vector<uint32>			m_SubtreeMask;		///< union of the masks in the subtree of each node
+	bool						m_Built;
+};
+
+#endif
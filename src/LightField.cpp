@@ -0,0 +1,86 @@
+
+#include "LightField.h"
+
+#include <math.h>
+
+// fixed point scales; a light's activation is at most one, and its steering vector at most a
+// quarter of the radius long
+static const double kActivationScale = 4294967296.0;		// 2^32
+static const double kSteeringScale = 1048576.0;			// 2^20
+
+LightField::LightField()
+: m_Columns(0), m_Rows(0), m_CellSize(k1), m_InverseCellSize(k1), m_Radius(k1), m_NodesSplatted(0)
+{
+}
+
+void LightField::Configure(float width, float height, float cellSize, float radius)
+{
+	m_CellSize = cellSize;
+	m_InverseCellSize = 1.0f / cellSize;
+	m_Radius = radius;
+	m_Columns = PMath::Max(2, (int) ceilf(width * m_InverseCellSize) + 1);
+	m_Rows = PMath::Max(2, (int) ceilf(height * m_InverseCellSize) + 1);
+	m_Nodes.assign((size_t) m_Columns * m_Rows, Node());
+	m_NodesSplatted = 0;
+}
+
+void LightField::Clear()
+{
+	m_Nodes.assign(m_Nodes.size(), Node());
+	m_NodesSplatted = 0;
+}
+
+void LightField::Splat(float x, float y, int weight)
+{
+	if (m_Nodes.empty())
+		return;
+
+	int c0 = PMath::Max(0, (int) ceilf((x - m_Radius) * m_InverseCellSize));
+	int c1 = PMath::Min(m_Columns - 1, (int) floorf((x + m_Radius) * m_InverseCellSize));
+	int r0 = PMath::Max(0, (int) ceilf((y - m_Radius) * m_InverseCellSize));
+	int r1 = PMath::Min(m_Rows - 1, (int) floorf((y + m_Radius) * m_InverseCellSize));
+	float inverseRadius = 1.0f / m_Radius;
+
+	for (int r = r0; r <= r1; ++r) {
+		float dy = y - r * m_CellSize;
+		Node* pNode = &m_Nodes[(size_t) r * m_Columns];
+		for (int c = c0; c <= c1; ++c) {
+			float dx = x - c * m_CellSize;
+			float distance = sqrtf(dx * dx + dy * dy);
+			if (distance < m_Radius) {
+				// as LightSensor::Sense weighs a light at this distance
+				float falloff = 1.0f - distance * inverseRadius;
+				Node& node = pNode[c];
+				node.activation += weight * llrint(falloff * falloff * kActivationScale);
+				node.steering[0] += weight * llrint(dx * falloff * kSteeringScale);
+				node.steering[1] += weight * llrint(dy * falloff * kSteeringScale);
+				++m_NodesSplatted;
+			}
+		}
+	}
+}
+
+bool LightField::Sample(float x, float y, float& activation, float* pSteering) const
+{
+	if (m_Nodes.empty())
+		return false;
+
+	float u = PMath::Clamp(x * m_InverseCellSize, 0.0f, (float) (m_Columns - 1));
+	float v = PMath::Clamp(y * m_InverseCellSize, 0.0f, (float) (m_Rows - 1));
+	int c = PMath::Min((int) u, m_Columns - 2);
+	int r = PMath::Min((int) v, m_Rows - 2);
+	double s = u - c;
+	double t = v - r;
+
+	Node const& n00 = m_Nodes[(size_t) r * m_Columns + c];
+	Node const& n10 = (&n00)[1];
+	Node const& n01 = (&n00)[m_Columns];
+	Node const& n11 = (&n01)[1];
+	double w00 = (1.0 - s) * (1.0 - t), w10 = s * (1.0 - t), w01 = (1.0 - s) * t, w11 = s * t;
+
+	activation = (float) ((w00 * n00.activation + w10 * n10.activation + w01 * n01.activation + w11 * n11.activation) / kActivationScale);
+	for (int i = 0; i < 2; ++i) {
+		pSteering[i] = (float) ((w00 * n00.steering[i] + w10 * n10.steering[i] + w01 * n01.steering[i] + w11 * n11.steering[i]) / kSteeringScale);
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+
+/** @file	LightField.h
+	@brief	The activation of every light, rasterised into a grid for constant time sensing
+	*/
+
+#ifndef _LIGHTFIELD_H_
+#define _LIGHTFIELD_H_
+
+#include "PMath.h"
+
+#include <vector>
+
+/** @class	LightField
+	@brief	A grid of nodes over a rectangle, each holding the sum over all lights of the
+			activation a light sensor of the field's radius would feel there, and the gradient
+			of the lights' potential that steering comes from: the offset to each light,
+			weighted by one minus the distance over the radius. That is the vector a
+			directional light sensor already steers by, so a field of one light senses as the
+			nearest light query does.
+
+			Sampling interpolates the four nodes around a point, and costs the same however many
+			lights there are. Lights are splatted in and out one at a time as they move; nodes
+			accumulate in fixed point, so removing a light leaves exactly the sum it was added to,
+			and the field doesn't depend on the order lights were added or moved in.
+	*/
+
+class LightField {
+public:
+	LightField();
+
+	/// Cover the rectangle from the origin to (width, height) with nodes cellSize apart, for
+	/// lights whose activation falls to zero at radius. Any lights already splatted are dropped
+	void	Configure(float width, float height, float cellSize, float radius);
+
+	/// Drop every light
+	void	Clear();
+
+	/// Add a light's contribution to the nodes within the radius of it, or take it away with a
+	/// weight of -1
+	void	Splat(float x, float y, int weight);
+
+	/// The activation and steering vector at a point; points outside the rectangle take the
+	/// value at its edge
+	/// @return false if the field hasn't been configured
+	bool	Sample(float x, float y, float& activation, float* pSteering) const;
+
+	bool	IsConfigured() const { return !m_Nodes.empty(); }
+	float	GetRadius() const { return m_Radius; }
+	float	GetCellSize() const { return m_CellSize; }
+	int		GetNodeCount() const { return (int) m_Nodes.size(); }
+
+	/// Nodes written by splats since the field was configured
+	long long GetNodesSplatted() const { return m_NodesSplatted; }
+
+private:
+	struct Node {
+		long long	activation;
+		long long	steering[2];
+	};
+
+	std::vector<Node>	m_Nodes;			///< row major
+	int					m_Columns;
+	int					m_Rows;
+	float				m_CellSize;
+	float				m_InverseCellSize;
+	float				m_Radius;
+	long long			m_NodesSplatted;
+};
+
+#endif
@@ -1,32 +1,171 @@
 
 #include "NearestNeighbours.h"
 
-NearestNeighbours::	NearestNeighbours(PMath::Vec3f origin, PMath::Vec3f dimensions, int gridx, int gridy, int gridz)
-: mp_DB(0)
+#include <string.h>
+#include <vector>
+
+/// Divisions of a lattice axis at a level above the finest
+static int LevelDivisions(int divisions, int level)
 {
-	mp_DB = lqCreateDatabase(origin[0], origin[1], origin[2], dimensions[0], dimensions[1], dimensions[2], gridx, gridy, gridz);
+	while (level-- > 0) {
+		divisions = (divisions + NearestNeighbours::kLevelRatio - 1) / NearestNeighbours::kLevelRatio;
+	}
+	return divisions;
+}
+
+NearestNeighbours::	NearestNeighbours(PMath::Vec3f origin, PMath::Vec3f dimensions, int gridx, int gridy, int gridz,
+										  bool segregateKinds, int levels)
+: m_CellSize(0), m_Levels(1), m_SegregateKinds(segregateKinds), m_NearestQueries(0), m_NearestFound(0), m_QueryRadiusSum(0), m_QueryCount(0)
+{
+	PMath::Vec3fSet(m_Origin, origin);
+	PMath::Vec3fSet(m_Dimensions, dimensions);
+	m_Divisions[0] = gridx;
+	m_Divisions[1] = gridy;
+	m_Divisions[2] = gridz;
+
+	// levels stop once a single sub-brick spans the lattice
+	levels = PMath::Clamp(levels, 1, (int) kMaxLevels);
+	m_LevelCellSize[0] = PMath::Min(dimensions[0] / gridx, dimensions[1] / gridy);
+	while (m_Levels < levels && (LevelDivisions(gridx, m_Levels - 1) > 1 || LevelDivisions(gridy, m_Levels - 1) > 1)) {
+		m_LevelCellSize[m_Levels] = PMath::Min(dimensions[0] / LevelDivisions(gridx, m_Levels),
+											   dimensions[1] / LevelDivisions(gridy, m_Levels));
+		++m_Levels;
+	}
+
+	// there is always at least one lattice, so that the grid can be inspected before use
+	LayerFor(segregateKinds ? 0 : ~0u);
+}
+
+NearestNeighbours::NearestNeighbours(float cellSize, bool segregateKinds)
+: m_CellSize(cellSize), m_Levels(1), m_SegregateKinds(segregateKinds), m_NearestQueries(0), m_NearestFound(0), m_QueryRadiusSum(0), m_QueryCount(0)
+{
+	PMath::Vec3fZero(m_Origin);
+	PMath::Vec3fZero(m_Dimensions);
+	m_Divisions[0] = m_Divisions[1] = m_Divisions[2] = 0;
+	m_LevelCellSize[0] = cellSize;
+	LayerFor(segregateKinds ? 0 : ~0u);
 }
 
 NearestNeighbours::~NearestNeighbours()
 {
-	if (mp_DB) {
-		lqDeleteDatabase(mp_DB);;
+	for (size_t i = 0; i < m_Layers.size(); ++i) {
+		if (m_Layers[i].pDB)
+			lqDeleteDatabase(m_Layers[i].pDB);
+		for (size_t level = 0; level < m_Layers[i].coarse.size(); ++level) {
+			lqDeleteDatabase(m_Layers[i].coarse[level]);
+		}
+		delete m_Layers[i].pHash;
+	}
+}
+
+int NearestNeighbours::LayerFor(uint32 mask)
+{
+	if (!m_SegregateKinds) {
+		mask = ~0u;
+	}
+	for (size_t i = 0; i < m_Layers.size(); ++i) {
+		if (m_Layers[i].mask == mask)
+			return (int) i;
+	}
+
+	Layer layer;
+	layer.mask = mask;
+	layer.pDB = 0;
+	layer.pHash = 0;
+	if (m_CellSize > 0) {
+		layer.pHash = new SpatialHash(m_CellSize);
+	}
+	else {
+		layer.pDB = lqCreateDatabase(m_Origin[0], m_Origin[1], m_Origin[2], m_Dimensions[0], m_Dimensions[1], m_Dimensions[2],
+									 m_Divisions[0], m_Divisions[1], m_Divisions[2]);
+		for (int level = 1; level < m_Levels; ++level) {
+			layer.coarse.push_back(lqCreateDatabase(m_Origin[0], m_Origin[1], m_Origin[2], m_Dimensions[0], m_Dimensions[1], m_Dimensions[2],
+													LevelDivisions(m_Divisions[0], level), LevelDivisions(m_Divisions[1], level), m_Divisions[2]));
+		}
+	}
+	m_Layers.push_back(layer);
+	return (int) m_Layers.size() - 1;
+}
+
+int NearestNeighbours::LevelFor(float radius) const
+{
+	int level = 0;
+	while (level + 1 < m_Levels && m_LevelCellSize[level + 1] <= 0.5f * radius) {
+		++level;
+	}
+	return level;
+}
+
+bool NearestNeighbours::SearchStep(int step, Real radius, Real& searched, int& level) const
+{
+	// a step is only worth taking if it searches much less than the whole radius
+	if (step + 1 < m_Levels && m_LevelCellSize[step] * kLevelRatio <= radius) {
+		searched = m_LevelCellSize[step];
+		level = step;
+		return false;
+	}
+	searched = radius;
+	level = LevelFor(radius);
+	return true;
+}
+
+void NearestNeighbours::Traverse(Layer const& layer, int level, Real const*const pPosition, Real radius, lqCallBackFunction func, void* state)
+{
+	if (layer.pHash) {
+		layer.pHash->MapOverAllObjectsInLocality(pPosition[0], pPosition[1], radius, func, state);
+	}
+	else {
+		lqMapOverAllObjectsInLocality (LevelDB(layer, level), pPosition[0], pPosition[1], pPosition[2], radius,
+										func,
+										state);
 	}
 }
 
 void NearestNeighbours::AddProxy(NNProxy* pProxy)
 {
 	if (!pProxy->m_InDatabase) {
-		lqInitClientProxy (&pProxy->m_Proxy, pProxy);
 		pProxy->m_InDatabase = true;
-		UpdateProxy(pProxy);
+		pProxy->m_Layer = LayerFor(pProxy->GetSearchMask());
+		SpatialHash* pHash = m_Layers[pProxy->m_Layer].pHash;
+		if (pHash) {
+			float const*const pPos = pProxy->GetPositionVectorPtr();
+			pHash->Add(&pProxy->m_HashProxy, pProxy, pPos[0], pPos[1]);
+		}
+		else {
+			lqInitClientProxy (&pProxy->m_Proxy, pProxy);
+			if (m_Levels > 1) {
+				if (m_FreeCoarseSlots.empty()) {
+					pProxy->m_CoarseSlot = (int) (m_CoarseProxies.size() / (m_Levels - 1));
+					m_CoarseProxies.resize(m_CoarseProxies.size() + m_Levels - 1);
+				}
+				else {
+					pProxy->m_CoarseSlot = m_FreeCoarseSlots.back();
+					m_FreeCoarseSlots.pop_back();
+				}
+				for (int level = 1; level < m_Levels; ++level) {
+					lqInitClientProxy (CoarseProxy(pProxy, level), pProxy);
+				}
+			}
+			UpdateProxy(pProxy);
+		}
 	}
 }
 
 void NearestNeighbours::RemoveProxy(NNProxy* pProxy)
 {
 	if (pProxy->m_InDatabase) {
-		lqRemoveFromBin(&pProxy->m_Proxy);
+		SpatialHash* pHash = m_Layers[pProxy->m_Layer].pHash;
+		if (pHash)
+			pHash->Remove(&pProxy->m_HashProxy);
+		else
+			lqRemoveFromBin(&pProxy->m_Proxy);
+		if (pProxy->m_CoarseSlot >= 0) {
+			for (int level = 1; level < m_Levels; ++level) {
+				lqRemoveFromBin(CoarseProxy(pProxy, level));
+			}
+			m_FreeCoarseSlots.push_back(pProxy->m_CoarseSlot);
+			pProxy->m_CoarseSlot = -1;
+		}
 		pProxy->m_InDatabase = false;
 	}
 }
@@ -35,30 +174,59 @@ void NearestNeighbours::UpdateProxy(NNProxy* pProxy)
 {
 	if (pProxy->m_InDatabase) {
 		float const*const pPos = pProxy->GetPositionVectorPtr();
-		lqUpdateForNewLocation(mp_DB, &pProxy->m_Proxy, pPos[0], pPos[1], pPos[2]);
+		Layer const& layer = m_Layers[pProxy->m_Layer];
+		if (layer.pHash)
+			layer.pHash->Update(&pProxy->m_HashProxy, pPos[0], pPos[1]);
+		else
+			lqUpdateForNewLocation(layer.pDB, &pProxy->m_Proxy, pPos[0], pPos[1], pPos[2]);
+		if (pProxy->m_CoarseSlot >= 0) {
+			for (int level = 1; level < m_Levels; ++level) {
+				lqUpdateForNewLocation(layer.coarse[level - 1], CoarseProxy(pProxy, level), pPos[0], pPos[1], pPos[2]);
+			}
+		}
 	}
 }
 
 
 
-static uint32 s_SearchMask;
-static NNProxy* sp_Ignore = 0;
-static NNProxy* sp_Nearest = 0;
-static float s_NearestDistanceSquared;
+/// state of a FindNearestNeighbour query, passed through lq as the client query state
+/// so that concurrent queries on different databases don't share anything
+struct NNQueryState {
+	uint32		searchMask;
+	NNProxy const* pIgnore;
+	NNProxy*	pNearest;
+	float		nearestDistanceSquared;
+};
 
 // called by LQ for each clientObject in the specified neighborhood:
-// push that clientObject onto the ContentType vector in void*
-// clientQueryState
+// record it if it is the nearest match so far. Used when the layer holds a single kind,
+// which is known to match the search mask
 static void perNeighborCallBackFunction  (void* clientObject,
                                             float distanceSquared,
                                             void* clientQueryState)		// client query state is the thing passed as last arg to lqMapOverAllObjectsInLocality
 {
+	NNQueryState* pQuery = (NNQueryState*) clientQueryState;
 	NNProxy* pProxy = (NNProxy*) clientObject;
-	if (pProxy != sp_Ignore) {
-		if (pProxy->GetSearchMask() & s_SearchMask) {
-			if (distanceSquared < s_NearestDistanceSquared) {
-				s_NearestDistanceSquared = distanceSquared;
-				sp_Nearest = pProxy;
+	if (pProxy != pQuery->pIgnore) {
+		if (distanceSquared < pQuery->nearestDistanceSquared) {
+			pQuery->nearestDistanceSquared = distanceSquared;
+			pQuery->pNearest = pProxy;
+		}
+	}
+}
+
+// as above, for a layer holding every kind, where each proxy's mask must be tested
+static void perNeighborMaskedCallBackFunction  (void* clientObject,
+                                                  float distanceSquared,
+                                                  void* clientQueryState)
+{
+	NNQueryState* pQuery = (NNQueryState*) clientQueryState;
+	NNProxy* pProxy = (NNProxy*) clientObject;
+	if (pProxy != pQuery->pIgnore) {
+		if (pProxy->GetSearchMask() & pQuery->searchMask) {
+			if (distanceSquared < pQuery->nearestDistanceSquared) {
+				pQuery->nearestDistanceSquared = distanceSquared;
+				pQuery->pNearest = pProxy;
 			}
 		}
 	}
@@ -69,17 +237,317 @@ NNProxy*	NearestNeighbours::FindNearestNeighbour(
 	Real		const*const pPosition,	// position to start search from
 	Real		radius		,			// maximum search radius
 	uint32		searchMask,
-	NNProxy*	pExclude				// an ID to exclude
+	NNProxy const* pExclude				// an ID to exclude
 	)	
 {
-	s_NearestDistanceSquared = 1.0e8f;
-	s_SearchMask = searchMask;
-	sp_Ignore = pExclude;
-	sp_Nearest = 0;
-    lqMapOverAllObjectsInLocality (mp_DB, pPosition[0], pPosition[1], pPosition[2], radius,  
-                                    perNeighborCallBackFunction,
-                                    (void*) 0);
+	NNQueryState query;
+	query.nearestDistanceSquared = 1.0e8f;
+	query.searchMask = searchMask;
+	query.pIgnore = pExclude;
+	query.pNearest = 0;
+	m_QueryRadiusSum += radius;
+	m_QueryCount += 1;
+
+	// the layers share the query state, so the nearest of all the matching kinds is found.
+	// A wide query searches ever further until it finds something, which can be nothing but
+	// the nearest within the whole radius
+	lqCallBackFunction callback = m_SegregateKinds ? perNeighborCallBackFunction : perNeighborMaskedCallBackFunction;
+	bool last = false;
+	for (int step = 0; !last && !query.pNearest; ++step) {
+		Real searched;
+		int level;
+		last = SearchStep(step, radius, searched, level);
+		for (size_t i = 0; i < m_Layers.size(); ++i) {
+			Layer const& layer = m_Layers[i];
+			if (layer.mask & searchMask) {
+				Traverse(layer, level, pPosition, searched, callback, &query);
+			}
+		}
+	}
+
+#ifdef INSECTAI_LQ_STATS
+	++m_NearestQueries;
+	if (query.pNearest) {
+		++m_NearestFound;
+	}
+#endif
+	return query.pNearest;
+}
+
+/// state of a FindNearestNeighbourInView query
+struct NNViewState : public NNQueryState {
+	Real		position[2];
+	Real const*	pForward;
+	Real		cosHalfAngle;
+	Real		nearRadius;
+};
+
+/// Make a proxy in view the nearest found, if it is nearer than the last
+static inline void ConsiderInView(NNViewState* pQuery, NNProxy* pProxy, float distanceSquared)
+{
+	float const*const pPos = pProxy->GetPositionVectorPtr();
+	if (NearestNeighbours::InView(pPos[0] - pQuery->position[0], pPos[1] - pQuery->position[1], distanceSquared,
+								  pQuery->pForward, pQuery->cosHalfAngle, pQuery->nearRadius)) {
+		pQuery->nearestDistanceSquared = distanceSquared;
+		pQuery->pNearest = pProxy;
+	}
+}
+
+static void perNeighborInViewCallBackFunction (void* clientObject, float distanceSquared, void* clientQueryState)
+{
+	NNViewState* pQuery = (NNViewState*) clientQueryState;
+	NNProxy* pProxy = (NNProxy*) clientObject;
+	if (pProxy != pQuery->pIgnore && distanceSquared < pQuery->nearestDistanceSquared) {
+		ConsiderInView(pQuery, pProxy, distanceSquared);
+	}
+}
+
+// as above, for a layer holding every kind, where each proxy's mask must be tested
+static void perNeighborInViewMaskedCallBackFunction (void* clientObject, float distanceSquared, void* clientQueryState)
+{
+	NNViewState* pQuery = (NNViewState*) clientQueryState;
+	NNProxy* pProxy = (NNProxy*) clientObject;
+	if (pProxy != pQuery->pIgnore && distanceSquared < pQuery->nearestDistanceSquared) {
+		if (pProxy->GetSearchMask() & pQuery->searchMask) {
+			ConsiderInView(pQuery, pProxy, distanceSquared);
+		}
+	}
+}
+
+/// Extend a box to take in a point
+static void BoxAdd(float* pBox, float x, float y)
+{
+	pBox[0] = PMath::Min(pBox[0], x);		pBox[1] = PMath::Min(pBox[1], y);
+	pBox[2] = PMath::Max(pBox[2], x);		pBox[3] = PMath::Max(pBox[3], y);
+}
+
+/// The bounds of a sector of a circle, as min x, min y, max x, max y, taking in the near circle
+static void SectorBounds(float x, float y, float radius, float const* pForward, float cosHalfAngle, float nearRadius, float* pBox)
+{
+	float r = PMath::Min(nearRadius, radius);
+	pBox[0] = x - r;		pBox[1] = y - r;
+	pBox[2] = x + r;		pBox[3] = y + r;
+
+	// the ends of the arc
+	float sinHalfAngle = sqrtf(PMath::Max(0.0f, 1.0f - cosHalfAngle * cosHalfAngle));
+	float fx = pForward[0], fy = pForward[1];
+	BoxAdd(pBox, x + radius * (fx * cosHalfAngle - fy * sinHalfAngle), y + radius * (fx * sinHalfAngle + fy * cosHalfAngle));
+	BoxAdd(pBox, x + radius * (fx * cosHalfAngle + fy * sinHalfAngle), y + radius * (-fx * sinHalfAngle + fy * cosHalfAngle));
+
+	// and the extremes of the circle that lie on the arc
+	if ( fx >= cosHalfAngle)	BoxAdd(pBox, x + radius, y);
+	if (-fx >= cosHalfAngle)	BoxAdd(pBox, x - radius, y);
+	if ( fy >= cosHalfAngle)	BoxAdd(pBox, x, y + radius);
+	if (-fy >= cosHalfAngle)	BoxAdd(pBox, x, y - radius);
+}
+
+NNProxy*	NearestNeighbours::FindNearestNeighbourInView(
+	Real		const*const pPosition,
+	Real		radius,
+	Real		const*const pForward,
+	Real		cosHalfAngle,
+	Real		nearRadius,
+	uint32		searchMask,
+	NNProxy const* pExclude
+	)
+{
+	NNViewState query;
+	query.nearestDistanceSquared = 1.0e8f;
+	query.searchMask = searchMask;
+	query.pIgnore = pExclude;
+	query.pNearest = 0;
+	query.position[0] = pPosition[0];
+	query.position[1] = pPosition[1];
+	query.pForward = pForward;
+	query.cosHalfAngle = cosHalfAngle;
+	query.nearRadius = nearRadius;
+	m_QueryRadiusSum += radius;
+	m_QueryCount += 1;
+
+	// widening the search, as FindNearestNeighbour does
+	lqCallBackFunction callback = m_SegregateKinds ? perNeighborInViewCallBackFunction : perNeighborInViewMaskedCallBackFunction;
+	bool last = false;
+	for (int step = 0; !last && !query.pNearest; ++step) {
+		Real searched;
+		int level;
+		last = SearchStep(step, radius, searched, level);
+		float box[4];
+		SectorBounds(pPosition[0], pPosition[1], searched, pForward, cosHalfAngle, nearRadius, box);
+		for (size_t i = 0; i < m_Layers.size(); ++i) {
+			Layer const& layer = m_Layers[i];
+			if (layer.mask & searchMask) {
+				if (layer.pHash) {
+					layer.pHash->MapOverAllObjectsInLocalityBox(pPosition[0], pPosition[1], searched, box[0], box[1], box[2], box[3],
+																callback, &query);
+				}
+				else {
+					lqMapOverAllObjectsInLocalityBox (LevelDB(layer, level), pPosition[0], pPosition[1], pPosition[2], searched,
+													  box[0], box[1], pPosition[2] - searched, box[2], box[3], pPosition[2] + searched,
+													  callback,
+													  &query);
+				}
+			}
+		}
+	}
+
+#ifdef INSECTAI_LQ_STATS
+	++m_NearestQueries;
+	if (query.pNearest) {
+		++m_NearestFound;
+	}
+#endif
+	return query.pNearest;
+}
+
+/// state of a FindNeighbours query
+struct NNGatherState {
+	uint32		searchMask;
+	NNProxy const* pIgnore;
+	std::vector<NNProxy*>* pFound;
+};
+
+static void gatherCallBackFunction (void* clientObject, float, void* clientQueryState)
+{
+	NNGatherState* pQuery = (NNGatherState*) clientQueryState;
+	NNProxy* pProxy = (NNProxy*) clientObject;
+	if (pProxy != pQuery->pIgnore) {
+		pQuery->pFound->push_back(pProxy);
+	}
+}
 
-	return sp_Nearest;
+static void gatherMaskedCallBackFunction (void* clientObject, float, void* clientQueryState)
+{
+	NNGatherState* pQuery = (NNGatherState*) clientQueryState;
+	NNProxy* pProxy = (NNProxy*) clientObject;
+	if (pProxy != pQuery->pIgnore && (pProxy->GetSearchMask() & pQuery->searchMask)) {
+		pQuery->pFound->push_back(pProxy);
+	}
 }
 
+void NearestNeighbours::FindNeighbours(
+	Real		const*const pPosition,
+	Real		radius,
+	uint32		searchMask,
+	NNProxy const* pExclude,
+	std::vector<NNProxy*>& found
+	)
+{
+	NNGatherState query;
+	query.searchMask = searchMask;
+	query.pIgnore = pExclude;
+	query.pFound = &found;
+
+	lqCallBackFunction callback = m_SegregateKinds ? gatherCallBackFunction : gatherMaskedCallBackFunction;
+	int level = LevelFor(radius);
+	for (size_t i = 0; i < m_Layers.size(); ++i) {
+		Layer const& layer = m_Layers[i];
+		if (layer.mask & searchMask) {
+			Traverse(layer, level, pPosition, radius, callback, &query);
+		}
+	}
+}
+
+bool NNStats::IsEnabled()
+{
+#ifdef INSECTAI_LQ_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+int NearestNeighbours::GetBinCount() const
+{
+	if (m_CellSize > 0) {
+		int cells = 0;
+		for (size_t i = 0; i < m_Layers.size(); ++i) {
+			cells += m_Layers[i].pHash->GetCellCount();
+		}
+		return cells;
+	}
+	return lqBinCount(m_Layers[0].pDB);
+}
+
+void NearestNeighbours::GetBinOccupancy(int* counts) const
+{
+	if (m_CellSize > 0) {
+		for (size_t i = 0; i < m_Layers.size(); ++i) {
+			m_Layers[i].pHash->GetCellOccupancy(counts);
+			counts += m_Layers[i].pHash->GetCellCount();
+		}
+		*counts = 0;
+		return;
+	}
+
+	// the layers have the same shape, so a cell's occupancy is the sum over the layers
+	int bins = GetBinCount();
+	lqGetBinOccupancy(m_Layers[0].pDB, counts);
+	if (m_Layers.size() > 1) {
+		std::vector<int> layerCounts(bins + 1);
+		for (size_t i = 1; i < m_Layers.size(); ++i) {
+			lqGetBinOccupancy(m_Layers[i].pDB, &layerCounts[0]);
+			for (int bin = 0; bin <= bins; ++bin) {
+				counts[bin] += layerCounts[bin];
+			}
+		}
+	}
+}
+
+void NearestNeighbours::GetStats(NNStats& stats)
+{
+	memset(&stats, 0, sizeof(stats));
+	for (size_t i = 0; i < m_Layers.size() * m_Levels; ++i) {
+		Layer const& l = m_Layers[i / m_Levels];
+		int level = (int) (i % m_Levels);
+		lqStats layer;
+		if (l.pHash)
+			l.pHash->GetStats(&layer);
+		else
+			lqGetStats(LevelDB(l, level), &layer);
+		stats.lq.queries		+= layer.queries;
+		stats.lq.binsVisited	+= layer.binsVisited;
+		stats.lq.proxiesTested	+= layer.proxiesTested;
+		stats.lq.callbacks		+= layer.callbacks;
+		stats.lq.otherVisits	+= layer.otherVisits;
+		stats.lq.otherTested	+= layer.otherTested;
+		stats.lq.updates		+= layer.updates;
+		stats.lq.rebins			+= layer.rebins;
+	}
+	stats.nearestQueries = m_NearestQueries;
+	stats.nearestFound = m_NearestFound;
+
+	stats.bins = GetBinCount();
+	std::vector<int> counts(stats.bins + 1);
+	GetBinOccupancy(&counts[0]);
+	for (int i = 0; i < stats.bins; ++i) {
+		int count = counts[i];
+		if (count == 0) {
+			++stats.emptyBins;
+			continue;
+		}
+		if (count > stats.maxOccupancy) {
+			stats.maxOccupancy = count;
+		}
+		int bucket = 0;
+		while (bucket < NNStats::kOccupancyBuckets - 1 && (count >> (bucket + 1)) != 0) {
+			++bucket;
+		}
+		++stats.occupancy[bucket];
+	}
+	stats.otherOccupancy = counts[stats.bins];
+}
+
+void NearestNeighbours::ResetStats()
+{
+	for (size_t i = 0; i < m_Layers.size(); ++i) {
+		if (m_Layers[i].pHash)
+			m_Layers[i].pHash->ResetStats();
+		else
+			lqResetStats(m_Layers[i].pDB);
+		for (size_t level = 0; level < m_Layers[i].coarse.size(); ++level) {
+			lqResetStats(m_Layers[i].coarse[level]);
+		}
+	}
+	m_NearestQueries = 0;
+	m_NearestFound = 0;
+}
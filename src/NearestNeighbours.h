@@ -8,13 +8,17 @@
 
 #include "PMath.h"
 #include "lq.h"
+#include "SpatialHash.h"
+
+#include <deque>
+#include <vector>
 
 /// @class NNProxy
 /// @brief virtual base class to help the proxy database
 
 class NNProxy {
 public:
-	NNProxy() : m_InDatabase(false) { }
+	NNProxy() : m_InDatabase(false), m_Layer(0), m_CoarseSlot(-1) { }
 	virtual ~NNProxy() { }
 
 	virtual float const*const	GetPositionVectorPtr() const = 0;
@@ -24,15 +28,65 @@ public:
 
 private:
 	bool			m_InDatabase;
+	int				m_Layer;		///< the lattice holding the proxy
+	int				m_CoarseSlot;	///< of the proxy's entries in the coarser levels, or -1
 	lqClientProxy	m_Proxy;
+	SpatialHash::Proxy	m_HashProxy;	///< used instead of m_Proxy by an unbounded database
+};
+
+/// @struct	NNStats
+/// @brief	What the spatial database did since its statistics were last reset, and how its
+///			proxies are spread over the bins now. The query counters are only kept when the
+///			library is built with INSECTAI_LQ_STATS; without it they read zero
+struct NNStats {
+	enum { kOccupancyBuckets = 16 };
+
+	lqStats		lq;							///< counters from the lattice traversal
+	uint32		nearestQueries;				///< calls to FindNearestNeighbour
+	uint32		nearestFound;				///< of which found a neighbour
+
+	int			bins;						///< number of sub-bricks
+	int			emptyBins;
+	int			maxOccupancy;				///< most proxies in any sub-brick
+	int			otherOccupancy;				///< proxies in the "other" bin, outside the lattice
+	int			occupancy[kOccupancyBuckets];	///< sub-bricks holding 1, 2-3, 4-7, ... proxies
+
+	/// @return true if the statistics were compiled in
+	static bool	IsEnabled();
 };
 
 /// @class	NearestNeighbours
 /// @brief	a class which can find nearest neighbours on a 2D grid (z disregarded)
+///
+///			Proxies are kept in one lattice per distinct search mask, all of the same shape,
+///			so each cell holds a separate list per kind of entity. A query only walks the
+///			lattices of the kinds it asks for, and never has to test a proxy's mask.
+///			The layers are made as new kinds are added; a proxy's mask must not change
+///			while it is in the database.
+///
+///			The lattices cover a fixed box, and anything outside it is kept in a single list
+///			that every query reaching outside the box scans. An unbounded database keeps its
+///			layers in sparse SpatialHash grids instead, for worlds that entities wander out of
+///
+///			A lattice database may also keep each layer at several resolutions, each level's
+///			sub-bricks kLevelRatio times the size of the one below. Queries walk the level whose
+///			sub-bricks match their radius, so a wide query visits a few coarse sub-bricks rather
+///			than hundreds of fine ones. A wide nearest neighbour query looks as far as a sub-brick
+///			of the finest level first, then of each coarser one, and only searches its whole
+///			radius if all of those found nothing
 
 class NearestNeighbours {
 public:
-	NearestNeighbours(PMath::Vec3f origin, PMath::Vec3f dimensions, int gridx, int gridy, int gridz);
+	enum { kLevelRatio = 4, kMaxLevels = 8 };
+
+	/// @param segregateKinds	if false, every proxy shares one lattice and queries test each
+	///							proxy's mask, as before the lattices were split by kind
+	/// @param levels			resolutions to keep, the finest being gridx by gridy by gridz
+	NearestNeighbours(PMath::Vec3f origin, PMath::Vec3f dimensions, int gridx, int gridy, int gridz,
+					  bool segregateKinds = true, int levels = 1);
+
+	/// An unbounded database of square cells in the plane (z disregarded)
+	NearestNeighbours(float cellSize, bool segregateKinds = true);
 	~NearestNeighbours();
 
 	void		AddProxy(NNProxy*);			///< add something to the database
@@ -44,11 +98,97 @@ public:
 		Real		const*const pPosition,	///< position to start search from
 		Real		radius,					///< maximum search radius
 		uint32		searchMask,				///< a mask of entities to consider in the search
-		NNProxy*	pExclude				///< an ID to exclude
+		NNProxy const* pExclude				///< an ID to exclude
+		);
+
+	/// Find the nearest neighbour in a sector: within the radius, and either within the half angle
+	/// of the forward direction or closer than nearRadius. Only the sub-bricks overlapping the
+	/// sector's bounds are visited
+	NNProxy*	FindNearestNeighbourInView(
+		Real		const*const pPosition,
+		Real		radius,
+		Real		const*const pForward,	///< unit vector in the plane
+		Real		cosHalfAngle,			///< cosine of the half angle of the sector, -1 for a full circle
+		Real		nearRadius,				///< inside this radius direction doesn't matter
+		uint32		searchMask,
+		NNProxy const* pExclude
+		);
+
+	/// Is an offset of (dx, dy), at the squared distance given, in the sector described above?
+	static bool	InView(Real dx, Real dy, Real distanceSquared, Real const*const pForward, Real cosHalfAngle, Real nearRadius) {
+		if (distanceSquared < nearRadius * nearRadius)
+			return true;
+		Real dot = pForward[0] * dx + pForward[1] * dy;
+		Real cosSquared = cosHalfAngle * cosHalfAngle;
+		if (cosHalfAngle >= 0)
+			return dot > 0 && dot * dot > cosSquared * distanceSquared;
+		return dot > 0 || dot * dot < cosSquared * distanceSquared;
+	}
+
+	/// Append every proxy within the radius whose mask matches, other than pExclude
+	void		FindNeighbours(
+		Real		const*const pPosition,
+		Real		radius,
+		uint32		searchMask,
+		NNProxy const* pExclude,
+		std::vector<NNProxy*>& found
 		);
 
+	int			GetLevelCount() const { return m_Levels; }
+
+	/// The level a query of the given radius walks: the coarsest whose sub-bricks are no more
+	/// than half as wide, so that the sub-bricks still prune what is out of range
+	int			LevelFor(float radius) const;
+
+	/// Count the proxies in each sub-brick of the finest level; counts must have room for GetBinCount() + 1 entries,
+	/// the last being the "other" bin. An unbounded database reports its occupied cells, those
+	/// of each layer separately, and an empty "other" bin
+	int			GetBinCount() const;
+	void		GetBinOccupancy(int* counts) const;
+
+	/// The mean radius of the FindNearestNeighbour queries made since ResetQueryRadii.
+	/// Always tracked, as it costs an add per query, so that the grid can be fitted to its queries
+	float		GetMeanQueryRadius() const { return m_QueryCount > 0 ? (float) (m_QueryRadiusSum / m_QueryCount) : 0.0f; }
+	double		GetQueryCount() const { return m_QueryCount; }
+	void		ResetQueryRadii() { m_QueryRadiusSum = 0; m_QueryCount = 0; }
+
+	/// Report the query counters since the last reset, and the current bin occupancy
+	void		GetStats(NNStats& stats);
+
+	/// Zero the query counters, for example at the start of every tick
+	void		ResetStats();
+
 private:
-	lqDB*	mp_DB;
+	struct Layer {
+		uint32	mask;					///< search mask of every proxy in the layer
+		lqDB*	pDB;
+		SpatialHash* pHash;				///< instead of pDB, if the database is unbounded
+		std::vector<lqDB*> coarse;		///< levels above pDB, finest first
+	};
+
+	int		LayerFor(uint32 mask);
+	lqDB*	LevelDB(Layer const& layer, int level) const { return level == 0 ? layer.pDB : layer.coarse[level - 1]; }
+	lqClientProxy* CoarseProxy(NNProxy* pProxy, int level) { return &m_CoarseProxies[(size_t) pProxy->m_CoarseSlot * (m_Levels - 1) + level - 1]; }
+	void	Traverse(Layer const& layer, int level, Real const*const pPosition, Real radius, lqCallBackFunction func, void* state);
+
+	/// The radius searched and the level walked by each step of a widening nearest neighbour search
+	/// @return true if the step is the last, searching the whole radius
+	bool	SearchStep(int step, Real radius, Real& searched, int& level) const;
+
+	std::vector<Layer>	m_Layers;
+	PMath::Vec3f		m_Origin;
+	PMath::Vec3f		m_Dimensions;
+	int					m_Divisions[3];
+	float				m_CellSize;				///< of an unbounded database, otherwise 0
+	int					m_Levels;
+	float				m_LevelCellSize[kMaxLevels];	///< narrowest side of a sub-brick at each level
+	std::deque<lqClientProxy> m_CoarseProxies;	///< m_Levels - 1 per slot; a deque, as lq links to them
+	std::vector<int>	m_FreeCoarseSlots;
+	bool				m_SegregateKinds;
+	uint32	m_NearestQueries;
+	uint32	m_NearestFound;
+	double	m_QueryRadiusSum;
+	double	m_QueryCount;
 };
 
 #endif
@@ -81,9 +81,33 @@ namespace PMath {
 	typedef Real Vec4f[4];			///< 4 component float vector
 	typedef Real Quaternion[4];		///< Stored as xi, yj, zk, w; w is the real component
 
+	/// The generator state randf draws from. Each thread starts out with a state of its own;
+	/// a simulation that needs a reproducible stream installs its own state with a RandomScope
+	inline uint32*& CurrentRandomState() {
+		static thread_local uint32 threadState = 0x2545f491;
+		static thread_local uint32* pState = &threadState;
+		return pState;
+	}
+
+	/// Makes randf draw from the given state for the lifetime of the scope, on this thread
+	class RandomScope {
+	public:
+		explicit RandomScope(uint32& state) : m_pPrevious(CurrentRandomState()) { CurrentRandomState() = &state; }
+		~RandomScope() { CurrentRandomState() = m_pPrevious; }
+	private:
+		uint32* m_pPrevious;
+	};
+
+	/// xorshift generators must not be seeded with zero
+	inline uint32 RandomSeed(uint32 seed) { return seed ? seed : 0x2545f491; }
+
 	/// return a random number between zero and one
 	inline Real randf() {
-		Real retval = (Real) (rand() & 0x7fff);
+		uint32& s = *CurrentRandomState();
+		s ^= s << 13;														// xorshift32
+		s ^= s >> 17;
+		s ^= s << 5;
+		Real retval = (Real) (s >> 17);
 		return retval * (1.0f / 32768.0f);
 	}
 
@@ -0,0 +1,169 @@
+
+#include "Profiler.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace Profiler {
+
+	struct Span {
+		const char*			name;
+		unsigned long long	start;
+		unsigned long long	end;
+	};
+
+	/// The spans recorded by one thread. Only the owning thread writes to a ring
+	struct Ring {
+		enum { kCapacity = 1 << 16 };
+
+		Ring(int thread) : count(0), threadIndex(thread) { spans.resize(kCapacity); }
+
+		std::vector<Span>	spans;
+		unsigned long long	count;				///< spans ever recorded; the newest is at (count - 1) % kCapacity
+		int					threadIndex;		///< the tid in the trace
+	};
+
+	// Rings are registered once per thread and never freed, so a ring outlives the thread
+	// that filled it, and the spans of finished batch workers can still be exported
+	static std::mutex			s_RingsMutex;
+	static std::vector<Ring*>	s_Rings;
+
+	static Ring* ThreadRing() {
+		static thread_local Ring* tp_Ring = 0;
+		if (!tp_Ring) {
+			std::lock_guard<std::mutex> lock(s_RingsMutex);
+			tp_Ring = new Ring((int) s_Rings.size());
+			s_Rings.push_back(tp_Ring);
+		}
+		return tp_Ring;
+	}
+
+	bool IsEnabled() {
+#ifdef INSECTAI_PROFILE
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	unsigned long long Now() {
+		return (unsigned long long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Record(const char* name, unsigned long long start, unsigned long long end) {
+		Ring* pRing = ThreadRing();
+		Span& span = pRing->spans[pRing->count % Ring::kCapacity];
+		span.name = name;
+		span.start = start;
+		span.end = end;
+		++pRing->count;
+	}
+
+	void Reset() {
+		std::lock_guard<std::mutex> lock(s_RingsMutex);
+		for (size_t i = 0; i < s_Rings.size(); ++i) {
+			s_Rings[i]->count = 0;
+		}
+	}
+
+	/// Call fn(span, threadIndex) for every span still held in the rings, oldest first per thread
+	template <class Fn>
+	static void ForEachSpan(Fn fn) {
+		std::lock_guard<std::mutex> lock(s_RingsMutex);
+		for (size_t r = 0; r < s_Rings.size(); ++r) {
+			Ring const* pRing = s_Rings[r];
+			unsigned long long first = pRing->count > Ring::kCapacity ? pRing->count - Ring::kCapacity : 0;
+			for (unsigned long long i = first; i < pRing->count; ++i) {
+				fn(pRing->spans[i % Ring::kCapacity], pRing->threadIndex);
+			}
+		}
+	}
+
+	bool WriteChromeTrace(const char* path) {
+		FILE* pFile = fopen(path, "w");
+		if (!pFile)
+			return false;
+
+		// timestamps are relative to the earliest span, so they stay readable in the viewer
+		unsigned long long origin = ~0ull;
+		ForEachSpan([&origin](Span const& span, int) {
+			if (span.start < origin) origin = span.start;
+		});
+
+		fprintf(pFile, "{\"traceEvents\":[\n");
+		bool first = true;
+		ForEachSpan([pFile, origin, &first](Span const& span, int thread) {
+			fprintf(pFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",\n", span.name, thread,
+					(span.start - origin) / 1000.0, (span.end - span.start) / 1000.0);
+			first = false;
+		});
+		fprintf(pFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+		bool ok = !ferror(pFile);
+		ok = (fclose(pFile) == 0) && ok;
+		return ok;
+	}
+
+	void WriteHistograms(FILE* pFile) {
+		// four buckets per power of two: bucket 4 * b + q holds durations in
+		// [(4 + q) << (b - 2), (5 + q) << (b - 2)) ns, for durations of at least 4 ns
+		enum { kBuckets = 4 * 64 };
+
+		struct Histogram {
+			Histogram() : count(0), total(0), max(0) { memset(buckets, 0, sizeof(buckets)); }
+			unsigned long long	count, total, max;
+			unsigned long long	buckets[kBuckets];
+		};
+
+		// spans are grouped by name rather than by pointer, as each translation unit may
+		// have its own copy of a literal
+		std::map<std::string, Histogram> histograms;
+		ForEachSpan([&histograms](Span const& span, int) {
+			unsigned long long ns = span.end - span.start;
+			Histogram& h = histograms[span.name];
+			++h.count;
+			h.total += ns;
+			if (ns > h.max) h.max = ns;
+			int b = 0;
+			while (b < 63 && (ns >> (b + 1)) != 0) {
+				++b;
+			}
+			int bucket = (b < 2) ? (int) ns : 4 * b + (int) ((ns >> (b - 2)) & 3);
+			++h.buckets[bucket];
+		});
+
+		fprintf(pFile, "%-16s %8s %11s %11s %11s %11s %11s\n", "span", "count", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+		for (std::map<std::string, Histogram>::const_iterator i = histograms.begin(); i != histograms.end(); ++i) {
+			Histogram const& h = i->second;
+
+			// a percentile is reported as the upper edge of the bucket that contains it,
+			// but never more than the longest span
+			double percentile[3] = { 0.5, 0.9, 0.99 };
+			double edge[3] = { 0, 0, 0 };
+			for (int p = 0; p < 3; ++p) {
+				unsigned long long target = (unsigned long long) (percentile[p] * h.count);
+				unsigned long long seen = 0;
+				for (int bucket = 0; bucket < kBuckets; ++bucket) {
+					seen += h.buckets[bucket];
+					if (seen > target) {
+						int b = bucket / 4;
+						unsigned long long upper = (b < 2) ? (unsigned long long) bucket + 1 : (5ull + (bucket & 3)) << (b - 2);
+						edge[p] = (double) (upper < h.max ? upper : h.max) / 1000.0;
+						break;
+					}
+				}
+			}
+
+			fprintf(pFile, "%-16s %8llu %11.3f %11.3f %11.3f %11.3f %11.3f\n",
+					i->first.c_str(), h.count, h.total / 1000.0 / h.count,
+					edge[0], edge[1], edge[2], h.max / 1000.0);
+		}
+	}
+
+} // end namespace Profiler
@@ -0,0 +1,65 @@
+
+/** @file	Profiler.h
+	@brief	Scoped timing spans for the phases of a tick, exported as a Chrome trace and histograms
+
+	Instrument a block with INSECTAI_PROFILE_SCOPE("name"); the name must be a string literal,
+	or otherwise outlive the profiler. Spans are only recorded when the library is built with
+	INSECTAI_PROFILE defined (cmake -DINSECTAI_PROFILE=ON); otherwise the macro expands to
+	nothing and the instrumentation costs nothing.
+	*/
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdio.h>
+
+namespace Profiler {
+
+	/// @return true if spans are being recorded, that is, INSECTAI_PROFILE was defined
+	bool	IsEnabled();
+
+	/// Nanoseconds on a steady clock shared by every thread
+	unsigned long long Now();
+
+	/// Record a completed span on the calling thread's ring buffer. Each thread owns its ring,
+	/// so recording takes no lock; the oldest spans are overwritten once a ring is full
+	void	Record(const char* name, unsigned long long start, unsigned long long end);
+
+	/// Forget every span recorded so far
+	void	Reset();
+
+	/// Write the spans held in the rings as Chrome trace event JSON, for chrome://tracing or Perfetto.
+	/// Call this while no thread is recording
+	bool	WriteChromeTrace(const char* path);
+
+	/// Print, per span name, a power of two histogram of the durations held in the rings, with
+	/// the count, mean and approximate percentiles. Call this while no thread is recording
+	void	WriteHistograms(FILE* pFile);
+
+	/// @class	Scope
+	/// @brief	Records a span from its construction to its destruction
+	class Scope {
+	public:
+		explicit Scope(const char* name) : m_Name(name), m_Start(Now()) { }
+		~Scope() { Record(m_Name, m_Start, Now()); }
+
+	private:
+		Scope(Scope const&);
+		Scope& operator=(Scope const&);
+
+		const char*			m_Name;
+		unsigned long long	m_Start;
+	};
+
+} // end namespace Profiler
+
+#define INSECTAI_PROFILE_CONCAT2(a, b) a##b
+#define INSECTAI_PROFILE_CONCAT(a, b) INSECTAI_PROFILE_CONCAT2(a, b)
+
+#ifdef INSECTAI_PROFILE
+	#define INSECTAI_PROFILE_SCOPE(name) Profiler::Scope INSECTAI_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+	#define INSECTAI_PROFILE_SCOPE(name)
+#endif
+
+#endif
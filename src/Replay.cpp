@@ -0,0 +1,304 @@
+
+#include "Replay.h"
+#include "BrainDescription.h"
+#include "Snapshot.h"
+#include "World.h"
+
+#include <chrono>
+#include <string.h>
+
+// The log is a header followed by records. Each record is a type and a payload size, then
+// the payload; records are never rewritten, so a log cut short by a crash is still readable
+// up to the last complete record.
+
+static const uint32 kReplayMagic	= 'IArp';
+static const uint32 kReplayVersion	= 1;
+
+enum {
+	kRecordSnapshot	= 'snap',		///< payload is a Snapshot; replay restores it
+	kRecordStep		= 'step',		///< float dt
+	kRecordSpawn	= 'spwn',		///< ReplaySpawn
+	kRecordSpawnBrain	= 'spwb',		///< int count, then a BrainDescription's binary form
+	kRecordPlace	= 'plce',		///< ReplayPlace
+	kRecordChecksum	= 'csum'		///< ReplayChecksum, taken after the step it follows
+};
+
+struct ReplayFileHeader {
+	uint32	magic;
+	uint32	version;
+};
+
+struct ReplayRecordHeader {
+	uint32	type;
+	uint32	size;
+};
+
+struct ReplaySpawn {
+	uint32	brainType;
+	int		count;
+};
+
+struct ReplayPlace {
+	int		index;
+	float	x, y;
+};
+
+struct ReplayChecksum {
+	uint32	tick;
+	uint32	checksum;
+};
+
+static const size_t kWriteThreshold	= 64 * 1024;		///< wake the writer once this much is pending
+
+static double Seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ReplayRecorder::ReplayRecorder()
+: m_pFile(0), m_Tick(0), m_Closing(false), m_Failed(false)
+{
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+	Close();
+}
+
+bool ReplayRecorder::Open(const char* path)
+{
+	Close();
+
+	m_pFile = fopen(path, "wb");
+	if (!m_pFile)
+		return false;
+
+	setvbuf(m_pFile, 0, _IOFBF, 1 << 20);
+	m_Tick = 0;
+	m_Closing = false;
+	m_Failed = false;
+	m_Pending.clear();
+
+	ReplayFileHeader header = { kReplayMagic, kReplayVersion };
+	m_Pending.insert(m_Pending.end(), (unsigned char const*) &header, (unsigned char const*) (&header + 1));
+
+	m_Writer = std::thread(&ReplayRecorder::WriterLoop, this);
+	return true;
+}
+
+bool ReplayRecorder::Close()
+{
+	if (!m_pFile)
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Closing = true;
+	}
+	m_Wake.notify_one();
+	m_Writer.join();
+
+	bool ok = !m_Failed && fclose(m_pFile) == 0;
+	m_pFile = 0;
+	return ok;
+}
+
+void ReplayRecorder::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;) {
+		// wake when enough has piled up, or now and then so a crash loses little
+		m_Wake.wait_for(lock, std::chrono::milliseconds(250), [this]() {
+			return m_Closing || m_Pending.size() >= kWriteThreshold;
+		});
+
+		bool closing = m_Closing;
+		m_Writing.swap(m_Pending);
+		lock.unlock();
+
+		if (!m_Writing.empty()) {
+			if (fwrite(&m_Writing[0], 1, m_Writing.size(), m_pFile) != m_Writing.size()) {
+				m_Failed = true;
+			}
+			fflush(m_pFile);
+			m_Writing.clear();
+		}
+
+		lock.lock();
+		if (closing && m_Pending.empty())
+			break;
+	}
+}
+
+void ReplayRecorder::Append(uint32 type, void const* pData, size_t size)
+{
+	if (!m_pFile)
+		return;
+
+	ReplayRecordHeader header = { type, (uint32) size };
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Pending.insert(m_Pending.end(), (unsigned char const*) &header, (unsigned char const*) (&header + 1));
+		m_Pending.insert(m_Pending.end(), (unsigned char const*) pData, (unsigned char const*) pData + size);
+		wake = m_Pending.size() >= kWriteThreshold;
+	}
+	if (wake) {
+		m_Wake.notify_one();
+	}
+}
+
+void ReplayRecorder::RecordSnapshot(World const& world)
+{
+	Snapshot snapshot;
+	snapshot.Capture(world);
+	Append(kRecordSnapshot, snapshot.GetData(), snapshot.GetSize());
+}
+
+void ReplayRecorder::RecordStep(World const& world, float dt)
+{
+	Append(kRecordStep, &dt, sizeof(dt));
+
+	++m_Tick;
+	if (m_Tick % kChecksumInterval == 0) {
+		ReplayChecksum checksum = { m_Tick, world.Checksum() };
+		Append(kRecordChecksum, &checksum, sizeof(checksum));
+	}
+}
+
+void ReplayRecorder::RecordSpawn(uint32 brainType, int count)
+{
+	ReplaySpawn spawn = { brainType, count };
+	Append(kRecordSpawn, &spawn, sizeof(spawn));
+}
+
+void ReplayRecorder::RecordSpawn(BrainDescription const& brain, int count)
+{
+	std::vector<unsigned char> payload(sizeof(count) + brain.GetSize());
+	memcpy(&payload[0], &count, sizeof(count));
+	if (brain.GetSize()) {
+		memcpy(&payload[sizeof(count)], brain.GetData(), brain.GetSize());
+	}
+	Append(kRecordSpawnBrain, &payload[0], payload.size());
+}
+
+void ReplayRecorder::RecordPlace(int index, float x, float y)
+{
+	ReplayPlace place = { index, x, y };
+	Append(kRecordPlace, &place, sizeof(place));
+}
+
+ReplayResult Replay(const char* path)
+{
+	ReplayResult result;
+	double start = Seconds();
+
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile)
+		return result;
+	setvbuf(pFile, 0, _IOFBF, 1 << 20);
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+
+	ReplayFileHeader header;
+	if (size < 0 || fread(&header, sizeof(header), 1, pFile) != 1 || header.magic != kReplayMagic || header.version != kReplayVersion) {
+		fclose(pFile);
+		return result;
+	}
+
+	World world;
+	bool haveWorld = false;
+	bool ok = true;
+	std::vector<unsigned char> payload;
+	ReplayRecordHeader record;
+
+	while (ok && result.divergedTick < 0 && fread(&record, sizeof(record), 1, pFile) == 1) {
+		// a corrupt size could ask for far more than the file holds
+		if (record.size > (uint32) (size - ftell(pFile))) {
+			ok = false;
+			break;
+		}
+		payload.resize(record.size);
+		if (record.size > 0 && fread(&payload[0], 1, record.size, pFile) != record.size) {
+			ok = false;							// truncated record
+			break;
+		}
+		void const* pPayload = payload.empty() ? 0 : &payload[0];
+
+		if (record.type == kRecordSnapshot) {
+			Snapshot snapshot;
+			ok = snapshot.Load(pPayload, record.size) && snapshot.Restore(world);
+			haveWorld = ok;
+			continue;
+		}
+
+		// everything else acts on a world, so the log must have started with a snapshot
+		if (!haveWorld) {
+			ok = false;
+			break;
+		}
+
+		switch (record.type) {
+			case kRecordStep:
+				if (record.size == sizeof(float)) {
+					float dt;
+					memcpy(&dt, pPayload, sizeof(dt));
+					world.Step(dt);
+					++result.steps;
+				}
+				else ok = false;
+				break;
+
+			case kRecordSpawn:
+				if (record.size == sizeof(ReplaySpawn)) {
+					ReplaySpawn spawn;
+					memcpy(&spawn, pPayload, sizeof(spawn));
+					world.SpawnVehicles(spawn.brainType, spawn.count);
+				}
+				else ok = false;
+				break;
+
+			case kRecordSpawnBrain:
+				if (record.size > sizeof(int)) {
+					int count;
+					memcpy(&count, pPayload, sizeof(count));
+					BrainDescription brain;
+					ok = brain.Load((unsigned char const*) pPayload + sizeof(count), record.size - sizeof(count));
+					if (ok) {
+						world.SpawnVehicles(brain, count);
+					}
+				}
+				else ok = false;
+				break;
+
+			case kRecordPlace:
+				if (record.size == sizeof(ReplayPlace)) {
+					ReplayPlace place;
+					memcpy(&place, pPayload, sizeof(place));
+					world.PlaceEntity(place.index, place.x, place.y);
+				}
+				else ok = false;
+				break;
+
+			case kRecordChecksum:
+				if (record.size == sizeof(ReplayChecksum)) {
+					ReplayChecksum checksum;
+					memcpy(&checksum, pPayload, sizeof(checksum));
+					++result.checksums;
+					if (checksum.checksum != world.Checksum()) {
+						result.divergedTick = (int) checksum.tick;
+					}
+				}
+				else ok = false;
+				break;
+
+			default:
+				break;							// skip records from newer writers
+		}
+	}
+
+	fclose(pFile);
+	result.ok = ok;
+	result.seconds = Seconds() - start;
+	return result;
+}
@@ -0,0 +1,86 @@
+
+/** @file	Replay.h
+	@brief	Records the inputs of a running World to a log, and replays the log to reproduce a run
+	*/
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include "PMath.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+class BrainDescription;
+class World;
+
+/** @class	ReplayRecorder
+	@brief	Streams everything that drives a World to an append-only binary log: a snapshot of the
+			world when recording starts or the scenario changes, the dt of every step, spawns, and
+			entities placed by the user. Every kChecksumInterval steps the world's checksum is
+			logged too, so that a replay can tell where it parted ways with the recording.
+
+			Records are appended to an in-memory buffer, and a background thread writes the
+			buffer out, so the thread driving the simulation never waits on the disk.
+	*/
+
+class ReplayRecorder {
+public:
+	enum { kChecksumInterval = 60 };
+
+	ReplayRecorder();
+	~ReplayRecorder();
+
+	/// Create the log, and start the writer thread
+	bool	Open(const char* path);
+
+	/// Write out everything recorded so far, and close the log
+	/// @return false if any write failed
+	bool	Close();
+
+	bool	IsOpen() const { return m_pFile != 0; }
+
+	void	RecordSnapshot(World const& world);
+	void	RecordStep(World const& world, float dt);
+	void	RecordSpawn(uint32 brainType, int count);
+	void	RecordSpawn(BrainDescription const& brain, int count);
+	void	RecordPlace(int index, float x, float y);
+
+private:
+	ReplayRecorder(ReplayRecorder const&);
+	ReplayRecorder& operator=(ReplayRecorder const&);
+
+	void	Append(uint32 type, void const* pData, size_t size);
+	void	WriterLoop();
+
+	FILE*						m_pFile;
+	uint32						m_Tick;					///< steps recorded so far
+	std::vector<unsigned char>	m_Pending;				///< records not yet handed to the writer
+	std::vector<unsigned char>	m_Writing;				///< records the writer is writing
+	std::mutex					m_Mutex;
+	std::condition_variable		m_Wake;
+	std::thread					m_Writer;
+	bool						m_Closing;
+	bool						m_Failed;				///< set by the writer if a write fails
+};
+
+/// @struct	ReplayResult
+/// @brief	What happened when a log was replayed
+struct ReplayResult {
+	ReplayResult() : ok(false), steps(0), checksums(0), divergedTick(-1), seconds(0) { }
+
+	bool	ok;					///< the log was read to the end without errors
+	int		steps;				///< steps replayed
+	int		checksums;			///< checksums compared
+	int		divergedTick;		///< the step after which the first mismatched checksum was taken, or -1
+	double	seconds;			///< wall clock time spent replaying
+};
+
+/// Re-run a log written by ReplayRecorder as fast as possible, stopping at the first checksum
+/// that doesn't match the recording
+ReplayResult Replay(const char* path);
+
+#endif
@@ -0,0 +1,224 @@
+
+#include "ScalarField.h"
+
+#include <string.h>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INSECTAI_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	/// Bands thinner than this aren't worth a thread of their own
+	const int kMinRowsPerBand = 16;
+
+	/// One cell of the stencil. The vector kernel adds in the same order, so both give the same bits
+	inline float Diffuse(float up, float centreValue, float down, float left, float right, float centre, float k, float decay)
+	{
+		return decay * (centre * centreValue + k * ((up + down) + (left + right)));
+	}
+
+	/// One row of the stencil; the first and last cells are their own outer neighbours
+	void DiffuseRow(float const* pUp, float const* pRow, float const* pDown, float* pOut, int columns,
+					float centre, float k, float decay, bool vectorized)
+	{
+		int last = columns - 1;
+		pOut[0] = Diffuse(pUp[0], pRow[0], pDown[0], pRow[0], pRow[last > 0 ? 1 : 0], centre, k, decay);
+
+		int c = 1;
+#ifdef INSECTAI_SSE2
+		if (vectorized) {
+			__m128 vCentre = _mm_set1_ps(centre);
+			__m128 vK = _mm_set1_ps(k);
+			__m128 vDecay = _mm_set1_ps(decay);
+			for (; c + 4 <= last; c += 4) {
+				__m128 vertical = _mm_add_ps(_mm_loadu_ps(pUp + c), _mm_loadu_ps(pDown + c));
+				__m128 horizontal = _mm_add_ps(_mm_loadu_ps(pRow + c - 1), _mm_loadu_ps(pRow + c + 1));
+				__m128 value = _mm_add_ps(_mm_mul_ps(vCentre, _mm_loadu_ps(pRow + c)),
+										  _mm_mul_ps(vK, _mm_add_ps(vertical, horizontal)));
+				_mm_storeu_ps(pOut + c, _mm_mul_ps(vDecay, value));
+			}
+		}
+#else
+		(void) vectorized;
+#endif
+		for (; c < last; ++c) {
+			pOut[c] = Diffuse(pUp[c], pRow[c], pDown[c], pRow[c - 1], pRow[c + 1], centre, k, decay);
+		}
+
+		if (last > 0) {
+			pOut[last] = Diffuse(pUp[last], pRow[last], pDown[last], pRow[last - 1], pRow[last], centre, k, decay);
+		}
+	}
+}
+
+ScalarField::ScalarField()
+: m_Columns(0), m_Rows(0), m_CellSize(1.0f), m_InverseCellSize(1.0f)
+, m_Diffusion(0), m_Evaporation(0), m_ThreadCount(1), m_DoubleBuffered(true), m_Vectorized(true)
+{
+}
+
+void ScalarField::Configure(float width, float height, float cellSize)
+{
+	m_CellSize = cellSize;
+	m_InverseCellSize = 1.0f / cellSize;
+	m_Columns = PMath::Max(1, (int) ceilf(width * m_InverseCellSize));
+	m_Rows = PMath::Max(1, (int) ceilf(height * m_InverseCellSize));
+	m_Cells.assign((size_t) m_Columns * m_Rows, 0.0f);
+	m_Back.clear();
+	if (m_DoubleBuffered) {
+		m_Back.resize(m_Cells.size());
+	}
+}
+
+void ScalarField::Clear()
+{
+	m_Cells.assign(m_Cells.size(), 0.0f);
+}
+
+void ScalarField::SetThreadCount(int threads)
+{
+	m_ThreadCount = (threads > 0) ? threads : PMath::Max(1, (int) std::thread::hardware_concurrency());
+}
+
+void ScalarField::SetDoubleBuffered(bool doubleBuffered)
+{
+	m_DoubleBuffered = doubleBuffered;
+	if (doubleBuffered) {
+		m_Back.resize(m_Cells.size());
+	}
+	else {
+		std::vector<float>().swap(m_Back);
+	}
+}
+
+bool ScalarField::IsVectorAvailable()
+{
+#ifdef INSECTAI_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ScalarField::Deposit(float x, float y, float amount)
+{
+	float u = x * m_InverseCellSize - 0.5f;
+	float v = y * m_InverseCellSize - 0.5f;
+	float fu = floorf(u), fv = floorf(v);
+	int column = (int) fu, row = (int) fv;
+	float tx = u - fu, ty = v - fv;
+
+	float weights[4] = { (1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty };
+	for (int i = 0; i < 4; ++i) {
+		int c = column + (i & 1), r = row + (i >> 1);
+		if (c >= 0 && c < m_Columns && r >= 0 && r < m_Rows) {
+			m_Cells[(size_t) r * m_Columns + c] += amount * weights[i];
+		}
+	}
+}
+
+float ScalarField::Sample(float x, float y) const
+{
+	if (m_Cells.empty())
+		return 0;
+
+	float u = PMath::Clamp(x * m_InverseCellSize - 0.5f, 0.0f, (float) (m_Columns - 1));
+	float v = PMath::Clamp(y * m_InverseCellSize - 0.5f, 0.0f, (float) (m_Rows - 1));
+	int c0 = (int) u, r0 = (int) v;
+	int c1 = PMath::Min(c0 + 1, m_Columns - 1), r1 = PMath::Min(r0 + 1, m_Rows - 1);
+	float tx = u - c0, ty = v - r0;
+
+	float const* pRow0 = &m_Cells[(size_t) r0 * m_Columns];
+	float const* pRow1 = &m_Cells[(size_t) r1 * m_Columns];
+	float top = pRow0[c0] + (pRow0[c1] - pRow0[c0]) * tx;
+	float bottom = pRow1[c0] + (pRow1[c1] - pRow1[c0]) * tx;
+	return top + (bottom - top) * ty;
+}
+
+void ScalarField::StepBand(int begin, int end, float const* pIn, float* pOut, float const* pAbove, float const* pBelow,
+						   float centre, float k, float decay)
+{
+	// in place, each row is copied before it is overwritten, so the next row still sees the old
+	// values above it; the rows beyond the band were copied before any band started
+	bool inPlace = (pIn == pOut);
+	std::vector<float> scratch(inPlace ? 2 * m_Columns : 0);
+	float* pPrevious = inPlace ? &scratch[0] : 0;
+	float* pCurrent = inPlace ? &scratch[m_Columns] : 0;
+
+	float const* pUp = pAbove;
+	for (int r = begin; r < end; ++r) {
+		float const* pRow = pIn + (size_t) r * m_Columns;
+		float const* pDown = (r + 1 < end) ? pRow + m_Columns : pBelow;
+		if (inPlace) {
+			memcpy(pCurrent, pRow, m_Columns * sizeof(float));
+			pRow = pCurrent;
+		}
+
+		DiffuseRow(pUp ? pUp : pRow, pRow, pDown ? pDown : pRow, pOut + (size_t) r * m_Columns,
+				   m_Columns, centre, k, decay, m_Vectorized);
+
+		pUp = pRow;
+		if (inPlace) {
+			float* pSwap = pPrevious;
+			pPrevious = pCurrent;
+			pCurrent = pSwap;
+		}
+	}
+}
+
+void ScalarField::Step(float dt)
+{
+	if (m_Cells.empty())
+		return;
+
+	float k = PMath::Min(m_Diffusion * dt * m_InverseCellSize * m_InverseCellSize, 0.25f);
+	float centre = 1.0f - 4.0f * k;
+	float decay = expf(-m_Evaporation * dt);
+
+	float const* pIn = &m_Cells[0];
+	float* pOut = m_DoubleBuffered ? &m_Back[0] : &m_Cells[0];
+
+	int bands = PMath::Max(1, PMath::Min(m_ThreadCount, m_Rows / kMinRowsPerBand));
+	size_t rowBytes = m_Columns * sizeof(float);
+
+	// the rows either side of each band, which in place may be overwritten by a neighbouring band
+	std::vector<float> edges(m_DoubleBuffered ? 0 : 2 * bands * m_Columns);
+	std::vector<int> starts(bands + 1);
+	for (int b = 0; b <= bands; ++b) {
+		starts[b] = (int) ((long long) m_Rows * b / bands);
+	}
+
+	std::vector<float const*> above(bands), below(bands);
+	for (int b = 0; b < bands; ++b) {
+		above[b] = (starts[b] > 0) ? pIn + (size_t) (starts[b] - 1) * m_Columns : 0;
+		below[b] = (starts[b + 1] < m_Rows) ? pIn + (size_t) starts[b + 1] * m_Columns : 0;
+		if (!m_DoubleBuffered) {
+			float* pEdges = &edges[(size_t) 2 * b * m_Columns];
+			if (above[b]) {
+				above[b] = (float const*) memcpy(pEdges, above[b], rowBytes);
+			}
+			if (below[b]) {
+				below[b] = (float const*) memcpy(pEdges + m_Columns, below[b], rowBytes);
+			}
+		}
+	}
+
+	m_Workers.Run(bands, [&](int b) {
+		StepBand(starts[b], starts[b + 1], pIn, pOut, above[b], below[b], centre, k, decay);
+	});
+
+	if (m_DoubleBuffered) {
+		m_Cells.swap(m_Back);
+	}
+}
+
+double ScalarField::GetTotal() const
+{
+	double total = 0;
+	for (size_t i = 0; i < m_Cells.size(); ++i) {
+		total += m_Cells[i];
+	}
+	return total;
+}
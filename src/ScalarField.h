@@ -0,0 +1,101 @@
+
+/** @file	ScalarField.h
+	@brief	A scalar field on a grid that is deposited into, evaporates and diffuses, for scent trails
+	*/
+
+#ifndef _SCALARFIELD_H_
+#define _SCALARFIELD_H_
+
+#include "PMath.h"
+#include "WorkerPool.h"
+
+#include <vector>
+
+/** @class	ScalarField
+	@brief	A grid of square cells over a rectangle from the origin, each holding a concentration
+			at its centre. Agents deposit into the field and sample it, both bilinearly, and every
+			step the field evaporates and diffuses:
+
+				c' = decay * ((1 - 4k) c + k (north + south + east + west))
+
+			where k = diffusion * dt / cellSize^2, held at 1/4 or below for stability, and decay
+			is the fraction left after evaporating for dt. The edges reflect, so nothing diffuses
+			out of the field.
+
+			The stencil runs four cells at a time with SSE2 where the compiler offers it, and
+			bands of rows run on threads the field keeps from step to step. Every cell is
+			computed from the previous step alone, in the same order whatever the kernel or the
+			number of threads, so the results are identical bit for bit. By default the field is
+			double buffered; in place, each band instead keeps copies of the rows about it,
+			needing a few rows of scratch rather than a second grid.
+	*/
+
+class ScalarField {
+public:
+	ScalarField();
+
+	/// Cover width by height with cells of the given size; every cell starts empty
+	void	Configure(float width, float height, float cellSize);
+
+	/// Empty every cell
+	void	Clear();
+
+	/// @param diffusion	area per second
+	/// @param evaporation	fraction lost per second, compounded continuously
+	void	SetRates(float diffusion, float evaporation) { m_Diffusion = diffusion; m_Evaporation = evaporation; }
+	float	GetDiffusion() const { return m_Diffusion; }
+	float	GetEvaporation() const { return m_Evaporation; }
+
+	/// Threads the stencil is split over, or zero for one per hardware thread
+	void	SetThreadCount(int threads);
+	int		GetThreadCount() const { return m_ThreadCount; }
+
+	void	SetDoubleBuffered(bool doubleBuffered);
+	bool	IsDoubleBuffered() const { return m_DoubleBuffered; }
+
+	/// Use the SIMD kernel if it was compiled in; the scalar kernel is kept for comparison
+	void	SetVectorized(bool vectorized) { m_Vectorized = vectorized; }
+	static bool	IsVectorAvailable();
+
+	/// Add an amount at a point, shared between the four nearest cell centres.
+	/// What falls outside the field is lost
+	void	Deposit(float x, float y, float amount);
+
+	/// The concentration at a point, interpolated between the four nearest cell centres;
+	/// points outside the field take the value at its edge
+	float	Sample(float x, float y) const;
+
+	/// Evaporate and diffuse for dt seconds
+	void	Step(float dt);
+
+	bool	IsConfigured() const { return !m_Cells.empty(); }
+	int		GetColumns() const { return m_Columns; }
+	int		GetRows() const { return m_Rows; }
+	float	GetCellSize() const { return m_CellSize; }
+
+	/// The cells, row major, rows of increasing y
+	float const*	GetCells() const { return m_Cells.empty() ? 0 : &m_Cells[0]; }
+	float*			GetCells() { return m_Cells.empty() ? 0 : &m_Cells[0]; }
+
+	/// The sum over every cell
+	double	GetTotal() const;
+
+private:
+	void	StepBand(int begin, int end, float const* pIn, float* pOut, float const* pAbove, float const* pBelow,
+					 float centre, float k, float decay);
+
+	std::vector<float>	m_Cells;
+	std::vector<float>	m_Back;				///< the next step, when double buffered
+	int					m_Columns;
+	int					m_Rows;
+	float				m_CellSize;
+	float				m_InverseCellSize;
+	float				m_Diffusion;
+	float				m_Evaporation;
+	int					m_ThreadCount;
+	bool				m_DoubleBuffered;
+	bool				m_Vectorized;
+	WorkerPool			m_Workers;			///< run every band but the first
+};
+
+#endif
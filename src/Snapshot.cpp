@@ -0,0 +1,668 @@
+
+#include "Snapshot.h"
+#include "InsectAI.h"
+#include "World.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using InsectAI::Actuator;
+using InsectAI::CollisionSensor;
+using InsectAI::FieldSensor;
+using InsectAI::Function;
+using InsectAI::Layer;
+using InsectAI::LayerOutput;
+using InsectAI::LightSensor;
+using InsectAI::Neuron;
+using InsectAI::Sensor;
+using InsectAI::Switch;
+using InsectAI::Vehicle;
+
+// The file format. Every record is a fixed size, four byte aligned POD, and every section
+// is found through an offset from the start of the snapshot, so nothing needs fixing up
+// after the snapshot is mapped.
+
+static const uint32 kSnapshotMagic		= 'ISnp';
+static const uint32 kSnapshotVersion	= 9;
+
+enum {
+	kOpenWorld			= 1
+};
+
+struct SnapshotHeader {
+	uint32	magic;
+	uint32	version;
+	uint32	size;					///< of the whole snapshot in bytes, header included
+	uint32	randomState;			///< World::m_RandomState
+	uint32	lastID;					///< Engine::GetLastID
+	float	width, height;			///< World bounds
+	uint32	worldFlags;
+	int		sortInterval;			///< World::GetSortInterval
+	int		ticksSinceSort;
+	float	lightFieldCellSize;		///< 0 when the world has no light field
+	float	lightFieldRadius;
+	float	scentCellSize;			///< 0 when the world has no scent field
+	float	scentDiffusion;
+	float	scentEvaporation;
+	uint32	scentColumns,	scentRows;
+	float	actuatorDynamics[3][2];	///< World::SetActuatorDynamics of motors, steering and deposits
+	uint32	entityCount,	entityOffset;
+	uint32	sensorCount,	sensorOffset;
+	uint32	actuatorCount,	actuatorOffset;
+	uint32	inputCount,		inputOffset;
+	uint32	weightCount,	weightOffset;
+	uint32	orderOffset;			///< entityCount entity indices, in the order they are stored
+	uint32	scentOffset;			///< scentColumns * scentRows concentrations, row major
+};
+
+struct SnapshotEntity {
+	int		id;						///< Engine ID
+	uint32	kind;					///< World::kVehicle or World::kLight
+	float	rotation;
+	float	position[3];
+	float	maxSpeed;
+	uint32	firstSensor,	sensorCount;
+	uint32	firstActuator,	actuatorCount;
+};
+
+enum {
+	kDirectional		= 1,
+	kInternalSensor		= 2,
+	kClearEachFrame		= 4,
+	kChooseClosest		= 8
+};
+
+struct SnapshotSensor {
+	uint32	kind;					///< Sensor::GetKind
+	uint32	function;				///< Function::mFunction
+	float	radius;					///< sensitive radius of light and collision sensors, antenna length of field sensors
+	float	angle;					///< antenna angle of field sensors, rate of buffer functions, neurons and layers
+	float	gain;					///< gain of field sensors, slope of functions' sigmoids
+	uint32	flags;
+	float	closestDistance;
+	float	activation;
+	float	steeringActivation;
+	uint32	firstInput,		inputCount;		///< a Switch's inputs are control, A, B
+	uint32	neurons;				///< of a layer, or the neuron a layer output reads
+	uint32	firstWeight,	weightCount;	///< see WeightCount
+};
+
+struct SnapshotActuator {
+	uint32	kind;
+	float	activation;
+	float	steeringActivation;
+	float	target;
+	float	steeringTarget;
+	float	lag;
+	float	rateLimit;
+	uint32	firstInput,		inputCount;		///< the inputs it mixes, with a weight each
+	uint32	firstWeight;
+};
+
+// input table entries are sensor indices within the vehicle, or -1 for none
+
+/// The weight table holds a neuron's weights then its bias, and a layer's weights, input by
+/// input, then its biases, its outputs and its steering outputs. An actuator's weights, one per
+/// input, follow the sensors of its vehicle
+static size_t WeightCount(SnapshotSensor const& r) {
+	if (r.kind == Neuron::GetStaticKind())	return (size_t) r.inputCount + 1;
+	if (r.kind == Layer::GetStaticKind())	return (size_t) r.neurons * ((size_t) r.inputCount + 3);
+	return 0;
+}
+
+/// The most neurons a restored layer may have
+static const uint32 kMaxLayerNeurons = 1 << 16;
+
+template <class Record>
+static Record const* Section(void const* pData, uint32 offset) {
+	return (Record const*) ((unsigned char const*) pData + offset);
+}
+
+static int SensorIndex(Vehicle const* pVehicle, Sensor const* pSensor) {
+	for (int i = 0; i < pVehicle->GetSensorCount(); ++i) {
+		if (pVehicle->GetSensor(i) == pSensor)
+			return i;
+	}
+	return -1;
+}
+
+static size_t Align(size_t offset) {
+	return (offset + 7) & ~(size_t) 7;
+}
+
+Snapshot::Snapshot()
+: m_pData(0), m_Size(0), m_pMapping(0), m_MappingSize(0)
+{
+}
+
+Snapshot::~Snapshot()
+{
+	Clear();
+}
+
+void Snapshot::Clear()
+{
+#ifndef _WIN32
+	if (m_pMapping) {
+		munmap(m_pMapping, m_MappingSize);
+	}
+#endif
+	m_pMapping = 0;
+	m_MappingSize = 0;
+	m_Buffer.clear();
+	m_pData = 0;
+	m_Size = 0;
+}
+
+void Snapshot::Capture(World const& world)
+{
+	Clear();
+
+	std::vector<SnapshotEntity>		entities;
+	std::vector<SnapshotSensor>		sensors;
+	std::vector<SnapshotActuator>	actuators;
+	std::vector<int>				inputs;
+	std::vector<float>				weights;
+	entities.reserve(world.m_State.size());
+
+	// entities are saved by index; the order they are stored and sensed in is saved with them,
+	// as it decides which order the sensors draw their noise in
+	for (int i = 0; i < world.GetEntityCount(); ++i) {
+		PhysState const& state = world.GetEntityState(i);
+
+		SnapshotEntity e;
+		memset(&e, 0, sizeof(e));
+		e.id = world.m_AI[i];
+		e.kind = state.m_Kind;
+		e.rotation = state.m_Rotation;
+		e.position[0] = state.m_Position[0];
+		e.position[1] = state.m_Position[1];
+		e.position[2] = state.m_Position[2];
+		e.firstSensor = (uint32) sensors.size();
+		e.firstActuator = (uint32) actuators.size();
+
+		DemoVehicle const* pVehicle = state.m_Vehicle;
+		if (pVehicle) {
+			e.maxSpeed = pVehicle->mMaxSpeed;
+			e.sensorCount = pVehicle->GetSensorCount();
+			e.actuatorCount = pVehicle->GetActuatorCount();
+
+			for (int s = 0; s < pVehicle->GetSensorCount(); ++s) {
+				Sensor const* pSensor = pVehicle->GetSensor(s);
+
+				SnapshotSensor r;
+				memset(&r, 0, sizeof(r));
+				r.kind = pSensor->GetKind();
+				r.flags = (pSensor->mbDirectional ? kDirectional : 0) |
+						  (pSensor->mbInternalSensor ? kInternalSensor : 0) |
+						  (pSensor->mbClearEachFrame ? kClearEachFrame : 0) |
+						  (pSensor->mbChooseClosest ? kChooseClosest : 0);
+				r.closestDistance = pSensor->mClosestDistance;
+				r.activation = pSensor->mActivation;
+				r.steeringActivation = pSensor->mSteeringActivation;
+				r.firstInput = (uint32) inputs.size();
+
+				if (r.kind == LightSensor::GetStaticKind()) {
+					r.radius = ((LightSensor const*) pSensor)->GetSensitiveRadius();
+				}
+				else if (r.kind == CollisionSensor::GetStaticKind()) {
+					r.radius = ((CollisionSensor const*) pSensor)->GetSensitiveRadius();
+				}
+				else if (r.kind == FieldSensor::GetStaticKind()) {
+					FieldSensor const* pFieldSensor = (FieldSensor const*) pSensor;
+					r.radius = pFieldSensor->GetAntennaLength();
+					r.angle = pFieldSensor->GetAntennaAngle();
+					r.gain = pFieldSensor->GetGain();
+				}
+				else if (r.kind == Function::GetStaticKind()) {
+					Function const* pFunction = (Function const*) pSensor;
+					r.function = pFunction->mFunction;
+					r.angle = pFunction->mRate;
+					r.gain = pFunction->mSlope;
+					for (size_t in = 0; in < pFunction->mInputs.size(); ++in) {
+						inputs.push_back(SensorIndex(pVehicle, pFunction->mInputs[in]));
+					}
+				}
+				else if (r.kind == Switch::GetStaticKind()) {
+					Switch const* pSwitch = (Switch const*) pSensor;
+					inputs.push_back(SensorIndex(pVehicle, pSwitch->mpSwitch));
+					inputs.push_back(SensorIndex(pVehicle, pSwitch->mpA));
+					inputs.push_back(SensorIndex(pVehicle, pSwitch->mpB));
+				}
+				else if (r.kind == Neuron::GetStaticKind()) {
+					Neuron const* pNeuron = (Neuron const*) pSensor;
+					r.function = pNeuron->mActivationFunction;
+					r.angle = pNeuron->mRate;
+					for (size_t in = 0; in < pNeuron->mInputs.size(); ++in) {
+						inputs.push_back(SensorIndex(pVehicle, pNeuron->mInputs[in]));
+						weights.push_back(pNeuron->mWeights[in]);
+					}
+					weights.push_back(pNeuron->mBias);
+				}
+				else if (r.kind == Layer::GetStaticKind()) {
+					Layer const* pLayer = (Layer const*) pSensor;
+					int neurons = pLayer->GetNeuronCount();
+					r.function = pLayer->mActivationFunction;
+					r.angle = pLayer->mRate;
+					r.neurons = (uint32) neurons;
+					for (int in = 0; in < pLayer->GetInputCount(); ++in) {
+						inputs.push_back(SensorIndex(pVehicle, pLayer->GetInput(in)));
+						for (int n = 0; n < neurons; ++n) {
+							weights.push_back(pLayer->GetWeight(n, in));
+						}
+					}
+					for (int n = 0; n < neurons; ++n)	weights.push_back(pLayer->GetBias(n));
+					for (int n = 0; n < neurons; ++n)	weights.push_back(pLayer->GetOutput(n));
+					for (int n = 0; n < neurons; ++n)	weights.push_back(pLayer->GetSteeringOutput(n));
+				}
+				else if (r.kind == LayerOutput::GetStaticKind()) {
+					LayerOutput const* pOutput = (LayerOutput const*) pSensor;
+					r.neurons = (uint32) pOutput->mNeuron;
+					inputs.push_back(SensorIndex(pVehicle, pOutput->mpLayer));
+				}
+				r.inputCount = (uint32) inputs.size() - r.firstInput;
+				r.firstWeight = (uint32) weights.size() - WeightCount(r);
+				r.weightCount = (uint32) WeightCount(r);
+				sensors.push_back(r);
+			}
+
+			for (int a = 0; a < pVehicle->GetActuatorCount(); ++a) {
+				Actuator const* pActuator = pVehicle->GetActuator(a);
+
+				SnapshotActuator r;
+				r.kind = pActuator->GetKind();
+				r.activation = pActuator->mActivation;
+				r.steeringActivation = pActuator->mSteeringActivation;
+				r.target = pActuator->mTarget;
+				r.steeringTarget = pActuator->mSteeringTarget;
+				r.lag = pActuator->GetLag();
+				r.rateLimit = pActuator->GetRateLimit();
+				r.firstInput = (uint32) inputs.size();
+				r.inputCount = (uint32) pActuator->GetInputCount();
+				r.firstWeight = (uint32) weights.size();
+				for (int in = 0; in < pActuator->GetInputCount(); ++in) {
+					inputs.push_back(SensorIndex(pVehicle, pActuator->GetInput(in)));
+					weights.push_back(pActuator->GetInputWeight(in));
+				}
+				actuators.push_back(r);
+			}
+		}
+		entities.push_back(e);
+	}
+
+	SnapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = kSnapshotMagic;
+	h.version = kSnapshotVersion;
+	h.randomState = world.m_RandomState;
+	h.lastID = world.m_Engine.GetLastID();
+	h.width = world.mMaxBoundH;
+	h.height = world.mMaxBoundV;
+	h.worldFlags = world.m_OpenWorld ? kOpenWorld : 0;
+	h.sortInterval = world.m_SortInterval;
+	h.ticksSinceSort = world.m_TicksSinceSort;
+	h.lightFieldCellSize = world.m_LightFieldCellSize;
+	h.lightFieldRadius = world.m_LightField.GetRadius();
+	ScalarField const& scent = world.m_Scent;
+	if (scent.IsConfigured()) {
+		h.scentCellSize = scent.GetCellSize();
+		h.scentDiffusion = scent.GetDiffusion();
+		h.scentEvaporation = scent.GetEvaporation();
+		h.scentColumns = scent.GetColumns();
+		h.scentRows = scent.GetRows();
+	}
+	size_t scentSize = (size_t) h.scentColumns * h.scentRows;
+	memcpy(h.actuatorDynamics, world.m_ActuatorDynamics, sizeof(h.actuatorDynamics));
+
+	size_t offset = Align(sizeof(h));
+	h.entityCount = (uint32) entities.size();
+	h.entityOffset = (uint32) offset;
+	offset = Align(offset + entities.size() * sizeof(SnapshotEntity));
+	h.sensorCount = (uint32) sensors.size();
+	h.sensorOffset = (uint32) offset;
+	offset = Align(offset + sensors.size() * sizeof(SnapshotSensor));
+	h.actuatorCount = (uint32) actuators.size();
+	h.actuatorOffset = (uint32) offset;
+	offset = Align(offset + actuators.size() * sizeof(SnapshotActuator));
+	h.inputCount = (uint32) inputs.size();
+	h.inputOffset = (uint32) offset;
+	offset = Align(offset + inputs.size() * sizeof(int));
+	h.weightCount = (uint32) weights.size();
+	h.weightOffset = (uint32) offset;
+	offset = Align(offset + weights.size() * sizeof(float));
+	h.orderOffset = (uint32) offset;
+	offset = Align(offset + world.m_Handle.size() * sizeof(int));
+	h.scentOffset = (uint32) offset;
+	offset = Align(offset + scentSize * sizeof(float));
+	h.size = (uint32) offset;
+
+	m_Buffer.assign(offset, 0);
+	unsigned char* p = &m_Buffer[0];
+	memcpy(p, &h, sizeof(h));
+	if (!entities.empty())	memcpy(p + h.entityOffset, &entities[0], entities.size() * sizeof(SnapshotEntity));
+	if (!sensors.empty())	memcpy(p + h.sensorOffset, &sensors[0], sensors.size() * sizeof(SnapshotSensor));
+	if (!actuators.empty())	memcpy(p + h.actuatorOffset, &actuators[0], actuators.size() * sizeof(SnapshotActuator));
+	if (!inputs.empty())	memcpy(p + h.inputOffset, &inputs[0], inputs.size() * sizeof(int));
+	if (!weights.empty())	memcpy(p + h.weightOffset, &weights[0], weights.size() * sizeof(float));
+	if (!entities.empty())	memcpy(p + h.orderOffset, &world.m_Handle[0], world.m_Handle.size() * sizeof(int));
+	if (scentSize)			memcpy(p + h.scentOffset, scent.GetCells(), scentSize * sizeof(float));
+
+	m_pData = p;
+	m_Size = offset;
+}
+
+bool Snapshot::IsValid() const
+{
+	if (!m_pData || m_Size < sizeof(SnapshotHeader))
+		return false;
+
+	SnapshotHeader const* h = (SnapshotHeader const*) m_pData;
+	if (h->magic != kSnapshotMagic || h->version != kSnapshotVersion || h->size != m_Size)
+		return false;
+
+	// every section must lie within the snapshot
+	if ((size_t) h->entityOffset + (size_t) h->entityCount * sizeof(SnapshotEntity) > m_Size)			return false;
+	if ((size_t) h->sensorOffset + (size_t) h->sensorCount * sizeof(SnapshotSensor) > m_Size)			return false;
+	if ((size_t) h->actuatorOffset + (size_t) h->actuatorCount * sizeof(SnapshotActuator) > m_Size)	return false;
+	if ((size_t) h->inputOffset + (size_t) h->inputCount * sizeof(int) > m_Size)						return false;
+	if ((size_t) h->weightOffset + (size_t) h->weightCount * sizeof(float) > m_Size)					return false;
+	if ((size_t) h->orderOffset + (size_t) h->entityCount * sizeof(int) > m_Size)						return false;
+	if ((size_t) h->scentOffset + (size_t) h->scentColumns * h->scentRows * sizeof(float) > m_Size)	return false;
+	return true;
+}
+
+/// Look up a sensor by its index in the vehicle; Restore has checked the index
+static Sensor* InputSensor(Vehicle* pVehicle, int index) {
+	return pVehicle->GetSensor(index);
+}
+
+bool Snapshot::Restore(World& world) const
+{
+	if (!IsValid())
+		return false;
+
+	SnapshotHeader const* h = (SnapshotHeader const*) m_pData;
+	SnapshotEntity const* pEntities = Section<SnapshotEntity>(m_pData, h->entityOffset);
+	SnapshotSensor const* pSensors = Section<SnapshotSensor>(m_pData, h->sensorOffset);
+	SnapshotActuator const* pActuators = Section<SnapshotActuator>(m_pData, h->actuatorOffset);
+	int const* pInputs = Section<int>(m_pData, h->inputOffset);
+	float const* pWeights = Section<float>(m_pData, h->weightOffset);
+	int const* pOrder = Section<int>(m_pData, h->orderOffset);
+
+	// reject brains that refer outside their sections before building anything
+	for (uint32 i = 0; i < h->entityCount; ++i) {
+		SnapshotEntity const& e = pEntities[i];
+		if ((size_t) e.firstSensor + e.sensorCount > h->sensorCount)			return false;
+		if ((size_t) e.firstActuator + e.actuatorCount > h->actuatorCount)	return false;
+		for (uint32 s = 0; s < e.sensorCount; ++s) {
+			SnapshotSensor const& r = pSensors[e.firstSensor + s];
+			if ((size_t) r.firstInput + r.inputCount > h->inputCount)			return false;
+			if (r.kind == Layer::GetStaticKind() && r.neurons > kMaxLayerNeurons)	return false;
+			if (r.weightCount != WeightCount(r) || (size_t) r.firstWeight + r.weightCount > h->weightCount)	return false;
+
+			// every node reads all of its inputs, so none may be missing, and a switch needs
+			// its control and both choices, as BrainDescription::IsValid requires
+			for (uint32 in = 0; in < r.inputCount; ++in) {
+				int index = pInputs[r.firstInput + in];
+				if (index < 0 || (uint32) index >= e.sensorCount)					return false;
+			}
+			if (r.kind == Function::GetStaticKind() && r.inputCount == 0)			return false;
+			if (r.kind == Switch::GetStaticKind() && r.inputCount != 3)			return false;
+			if (r.kind != LightSensor::GetStaticKind() && r.kind != CollisionSensor::GetStaticKind() &&
+				r.kind != FieldSensor::GetStaticKind() && r.kind != Function::GetStaticKind() &&
+				r.kind != Switch::GetStaticKind() && r.kind != Neuron::GetStaticKind() &&
+				r.kind != Layer::GetStaticKind() && r.kind != LayerOutput::GetStaticKind())
+				return false;
+			if (r.kind == LayerOutput::GetStaticKind()) {
+				if (r.inputCount != 1)												return false;
+				SnapshotSensor const& layer = pSensors[e.firstSensor + pInputs[r.firstInput]];
+				if (layer.kind != Layer::GetStaticKind() || r.neurons >= layer.neurons)	return false;
+			}
+		}
+		for (uint32 a = 0; a < e.actuatorCount; ++a) {
+			SnapshotActuator const& r = pActuators[e.firstActuator + a];
+			if ((size_t) r.firstInput + r.inputCount > h->inputCount)			return false;
+			if ((size_t) r.firstWeight + r.inputCount > h->weightCount)			return false;
+			for (uint32 in = 0; in < r.inputCount; ++in) {
+				int index = pInputs[r.firstInput + in];
+				if (index < 0 || (uint32) index >= e.sensorCount)					return false;
+			}
+		}
+	}
+
+	// the storage order must name every entity once
+	std::vector<int> order(pOrder, pOrder + h->entityCount);
+	std::vector<bool> seen(h->entityCount, false);
+	bool sorted = false;
+	for (uint32 i = 0; i < h->entityCount; ++i) {
+		if (order[i] < 0 || (uint32) order[i] >= h->entityCount || seen[order[i]])
+			return false;
+		seen[order[i]] = true;
+		sorted = sorted || order[i] != (int) i;
+	}
+
+	world.ClearAll();
+	world.m_OpenWorld = (h->worldFlags & kOpenWorld) != 0;
+	world.SetBounds(h->width, h->height);
+	world.m_Name = "Snapshot";
+	world.m_RandomState = h->randomState;
+
+	for (uint32 i = 0; i < h->entityCount; ++i) {
+		SnapshotEntity const& e = pEntities[i];
+
+		int index = world.GetEntityCount();
+		PhysState& state = world.NewState();
+		state.m_Kind = e.kind;
+		state.m_Rotation = e.rotation;
+		state.m_Position[0] = e.position[0];
+		state.m_Position[1] = e.position[1];
+		state.m_Position[2] = e.position[2];
+
+		InsectAI::Entity* pEntity;
+		if (e.kind == World::kVehicle) {
+			DemoVehicle* pVehicle = new DemoVehicle(&state);
+			state.m_Vehicle = pVehicle;
+			pVehicle->mMaxSpeed = e.maxSpeed;
+			pVehicle->AllocBrain(e.sensorCount, e.actuatorCount);
+
+			// create all the sensors first, so that the wiring can refer to any of them
+			for (uint32 s = 0; s < e.sensorCount; ++s) {
+				SnapshotSensor const& r = pSensors[e.firstSensor + s];
+				Sensor* pSensor;
+				if (r.kind == LightSensor::GetStaticKind())				pSensor = new LightSensor((r.flags & kDirectional) != 0, r.radius);
+				else if (r.kind == CollisionSensor::GetStaticKind())	pSensor = new CollisionSensor(r.radius);
+				else if (r.kind == FieldSensor::GetStaticKind())		pSensor = new FieldSensor(r.radius, r.angle, r.gain);
+				else if (r.kind == Switch::GetStaticKind())				pSensor = new Switch();
+				else if (r.kind == Neuron::GetStaticKind())				pSensor = new Neuron(r.function);
+				else if (r.kind == Layer::GetStaticKind())				pSensor = new Layer((int) r.neurons, r.function);
+				else if (r.kind == LayerOutput::GetStaticKind())		pSensor = new LayerOutput(0, (int) r.neurons);
+				else													pSensor = new Function(r.function);
+
+				pSensor->mbDirectional = (r.flags & kDirectional) != 0;
+				pSensor->mbInternalSensor = (r.flags & kInternalSensor) != 0;
+				pSensor->mbClearEachFrame = (r.flags & kClearEachFrame) != 0;
+				pSensor->mbChooseClosest = (r.flags & kChooseClosest) != 0;
+				pSensor->mClosestDistance = r.closestDistance;
+				pSensor->mActivation = r.activation;
+				pSensor->mSteeringActivation = r.steeringActivation;
+				pVehicle->AddSensor(pSensor);
+			}
+
+			for (uint32 s = 0; s < e.sensorCount; ++s) {
+				SnapshotSensor const& r = pSensors[e.firstSensor + s];
+				int const* pIn = pInputs + r.firstInput;
+				Sensor* pSensor = pVehicle->GetSensor(s);
+				if (r.kind == Function::GetStaticKind()) {
+					for (uint32 in = 0; in < r.inputCount; ++in) {
+						((Function*) pSensor)->AddInput(InputSensor(pVehicle, pIn[in]));
+					}
+					((Function*) pSensor)->mRate = r.angle;
+					((Function*) pSensor)->mSlope = r.gain;
+				}
+				else if (r.kind == Switch::GetStaticKind()) {
+					((Switch*) pSensor)->SetControl(InputSensor(pVehicle, pIn[0]));
+					((Switch*) pSensor)->SetInputs(InputSensor(pVehicle, pIn[1]), InputSensor(pVehicle, pIn[2]));
+				}
+				else if (r.kind == Neuron::GetStaticKind()) {
+					Neuron* pNeuron = (Neuron*) pSensor;
+					float const* pW = pWeights + r.firstWeight;
+					for (uint32 in = 0; in < r.inputCount; ++in) {
+						pNeuron->AddInput(InputSensor(pVehicle, pIn[in]), pW[in]);
+					}
+					pNeuron->mBias = pW[r.inputCount];
+					pNeuron->mRate = r.angle;
+				}
+				else if (r.kind == Layer::GetStaticKind()) {
+					Layer* pLayer = (Layer*) pSensor;
+					int neurons = (int) r.neurons;
+					pLayer->mRate = r.angle;
+					float const* pW = pWeights + r.firstWeight;
+					for (uint32 in = 0; in < r.inputCount; ++in) {
+						pLayer->AddInput(InputSensor(pVehicle, pIn[in]));
+						for (int n = 0; n < neurons; ++n) {
+							pLayer->SetWeight(n, (int) in, *pW++);
+						}
+					}
+					for (int n = 0; n < neurons; ++n) {
+						pLayer->SetBias(n, pW[n]);
+						pLayer->SetOutput(n, pW[neurons + n], pW[2 * neurons + n]);
+					}
+				}
+				else if (r.kind == LayerOutput::GetStaticKind()) {
+					((LayerOutput*) pSensor)->mpLayer = (Layer*) InputSensor(pVehicle, pIn[0]);
+				}
+			}
+
+			for (uint32 a = 0; a < e.actuatorCount; ++a) {
+				SnapshotActuator const& r = pActuators[e.firstActuator + a];
+				Actuator* pActuator = new Actuator(r.kind);
+				for (uint32 in = 0; in < r.inputCount; ++in) {
+					pActuator->AddInput(InputSensor(pVehicle, pInputs[r.firstInput + in]), pWeights[r.firstWeight + in]);
+				}
+				pActuator->SetDynamics(r.lag, r.rateLimit);
+				pActuator->mActivation = r.activation;
+				pActuator->mSteeringActivation = r.steeringActivation;
+				pActuator->mTarget = r.target;
+				pActuator->mSteeringTarget = r.steeringTarget;
+				pVehicle->AddActuator(pActuator);
+			}
+			pEntity = pVehicle;
+		}
+		else {
+			pEntity = new DemoLight(&state);
+			world.m_Lights.push_back(index);
+		}
+
+		world.m_Engine.AddEntity(pEntity, e.id);
+		world.m_AI.push_back(e.id);
+		world.m_pNN->AddProxy(&state);
+	}
+
+	world.m_Engine.SetLastID(h->lastID);
+	if (sorted) {
+		world.SetStorageOrder(order);
+	}
+	world.m_SortInterval = h->sortInterval;
+	world.m_TicksSinceSort = h->ticksSinceSort;
+	memcpy(world.m_ActuatorDynamics, h->actuatorDynamics, sizeof(world.m_ActuatorDynamics));
+
+	// the field is splatted afresh; being fixed point, it comes out exactly as it was
+	world.SetLightField(h->lightFieldCellSize, h->lightFieldRadius);
+
+	// the scent field is laid down by the vehicles over time, so its cells are copied as they were
+	world.SetScentField(h->scentCellSize, h->scentDiffusion, h->scentEvaporation);
+	ScalarField& scent = world.m_Scent;
+	if (scent.IsConfigured() && (uint32) scent.GetColumns() == h->scentColumns && (uint32) scent.GetRows() == h->scentRows) {
+		memcpy(scent.GetCells(), Section<float>(m_pData, h->scentOffset), (size_t) h->scentColumns * h->scentRows * sizeof(float));
+	}
+	return true;
+}
+
+bool Snapshot::Write(const char* path) const
+{
+	if (!IsValid())
+		return false;
+
+	FILE* pFile = fopen(path, "wb");
+	if (!pFile)
+		return false;
+
+	bool ok = fwrite(m_pData, 1, m_Size, pFile) == m_Size;
+	ok = (fclose(pFile) == 0) && ok;
+	return ok;
+}
+
+bool Snapshot::Load(void const* pData, size_t size)
+{
+	Clear();
+	if (size == 0)
+		return false;
+
+	m_Buffer.assign((unsigned char const*) pData, (unsigned char const*) pData + size);
+	m_pData = &m_Buffer[0];
+	m_Size = size;
+	if (!IsValid()) {
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+bool Snapshot::Map(const char* path)
+{
+	Clear();
+
+#ifdef _WIN32
+	// no mapping here; read the file instead, the restore path is the same
+	FILE* pFile = fopen(path, "rb");
+	if (!pFile)
+		return false;
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	if (size > 0) {
+		m_Buffer.resize(size);
+		if (fread(&m_Buffer[0], 1, size, pFile) != (size_t) size) {
+			m_Buffer.clear();
+		}
+	}
+	fclose(pFile);
+	if (m_Buffer.empty())
+		return false;
+	m_pData = &m_Buffer[0];
+	m_Size = m_Buffer.size();
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void* pMapping = mmap(0, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pMapping == MAP_FAILED)
+		return false;
+
+	m_pMapping = pMapping;
+	m_MappingSize = (size_t) info.st_size;
+	m_pData = pMapping;
+	m_Size = m_MappingSize;
+#endif
+
+	if (!IsValid()) {
+		Clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+
+/** @file	Snapshot.h
+	@brief	Compact binary snapshots of a World, for checkpoints and forking what-if runs
+	*/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include "PMath.h"
+
+#include <stddef.h>
+#include <vector>
+
+class World;
+
+/** @class	Snapshot
+	@brief	The complete state of a World as one flat block of fixed size records: the entities
+			and their PhysState, every vehicle's brain wiring and the activations of all of its
+			sensors and actuators, the scent field, the world's random number state, and the Engine's ID counter.
+
+			The records are addressed by offsets from the start of the block, so the block is
+			position independent: a file written by Write can be mapped into memory by Map and
+			restored straight from the mapping, without parsing or copying it first.
+			A snapshot can be restored into any number of worlds, to fork continuations of a run.
+	*/
+
+class Snapshot {
+public:
+	Snapshot();
+	~Snapshot();
+
+	/// Record the state of a world into memory owned by the snapshot
+	void	Capture(World const& world);
+
+	/// Rebuild a world from the snapshot, replacing whatever the world held
+	/// @return false if the snapshot is empty or invalid
+	bool	Restore(World& world) const;
+
+	/// Write the snapshot to a file
+	bool	Write(const char* path) const;
+
+	/// Map a file written by Write; the snapshot refers to the mapping until it is released
+	bool	Map(const char* path);
+
+	/// Copy a snapshot out of memory, such as a record in a replay log
+	bool	Load(void const* pData, size_t size);
+
+	/// Release the snapshot's memory or mapping
+	void	Clear();
+
+	void const*	GetData() const { return m_pData; }
+	size_t		GetSize() const { return m_Size; }
+
+	/// @return true if the data starts with a valid header of the current version
+	bool	IsValid() const;
+
+private:
+	Snapshot(Snapshot const&);
+	Snapshot& operator=(Snapshot const&);
+
+	std::vector<unsigned char>	m_Buffer;		///< storage for captured snapshots
+	void const*					m_pData;
+	size_t						m_Size;
+	void*						m_pMapping;		///< non null while a file is mapped
+	size_t						m_MappingSize;
+};
+
+#endif
@@ -0,0 +1,140 @@
+
+#include "SpatialHash.h"
+
+#include <string.h>
+
+#ifdef INSECTAI_LQ_STATS
+#define hashStat(statement) statement
+#else
+#define hashStat(statement)
+#endif
+
+SpatialHash::SpatialHash(float cellSize)
+: m_CellSize(cellSize), m_InverseCellSize(1.0f / cellSize)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void SpatialHash::Add(Proxy* pProxy, void* pObject, float x, float y)
+{
+	if (pProxy->index >= 0)
+		return;
+
+	pProxy->pObject = pObject;
+	Insert(pProxy, Key(Coordinate(x), Coordinate(y)), x, y);
+}
+
+void SpatialHash::Remove(Proxy* pProxy)
+{
+	if (pProxy->index >= 0) {
+		Erase(pProxy);
+	}
+}
+
+void SpatialHash::Update(Proxy* pProxy, float x, float y)
+{
+	if (pProxy->index < 0)
+		return;
+
+	hashStat(++m_Stats.updates);
+	unsigned long long key = Key(Coordinate(x), Coordinate(y));
+	if (key == pProxy->cell) {
+		Entry& entry = m_Cells[key][pProxy->index];
+		entry.x = x;
+		entry.y = y;
+		return;
+	}
+
+	hashStat(++m_Stats.rebins);
+	Erase(pProxy);
+	Insert(pProxy, key, x, y);
+}
+
+void SpatialHash::Insert(Proxy* pProxy, unsigned long long key, float x, float y)
+{
+	Cell& cell = m_Cells[key];
+	Entry entry = { x, y, pProxy };
+	pProxy->cell = key;
+	pProxy->index = (int) cell.size();
+	cell.push_back(entry);
+}
+
+void SpatialHash::Erase(Proxy* pProxy)
+{
+	CellMap::iterator i = m_Cells.find(pProxy->cell);
+	Cell& cell = i->second;
+
+	// the last entry fills the hole, and empty cells are dropped so memory follows occupancy
+	cell[pProxy->index] = cell.back();
+	cell[pProxy->index].pProxy->index = pProxy->index;
+	cell.pop_back();
+	if (cell.empty()) {
+		m_Cells.erase(i);
+	}
+	pProxy->index = -1;
+}
+
+inline void SpatialHash::Test(Cell const& cell, float x, float y, float radiusSquared, lqCallBackFunction func, void* clientQueryState)
+{
+	hashStat(++m_Stats.binsVisited);
+	for (size_t i = 0; i < cell.size(); ++i) {
+		Entry const& entry = cell[i];
+		float dx = entry.x - x;
+		float dy = entry.y - y;
+		float distanceSquared = dx * dx + dy * dy;
+		hashStat(++m_Stats.proxiesTested);
+		if (distanceSquared < radiusSquared) {
+			hashStat(++m_Stats.callbacks);
+			func(entry.pProxy->pObject, distanceSquared, clientQueryState);
+		}
+	}
+}
+
+void SpatialHash::MapOverAllObjectsInLocality(float x, float y, float radius, lqCallBackFunction func, void* clientQueryState)
+{
+	MapOverAllObjectsInLocalityBox(x, y, radius, x - radius, y - radius, x + radius, y + radius, func, clientQueryState);
+}
+
+void SpatialHash::MapOverAllObjectsInLocalityBox(float x, float y, float radius, float minx, float miny, float maxx, float maxy,
+												 lqCallBackFunction func, void* clientQueryState)
+{
+	hashStat(++m_Stats.queries);
+	float radiusSquared = radius * radius;
+	int cx0 = Coordinate(PMath::Max(minx, x - radius)), cx1 = Coordinate(PMath::Min(maxx, x + radius));
+	int cy0 = Coordinate(PMath::Max(miny, y - radius)), cy1 = Coordinate(PMath::Min(maxy, y + radius));
+
+	// a query covering more cells than are occupied walks the occupied cells instead,
+	// so that a large radius never costs more than a scan
+	double covered = ((double) cx1 - cx0 + 1) * ((double) cy1 - cy0 + 1);
+	if (covered > (double) m_Cells.size()) {
+		for (CellMap::const_iterator i = m_Cells.begin(); i != m_Cells.end(); ++i) {
+			int cx = (int) (uint32) (i->first >> 32);
+			int cy = (int) (uint32) i->first;
+			if (cx >= cx0 && cx <= cx1 && cy >= cy0 && cy <= cy1) {
+				Test(i->second, x, y, radiusSquared, func, clientQueryState);
+			}
+		}
+		return;
+	}
+
+	for (int cy = cy0; cy <= cy1; ++cy) {
+		for (int cx = cx0; cx <= cx1; ++cx) {
+			CellMap::const_iterator i = m_Cells.find(Key(cx, cy));
+			if (i != m_Cells.end()) {
+				Test(i->second, x, y, radiusSquared, func, clientQueryState);
+			}
+		}
+	}
+}
+
+void SpatialHash::GetCellOccupancy(int* counts) const
+{
+	for (CellMap::const_iterator i = m_Cells.begin(); i != m_Cells.end(); ++i) {
+		*counts++ = (int) i->second.size();
+	}
+}
+
+void SpatialHash::ResetStats()
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
@@ -0,0 +1,97 @@
+
+/** @file	SpatialHash.h
+	@brief	A sparse, unbounded grid for locality queries
+	*/
+
+#ifndef _SPATIALHASH_H_
+#define _SPATIALHASH_H_
+
+#include "PMath.h"
+#include "lq.h"
+
+#include <unordered_map>
+#include <vector>
+
+/** @class	SpatialHash
+	@brief	A planar grid of square cells with no bounds, of which only the occupied cells are
+			stored, in a hash table keyed by the cell's coordinates. Memory is proportional to
+			the number of occupied cells, and a query of a given radius costs the same wherever
+			it is made, which the lq super-brick can't offer once entities leave it and fall
+			into its "other" bin.
+
+			Each cell holds a copy of its proxies' positions, so the distance tests of a query
+			don't chase pointers. Queries call back with the same signature as lq.
+	*/
+
+class SpatialHash {
+public:
+	/// The per object state, embedded in each client object, as lqClientProxy is for lq
+	struct Proxy {
+		Proxy() : pObject(0), cell(0), index(-1) { }
+
+		void*				pObject;
+		unsigned long long	cell;			///< key of the cell holding the proxy
+		int					index;			///< in the cell's entries, or -1 when not in the grid
+	};
+
+	explicit SpatialHash(float cellSize);
+
+	void	Add(Proxy* pProxy, void* pObject, float x, float y);
+	void	Remove(Proxy* pProxy);
+
+	/// Move a proxy; it is only rehashed if it has left its cell
+	void	Update(Proxy* pProxy, float x, float y);
+
+	/// Call the function for every object within radius of the point
+	void	MapOverAllObjectsInLocality(float x, float y, float radius, lqCallBackFunction func, void* clientQueryState);
+
+	/// As above, visiting only the cells that overlap the box, as lqMapOverAllObjectsInLocalityBox does
+	void	MapOverAllObjectsInLocalityBox(float x, float y, float radius, float minx, float miny, float maxx, float maxy,
+										   lqCallBackFunction func, void* clientQueryState);
+
+	float	GetCellSize() const { return m_CellSize; }
+
+	/// The number of occupied cells, and the number of proxies in each of them
+	int		GetCellCount() const { return (int) m_Cells.size(); }
+	void	GetCellOccupancy(int* counts) const;
+
+	/// Traversal counters, kept only when built with INSECTAI_LQ_STATS. There is no "other" bin,
+	/// so those counters stay zero
+	void	GetStats(lqStats* pStats) const { *pStats = m_Stats; }
+	void	ResetStats();
+
+private:
+	struct Entry {
+		float	x, y;
+		Proxy*	pProxy;
+	};
+
+	typedef std::vector<Entry> Cell;
+
+	/// Cell keys pack the signed cell coordinates; the hash mixes them, as the standard
+	/// library's integer hash is the identity
+	struct KeyHash {
+		size_t operator()(unsigned long long key) const {
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdull;
+			key ^= key >> 33;
+			return (size_t) key;
+		}
+	};
+
+	typedef std::unordered_map<unsigned long long, Cell, KeyHash> CellMap;
+
+	int					Coordinate(float v) const { return (int) floorf(v * m_InverseCellSize); }
+	static unsigned long long Key(int cx, int cy) { return ((unsigned long long) (uint32) cx << 32) | (uint32) cy; }
+
+	void				Insert(Proxy* pProxy, unsigned long long key, float x, float y);
+	void				Erase(Proxy* pProxy);
+	void				Test(Cell const& cell, float x, float y, float radiusSquared, lqCallBackFunction func, void* clientQueryState);
+
+	CellMap				m_Cells;
+	float				m_CellSize;
+	float				m_InverseCellSize;
+	lqStats				m_Stats;
+};
+
+#endif
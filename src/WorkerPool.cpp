@@ -0,0 +1,76 @@
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool()
+: m_pTask(0), m_Tasks(0), m_Run(0), m_Pending(0), m_Quit(false)
+{
+}
+
+WorkerPool::WorkerPool(WorkerPool const&)
+: m_pTask(0), m_Tasks(0), m_Run(0), m_Pending(0), m_Quit(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_Started.notify_all();
+	for (size_t i = 0; i < m_Threads.size(); ++i) {
+		m_Threads[i].join();
+	}
+}
+
+void WorkerPool::Run(int tasks, std::function<void(int)> const& task)
+{
+	if (tasks <= 0)
+		return;
+	if (tasks == 1) {
+		task(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// a thread started now waits for the run after those already taken
+		while ((int) m_Threads.size() < tasks - 1) {
+			m_Threads.push_back(std::thread(&WorkerPool::Work, this, (int) m_Threads.size() + 1, m_Run));
+		}
+		m_pTask = &task;
+		m_Tasks = tasks;
+		m_Pending = tasks - 1;
+		++m_Run;
+	}
+	m_Started.notify_all();
+
+	task(0);
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Finished.wait(lock, [this]() { return m_Pending == 0; });
+	m_pTask = 0;
+}
+
+void WorkerPool::Work(int index, int run)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;) {
+		m_Started.wait(lock, [this, run]() { return m_Quit || m_Run != run; });
+		if (m_Quit)
+			return;
+		run = m_Run;
+
+		// threads beyond the tasks of this run sit it out
+		if (index < m_Tasks) {
+			std::function<void(int)> const* pTask = m_pTask;
+			lock.unlock();
+			(*pTask)(index);
+			lock.lock();
+			if (--m_Pending == 0) {
+				m_Finished.notify_one();
+			}
+		}
+	}
+}
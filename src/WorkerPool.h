@@ -0,0 +1,49 @@
+
+/** @file	WorkerPool.h
+	@brief	Threads kept waiting between runs, for work that is split up every step
+	*/
+
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** @class	WorkerPool
+	@brief	Runs a number of tasks at once, the first on the calling thread and the rest on
+			threads the pool keeps between runs, so work split up every step doesn't pay to
+			start threads every step. Threads are started as a run first needs them.
+			A copy of a pool shares nothing with it, and starts threads of its own; one pool
+			must not be run from two threads at once
+	*/
+
+class WorkerPool {
+public:
+	WorkerPool();
+	WorkerPool(WorkerPool const&);
+	WorkerPool& operator=(WorkerPool const&)		{ return *this; }
+	~WorkerPool();
+
+	/// Call task(0) to task(tasks - 1), each once, and return when all have returned
+	void	Run(int tasks, std::function<void(int)> const& task);
+
+	int		GetThreadCount() const					{ return (int) m_Threads.size(); }
+
+private:
+	void	Work(int index, int run);
+
+	std::vector<std::thread>	m_Threads;			///< thread i runs task i + 1
+	std::mutex					m_Mutex;
+	std::condition_variable		m_Started;
+	std::condition_variable		m_Finished;
+	std::function<void(int)> const*	m_pTask;
+	int							m_Tasks;			///< of the current run
+	int							m_Run;				///< counts runs, so that a thread takes each once
+	int							m_Pending;			///< threads yet to finish the current run
+	bool						m_Quit;
+};
+
+#endif
@@ -0,0 +1,1266 @@
+
+#include "PMath.h"
+#include "InsectAI.h"
+
+#include "World.h"
+#include "BrainDescription.h"
+#include "Profiler.h"
+#include "Replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+using PMath::randf;
+using InsectAI::LightSensor;
+using InsectAI::CollisionSensor;
+using InsectAI::FieldSensor;
+using InsectAI::Actuator;
+using InsectAI::Function;
+using InsectAI::Layer;
+using InsectAI::Sensor;
+using InsectAI::Switch;
+using InsectAI::kNeuronSigmoid;
+
+const float World::kCollisionQueryRadius = 150.0f;
+const float World::kDefaultNeighbourListSkin = 20.0f;
+
+World::World() :
+	mMaxBoundH(k1), mMaxBoundV(k1),
+	m_pNN(0),
+	m_StaticIndexDirty(true),
+	m_LightFieldCellSize(0),
+	m_LightFieldDirty(true),
+	m_Name(0),
+	m_RandomState(PMath::RandomSeed(0)),
+	m_pRecorder(0),
+	m_GridCellSize(kCollisionQueryRadius),
+	m_GridLevels(1),
+	m_OpenWorld(false),
+	m_AdaptiveGrid(false),
+	m_TicksSinceGridTune(0),
+	m_SortInterval(0),
+	m_TicksSinceSort(0),
+	m_NeighbourSkin(0),
+	m_NeighbourListsDirty(true),
+	m_SenseReuse(false),
+	m_SenseStep(0),
+	m_LightsChangedStep(0),
+	m_SensesChangedStep(0),
+	m_SenseIdleFraction(1.0f),
+	m_SenseColumns(0),
+	m_SenseRows(0),
+	m_LazyBrains(false),
+	m_LazyEpsilon(0)
+{
+	memset(m_ActuatorDynamics, 0, sizeof(m_ActuatorDynamics));
+}
+
+/// The row of World::m_ActuatorDynamics for an actuator kind, or -1
+static int DynamicsIndex(uint32 kind) {
+	switch (kind) {
+		case Actuator::kMotor:		return 0;
+		case Actuator::kSteering:	return 1;
+		case Actuator::kDeposit:	return 2;
+		default:					return -1;
+	}
+}
+
+World::~World() {
+	ClearAll();
+	delete m_pNN;
+}
+
+void World::BuildTestBrain(InsectAI::Vehicle* pVehicle, uint32 brainType) {
+	LightSensor* pLightSensor;
+	CollisionSensor* pCollisionSensor;
+	Actuator* pMotor;
+
+	static uint32 funcs[3] = {Function::kBuffer, Function::kInvert, Function::kSigmoid};
+
+	bool directional = (brainType > 3 && brainType < 8);
+
+	switch (brainType) {
+
+		// light activated or light seeking
+		case 0:
+		case 4:
+			{	
+				pVehicle->AllocBrain(1, 1);
+				pLightSensor = new LightSensor(directional, mMaxBoundH);
+				pMotor = new Actuator(Actuator::kMotor);
+                pMotor->SetInput(pLightSensor);
+				pVehicle->AddSensor(pLightSensor);
+				pVehicle->AddActuator(pMotor);
+			}
+			break;
+
+		// light activated or light seeking with a transfer function
+		case 1:
+		case 2:
+		case 3:
+		case 5:
+		case 6:
+		case 7:
+			{
+				pVehicle->AllocBrain(2, 1);
+				pLightSensor = new LightSensor(directional, mMaxBoundH);
+				Function* pFunc = new Function(funcs[(brainType-1) & 3]);
+                pFunc->AddInput(pLightSensor);
+
+				pMotor = new Actuator(Actuator::kMotor);
+                pMotor->SetInput(pFunc);
+
+				pVehicle->AddSensor(pFunc);
+				pVehicle->AddSensor(pLightSensor);
+				pVehicle->AddActuator(pMotor);
+			}
+			break;
+
+		// light seeking, with collision avoidance
+		case 8:
+			{
+				pVehicle->AllocBrain(3, 1);
+				pLightSensor = new LightSensor(true, mMaxBoundH);		// directional light sensor
+				pCollisionSensor = new CollisionSensor(mMaxBoundH * 0.1f);
+				Switch* pSwitch = new Switch();
+					pSwitch->SetControl(pCollisionSensor);
+					pSwitch->SetInputs(pLightSensor, pCollisionSensor);
+
+				pMotor = new Actuator(Actuator::kMotor);
+					pMotor->SetInput(pSwitch);
+
+				pVehicle->AddSensor(pCollisionSensor);
+				pVehicle->AddSensor(pSwitch);
+				pVehicle->AddSensor(pLightSensor);
+				pVehicle->AddActuator(pMotor);
+			}
+			break;
+
+		// trail laying and following; fast and laying most scent where there is least, and
+		// turning towards the stronger scent
+		case 9:
+			{
+				pVehicle->AllocBrain(2, 2);
+				FieldSensor* pFieldSensor = new FieldSensor(mMaxBoundH * 0.02f, 0.6f, 1.0f);
+				Function* pFunc = new Function(Function::kInvert);
+				pFunc->AddInput(pFieldSensor);
+
+				pMotor = new Actuator(Actuator::kMotor);
+					pMotor->SetInput(pFunc);
+				Actuator* pDeposit = new Actuator(Actuator::kDeposit);
+					pDeposit->SetInput(pFunc);
+
+				pVehicle->AddSensor(pFunc);
+				pVehicle->AddSensor(pFieldSensor);
+				pVehicle->AddActuator(pMotor);
+				pVehicle->AddActuator(pDeposit);
+			}
+			break;
+
+		// light seeking with collision avoidance, by a neuron weighing both senses; its steering
+		// is the sum of theirs, and it hurries as either grows
+		case 10:
+			{
+				pVehicle->AllocBrain(3, 1);
+				pLightSensor = new LightSensor(true, mMaxBoundH);
+				pCollisionSensor = new CollisionSensor(mMaxBoundH * 0.1f);
+				Layer* pLayer = new Layer(1, kNeuronSigmoid);
+				pLayer->AddInput(pCollisionSensor);
+				pLayer->AddInput(pLightSensor);
+				pLayer->SetWeight(0, 0, 1.0f);
+				pLayer->SetWeight(0, 1, 1.0f);
+
+				pMotor = new Actuator(Actuator::kMotor);
+					pMotor->SetInput(pLayer);
+
+				pVehicle->AddSensor(pCollisionSensor);
+				pVehicle->AddSensor(pLayer);
+				pVehicle->AddSensor(pLightSensor);
+				pVehicle->AddActuator(pMotor);
+			}
+			break;
+	}
+}
+
+
+
+void World::ClearAll() {
+	RemoveAllProxies();
+
+	// the engine does not own the entities, the demo created them so it deletes them
+	for (size_t i = 0; i < m_AI.size(); ++i) {
+		delete m_Engine.GetEntity(m_AI[i]);
+	}
+	m_Engine.RemoveAllEntities();
+
+	m_AI.clear();
+	m_Lights.clear();
+	m_State.clear();
+	m_Slot.clear();
+	m_Handle.clear();
+	m_StaticIndexDirty = true;
+	m_LightField.Clear();
+	m_LightFieldSplats.clear();
+	m_Scent.Clear();
+	m_NeighbourListsDirty = true;
+	m_SenseColumns = 0;
+}
+
+void World::AddEntity(PhysState& state, InsectAI::Entity* pEntity) {
+	m_AI.push_back(m_Engine.AddEntity(pEntity));
+	if (m_pNN) {
+		m_pNN->AddProxy(&state);
+	}
+}
+
+PhysState& World::NewState() {
+	// new entities go at the end of the storage, whatever order it is in
+	int slot = (int) m_State.size();
+	m_Handle.push_back((int) m_Slot.size());
+	m_Slot.push_back(slot);
+	m_State.emplace_back();
+	m_NeighbourListsDirty = true;
+	return m_State.back();
+}
+
+int World::CreateLight(float x, float y) {
+	int index = GetEntityCount();
+	PhysState& state = NewState();
+	state.m_Kind = kLight;
+	state.m_Rotation = k0;
+	state.m_Position[0] = x;
+	state.m_Position[1] = y;
+	AddEntity(state, new DemoLight(&state));
+	m_Lights.push_back(index);
+	m_StaticIndexDirty = true;
+	m_LightFieldDirty = true;
+	return index;
+}
+
+int World::CreateVehicle(uint32 brainType, BrainDescription const* pBrain) {
+	PMath::RandomScope random(m_RandomState);
+	int index = GetEntityCount();
+	PhysState& state = NewState();
+	DemoVehicle* pVehicle = new DemoVehicle(&state);
+	state.m_Vehicle = pVehicle;
+	state.m_Kind = kVehicle;
+	state.m_Rotation = k0;
+	state.m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
+	state.m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
+	if (pBrain) {
+		pBrain->Instantiate(pVehicle, mMaxBoundH);
+	}
+	else {
+		BuildTestBrain(pVehicle, brainType);
+	}
+	pVehicle->SetLazy(m_LazyBrains, m_LazyEpsilon);
+	for (int a = 0; a < pVehicle->GetActuatorCount(); ++a) {
+		Actuator* pActuator = pVehicle->GetActuator(a);
+		int k = DynamicsIndex(pActuator->GetKind());
+		if (k >= 0 && (m_ActuatorDynamics[k][0] > 0.0f || m_ActuatorDynamics[k][1] > 0.0f)) {
+			pActuator->SetDynamics(m_ActuatorDynamics[k][0], m_ActuatorDynamics[k][1]);
+		}
+	}
+	pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
+	AddEntity(state, pVehicle);
+	return index;
+}
+
+void World::CreateDemoZero_Zero() {
+	m_Name = "Light Sensitive - linear response";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	CreateVehicle(0);
+}
+
+
+void World::CreateDemoZero_One() {
+	m_Name = "Light Sensitive with Buffer - delayed response";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	CreateVehicle(1);
+}
+
+void World::CreateDemoZero_Two() {
+	m_Name = "Light Sensitive with Inverter";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	CreateVehicle(2);
+}
+
+void World::CreateDemoZero_Three() {
+	m_Name = "Light Sensitive with Threshold";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	CreateVehicle(3);
+}
+
+void World::CreateDemoOne() {
+	m_Name = "Light Sensitive Comparison";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	for (uint32 brain = 0; brain <= 3; ++brain) {
+		CreateVehicle(brain);
+	}
+}
+
+void World::CreateDemoTwo_Zero() {
+	m_Name = "Light Seeking - linear response";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	CreateVehicle(4);
+}
+
+void World::CreateDemoTwo() {
+	m_Name = "Light Seeking Comparison";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+	for (uint32 brain = 4; brain <= 7; ++brain) {
+		CreateVehicle(brain);
+	}
+}
+
+void World::CreateLightSeekingAvoider() {
+	CreateVehicle(8);
+}
+
+void World::SpawnVehicles(uint32 brainType, int count) {
+	for (int i = 0; i < count; ++i) {
+		CreateVehicle(brainType);
+	}
+	if (m_pRecorder) {
+		m_pRecorder->RecordSpawn(brainType, count);
+	}
+}
+
+void World::SpawnVehicles(BrainDescription const& brain, int count) {
+	for (int i = 0; i < count; ++i) {
+		CreateVehicle(0, &brain);
+	}
+	if (m_pRecorder) {
+		m_pRecorder->RecordSpawn(brain, count);
+	}
+}
+
+void World::PlaceEntity(int index, float x, float y) {
+	if (index < 0 || index >= GetEntityCount())
+		return;
+
+	PhysState& state = m_State[m_Slot[index]];
+	state.m_Position[0] = x;
+	state.m_Position[1] = y;
+	state.m_Position[2] = k0;
+	if (m_pNN) {
+		m_pNN->UpdateProxy(&state);
+	}
+	if (state.m_Kind != kVehicle) {
+		m_StaticIndexDirty = true;
+		m_LightFieldDirty = true;
+	}
+	if (m_pRecorder) {
+		m_pRecorder->RecordPlace(index, x, y);
+	}
+}
+
+void World::CreateDemoThree() {
+	m_Name = "Light Seeking with Collision Avoidance";
+	ClearAll();
+	PMath::RandomScope random(m_RandomState);
+	float x = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
+	float y = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
+	CreateLight(x, y);
+
+	for (int i = 0; i < 2; ++i) {
+		CreateLightSeekingAvoider();
+	}
+}
+
+void World::CreatePopulation(uint32 brainType, int count) {
+	m_Name = "Population";
+	ClearAll();
+	CreateLight(0.5f * mMaxBoundH, 0.5f * mMaxBoundV);
+
+	for (int i = 0; i < count; ++i) {
+		CreateVehicle(brainType);
+	}
+}
+
+void World::CreatePopulationScaling(int count) {
+	CreatePopulation(8, count);
+	m_Name = "Population Scaling";
+}
+
+
+void World::WrapAround(float left, float right, float bottom, float top) {
+	INSECTAI_PROFILE_SCOPE("WrapAround");
+	for (int i = 0; i < GetEntityCount(); ++i) {
+		PhysState* pState = &m_State[i];
+
+		float x = pState->m_Position[0];
+		float y = pState->m_Position[1];
+
+		if (pState->m_Position[0] > right)			pState->m_Position[0] = left;
+		else if (pState->m_Position[0] < left)		pState->m_Position[0] = right;
+		if (pState->m_Position[1] > top)			pState->m_Position[1] = bottom;
+		else if (pState->m_Position[1] < bottom)	pState->m_Position[1] = top;
+
+		if (x != pState->m_Position[0] || y != pState->m_Position[1]) {
+			// the spatial database must see the entity where it now is, on the far side
+			if (m_pNN) {
+				m_pNN->UpdateProxy(pState);
+			}
+
+			// a light placed outside the world has just been moved back in
+			if (pState->m_Kind != kVehicle) {
+				m_StaticIndexDirty = true;
+				m_LightFieldDirty = true;
+			}
+		}
+	}
+}
+
+void World::AddAllProxies() {
+	if (m_pNN) {
+		for (int i = 0; i < GetEntityCount(); ++i) {
+			m_pNN->AddProxy(&m_State[i]);
+		}
+	}
+}
+
+void World::RemoveAllProxies() {
+	if (m_pNN) {
+		for (int i = 0; i < GetEntityCount(); ++i) {
+				m_pNN->RemoveProxy(&m_State[i]);
+		}
+	}
+}
+
+
+void World::SetBounds(float width, float height) {
+	mMaxBoundH = width;
+	mMaxBoundV = height;
+	SetGridCellSize(m_GridCellSize);
+	if (m_LightField.IsConfigured()) {
+		SetLightField(m_LightFieldCellSize, m_LightField.GetRadius());
+	}
+	if (m_Scent.IsConfigured()) {
+		m_Scent.Configure(width, height, m_Scent.GetCellSize());
+	}
+}
+
+void World::SetOpenWorld(bool open) {
+	m_OpenWorld = open;
+	SetGridCellSize(m_GridCellSize);
+}
+
+void World::SetGridCellSize(float cellSize) {
+	m_GridCellSize = cellSize;
+
+	if (m_OpenWorld) {
+		RemoveAllProxies();
+		delete m_pNN;
+		m_pNN = new NearestNeighbours(cellSize);
+		AddAllProxies();
+		return;
+	}
+
+	// the world is planar, so the super-brick is a single sub-brick deep, centered on z = 0.
+	PMath::Vec3f origin;
+	origin[0] = origin[1] = k0;
+	origin[2] = -kHalf;
+	PMath::Vec3f dimensions;
+	dimensions[0] = mMaxBoundH;
+	dimensions[1] = mMaxBoundV;
+	dimensions[2] = k1;
+	int divx = PMath::Max(1, (int) ceilf(mMaxBoundH / cellSize));
+	int divy = PMath::Max(1, (int) ceilf(mMaxBoundV / cellSize));
+
+	RemoveAllProxies();
+	delete m_pNN;
+	m_pNN = new NearestNeighbours(origin, dimensions, divx, divy, 1, true, m_GridLevels);
+	AddAllProxies();
+}
+
+void World::SetGridLevels(int levels) {
+	m_GridLevels = levels;
+	SetGridCellSize(m_GridCellSize);
+}
+
+/// Estimated cost of the queries of one step, in units of one proxy distance test.
+/// A query of radius r on cells of edge s overlaps about (2r / s + 1) cells on each axis, and
+/// tests every proxy in them. A test chases a pointer to the proxy and calls back into the
+/// query, so visiting an empty cell costs less than a test. Once the proxies no longer fit in
+/// the cache each test is a miss, while the cells are walked in order, so a visit costs less
+/// still against a test the more proxies there are; the weights were measured with the tune
+/// command of insect-ai-headless
+static double GridQueryCost(float cellSize, float radius, float width, float height, double density, double queries, int proxies)
+{
+	const double kBinVisitCost = 0.5;
+	const double kCachedProxies = 8000.0;
+	double binVisitCost = kBinVisitCost * PMath::Min(1.0, kCachedProxies / PMath::Max(proxies, 1));
+
+	int divx = PMath::Max(1, (int) ceilf(width / cellSize));
+	int divy = PMath::Max(1, (int) ceilf(height / cellSize));
+	double binsx = PMath::Min((double) divx, 2.0 * radius / cellSize + 1.0);
+	double binsy = PMath::Min((double) divy, 2.0 * radius / cellSize + 1.0);
+	double tested = PMath::Min((double) proxies, density * binsx * binsy * cellSize * cellSize);
+	return queries * (binVisitCost * binsx * binsy + tested);
+}
+
+bool World::TuneGrid() {
+	m_TicksSinceGridTune = 0;
+	float radius = m_pNN->GetMeanQueryRadius();
+	double queries = m_pNN->GetQueryCount();
+	m_pNN->ResetQueryRadii();
+	if (radius <= k0)
+		return false;
+
+	// the density seen by the average proxy, rather than the mean density, so that crowding
+	// around the lights counts for as much as it costs
+	std::vector<int> counts(m_pNN->GetBinCount() + 1);
+	m_pNN->GetBinOccupancy(&counts[0]);
+	double sum = 0, sumSquares = 0;
+	for (int i = 0; i < (int) counts.size() - 1; ++i) {
+		sum += counts[i];
+		sumSquares += (double) counts[i] * counts[i];
+	}
+	if (sum == 0)
+		return false;
+
+	// an open world's grid covers wherever the entities are, and only its occupied cells are stored
+	float width = mMaxBoundH;
+	float height = mMaxBoundV;
+	float binWidth = width / PMath::Max(1, (int) ceilf(width / m_GridCellSize));
+	float binHeight = height / PMath::Max(1, (int) ceilf(height / m_GridCellSize));
+	if (m_OpenWorld) {
+		float bounds[4];
+		GetExtent(bounds);
+		width = PMath::Max(bounds[2] - bounds[0], m_GridCellSize);
+		height = PMath::Max(bounds[3] - bounds[1], m_GridCellSize);
+		binWidth = binHeight = m_GridCellSize;
+	}
+	double density = sumSquares / sum / (binWidth * binHeight);
+	int proxies = (int) sum;
+
+	// candidates from an eighth of the radius up to the whole world, an octave apart;
+	// the bin array is kept to a few bins per proxy
+	float worldSize = PMath::Max(width, height);
+	float best = m_GridCellSize;
+	double bestCost = GridQueryCost(m_GridCellSize, radius, width, height, density, queries, proxies);
+	double currentCost = bestCost;
+	for (float cellSize = radius * 0.125f; ; cellSize *= 2.0f) {
+		float s = PMath::Min(cellSize, worldSize);
+		double bins = ceil(width / s) * ceil(height / s);
+		if (m_OpenWorld || bins <= 4.0 * proxies + 16) {
+			double cost = GridQueryCost(s, radius, width, height, density, queries, proxies);
+			if (cost < bestCost) {
+				bestCost = cost;
+				best = s;
+			}
+		}
+		if (s >= worldSize)
+			break;
+	}
+
+	// rebuilding costs about as much as a step's worth of proxy updates, and is done at most
+	// once per tuning interval, so a modest estimated gain is worth it
+	if (bestCost < 0.9 * currentCost) {
+		SetGridCellSize(best);
+		return true;
+	}
+	return false;
+}
+
+/// Interleave the bits of the low halves of x and y, x in the even bits
+static uint32 MortonInterleave(uint32 x, uint32 y)
+{
+	x &= 0xffff;						y &= 0xffff;
+	x = (x | (x << 8)) & 0x00ff00ff;	y = (y | (y << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;	y = (y | (y << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;	y = (y | (y << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;	y = (y | (y << 1)) & 0x55555555;
+	return x | (y << 1);
+}
+
+void World::GetExtent(float* pBounds) const {
+	pBounds[0] = pBounds[1] = 0.0f;
+	pBounds[2] = pBounds[3] = 0.0f;
+	for (int slot = 0; slot < (int) m_State.size(); ++slot) {
+		float x = m_State[slot].m_Position[0];
+		float y = m_State[slot].m_Position[1];
+		if (slot == 0 || x < pBounds[0])	pBounds[0] = x;
+		if (slot == 0 || y < pBounds[1])	pBounds[1] = y;
+		if (slot == 0 || x > pBounds[2])	pBounds[2] = x;
+		if (slot == 0 || y > pBounds[3])	pBounds[3] = y;
+	}
+}
+
+void World::SortEntities() {
+	m_TicksSinceSort = 0;
+	int count = GetEntityCount();
+	if (count < 2)
+		return;
+
+	// the key only depends on the positions, not on the grid, so that a replayed world
+	// sorts identically whatever its grid has been tuned to. The extent of the entities is
+	// used rather than the bounds, which the entities of an open world may have left.
+	// Ties keep entity index order, so the order is fully determined
+	float bounds[4];
+	GetExtent(bounds);
+	float sx = 65535.0f / PMath::Max(bounds[2] - bounds[0], 1.0f);
+	float sy = 65535.0f / PMath::Max(bounds[3] - bounds[1], 1.0f);
+	std::vector<std::pair<uint32, int> > keys(count);
+	for (int slot = 0; slot < count; ++slot) {
+		PhysState const& state = m_State[slot];
+		uint32 x = (uint32) PMath::Clamp((state.m_Position[0] - bounds[0]) * sx, 0.0f, 65535.0f);
+		uint32 y = (uint32) PMath::Clamp((state.m_Position[1] - bounds[1]) * sy, 0.0f, 65535.0f);
+		keys[slot] = std::make_pair(MortonInterleave(x, y), m_Handle[slot]);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<int> handles(count);
+	for (int slot = 0; slot < count; ++slot) {
+		handles[slot] = keys[slot].second;
+	}
+	SetStorageOrder(handles);
+}
+
+void World::SetStorageOrder(std::vector<int> const& handles) {
+	int count = GetEntityCount();
+
+	// the proxies are linked into the lq bins by address, so they are all taken out while
+	// the states are copied into their new slots
+	RemoveAllProxies();
+	std::deque<PhysState> state;
+	for (int slot = 0; slot < count; ++slot) {
+		state.push_back(m_State[m_Slot[handles[slot]]]);
+	}
+	m_State.swap(state);
+
+	std::vector<int> ids(count);
+	for (int slot = 0; slot < count; ++slot) {
+		int handle = handles[slot];
+		m_Slot[handle] = slot;
+		m_Handle[slot] = handle;
+		ids[slot] = m_AI[handle];
+
+		PhysState& moved = m_State[slot];
+		if (moved.m_Vehicle) {
+			moved.m_Vehicle->m_pState = &moved;
+		}
+		else {
+			((DemoLight*) m_Engine.GetEntity(ids[slot]))->m_pState = &moved;
+		}
+	}
+	AddAllProxies();
+
+	// the brains are visited in the same order as their bodies are stored
+	m_Engine.SetEntityOrder(&ids[0], count);
+	m_NeighbourListsDirty = true;
+}
+
+static double Seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void World::Step(float dt, StepTimes* pTimes) {
+	INSECTAI_PROFILE_SCOPE("Step");
+	PMath::RandomScope random(m_RandomState);
+
+	if (m_StaticIndexDirty) {
+		BuildStaticIndex();
+	}
+	if (m_LightFieldDirty && m_LightField.IsConfigured()) {
+		UpdateLightField();
+	}
+
+	// the phases are only timed when the times are asked for
+	double t0 = pTimes ? Seconds() : 0.0;
+	m_Engine.ScheduleAll(dt);
+	if (m_SenseReuse) {
+		UpdateSenseReuse();
+	}
+	m_Engine.ClearAllSenses(dt);
+	double t1 = pTimes ? Seconds() : 0.0;
+	if (m_NeighbourSkin > 0) {
+		UpdateNeighbourLists();
+	}
+	m_Engine.SenseAll(this);
+	double t2 = pTimes ? Seconds() : 0.0;
+	m_Engine.UpdateAll(dt);
+	m_Engine.IntegrateActuators(dt);
+	double t3 = pTimes ? Seconds() : 0.0;
+	MoveEntities();
+	double t4 = pTimes ? Seconds() : 0.0;
+	if (!m_OpenWorld) {
+		WrapAround(0.0f, mMaxBoundH, 0.0f, mMaxBoundV);
+	}
+	double t5 = pTimes ? Seconds() : 0.0;
+	if (m_Scent.IsConfigured()) {
+		INSECTAI_PROFILE_SCOPE("Scent");
+		m_Scent.Step(dt);
+	}
+
+	if (pTimes) {
+		double t6 = Seconds();
+		pTimes->clearSenses += t1 - t0;
+		pTimes->sense += t2 - t1;
+		pTimes->update += t3 - t2;
+		pTimes->move += t4 - t3;
+		pTimes->wrap += t5 - t4;
+		pTimes->scent += t6 - t5;
+	}
+
+	if (m_AdaptiveGrid && ++m_TicksSinceGridTune >= kGridTuneInterval) {
+		TuneGrid();
+	}
+
+	if (m_SortInterval > 0 && ++m_TicksSinceSort >= m_SortInterval) {
+		SortEntities();
+	}
+
+	if (m_pRecorder) {
+		m_pRecorder->RecordStep(*this, dt);
+	}
+}
+
+uint32 World::Checksum() const {
+	// FNV-1a over the bits of the state, so that any difference at all shows up.
+	// Entities are hashed by index, so the order they are stored in doesn't matter
+	uint32 hash = 2166136261u;
+	uint32 words[4];
+	for (int i = 0; i < GetEntityCount(); ++i) {
+		PhysState const& state = GetEntityState(i);
+		memcpy(&words[0], &state.m_Position[0], sizeof(float));
+		memcpy(&words[1], &state.m_Position[1], sizeof(float));
+		memcpy(&words[2], &state.m_Rotation, sizeof(float));
+		words[3] = state.m_Kind;
+		unsigned char const* p = (unsigned char const*) words;
+		for (size_t b = 0; b < sizeof(words); ++b) {
+			hash = (hash ^ p[b]) * 16777619u;
+		}
+	}
+	unsigned char const* p = (unsigned char const*) &m_RandomState;
+	for (size_t b = 0; b < sizeof(m_RandomState); ++b) {
+		hash = (hash ^ p[b]) * 16777619u;
+	}
+	return hash;
+}
+
+void World::SetRecorder(ReplayRecorder* pRecorder) {
+	m_pRecorder = pRecorder;
+	if (m_pRecorder) {
+		m_pRecorder->RecordSnapshot(*this);
+	}
+}
+
+
+static void MoveVehicle(DemoVehicle* pVehicle, PhysState* pState, ScalarField* pScent)
+{
+    const float kSteeringSpeed = 0.0025f;
+
+	// connect actuators to physics
+	for (int i = 0; i < pVehicle->GetActuatorCount(); ++i) {
+		Actuator* pActuator = pVehicle->GetActuator(i);
+		switch (pActuator->GetKind()) {
+			case Actuator::kMotor:
+				{
+					pState->m_Rotation += kSteeringSpeed * pActuator->mSteeringActivation;
+					//mRotation = 0.25f * kPi;
+					if (pState->m_Rotation < 0.0f) pState->m_Rotation += 2.0f * kPi;
+					else if (pState->m_Rotation > 2.0f * kPi) pState->m_Rotation -= 2.0f * kPi;
+
+					const float forceScale = 1.f; // @TODO make this physical
+					float activation = forceScale * pActuator->mActivation;
+					// rotation of zero moves forward on y axis
+					pState->m_Position[0] += pVehicle->mMaxSpeed * sinf(pState->m_Rotation) * activation;
+					pState->m_Position[1] += pVehicle->mMaxSpeed * cosf(pState->m_Rotation) * activation;
+				}
+				break;
+
+			case Actuator::kDeposit:
+				if (pScent->IsConfigured() && pActuator->mActivation > 0.0f) {
+					pScent->Deposit(pState->m_Position[0], pState->m_Position[1], pActuator->mActivation);
+				}
+				break;
+		}
+	}
+}
+
+void World::MoveEntities()
+{
+	{
+		INSECTAI_PROFILE_SCOPE("MoveEntities");
+		for (int i = 0; i < GetEntityCount(); ++i) {
+			if (m_State[i].m_Kind == kVehicle) {
+				MoveVehicle(m_State[i].m_Vehicle, &m_State[i], &m_Scent);
+			}
+		}
+	}
+
+	// nothing is sensed until the next step, so the proxies can all be rebinned afterwards
+	INSECTAI_PROFILE_SCOPE("UpdateProxy");
+	for (int i = 0; i < GetEntityCount(); ++i) {
+		if (m_State[i].m_Kind == kVehicle) {
+			m_pNN->UpdateProxy(&m_State[i]);
+		}
+	}
+}
+
+int World::FindClosestEntity(float x, float y, float maxDistance)
+{
+	int best = -1;
+
+	maxDistance *= maxDistance;
+	float bestDistance = 1.0e7f;
+
+	for (int i = 0; i < GetEntityCount(); ++i) {
+		float distSquared = GetEntityState(i).DistanceSquared(x, y);
+
+		if (distSquared < bestDistance && distSquared < maxDistance) {
+			best = i;
+			bestDistance = distSquared;
+		}
+	}
+
+	return best;
+}
+
+
+void World::BuildStaticIndex()
+{
+	m_StaticIndex.Clear();
+	for (size_t i = 0; i < m_Lights.size(); ++i) {
+		PhysState const& light = GetEntityState(m_Lights[i]);
+		m_StaticIndex.Add(light.m_Position[0], light.m_Position[1], m_Lights[i], light.m_Kind);
+	}
+	m_StaticIndex.Build();
+	m_StaticIndexDirty = false;
+}
+
+int World::FindNearestLight(float x, float y)
+{
+	if (m_StaticIndexDirty) {
+		BuildStaticIndex();
+	}
+	return m_StaticIndex.FindNearest(x, y, kLight, 1.0e6f);
+}
+
+void World::SetLightField(float cellSize, float radius) {
+	m_LightFieldCellSize = cellSize;
+	m_LightFieldSplats.clear();
+	m_LightFieldDirty = true;
+	if (cellSize > 0) {
+		m_LightField.Configure(mMaxBoundH, mMaxBoundV, cellSize, radius);
+	}
+	else {
+		m_LightField = LightField();
+	}
+}
+
+void World::UpdateLightField()
+{
+	// lights rarely move, so only those that have are taken out of the field and put back
+	for (size_t i = 0; i < m_Lights.size(); ++i) {
+		PhysState const& light = GetEntityState(m_Lights[i]);
+		float x = light.m_Position[0];
+		float y = light.m_Position[1];
+		if (2 * i < m_LightFieldSplats.size()) {
+			float* pSplat = &m_LightFieldSplats[2 * i];
+			if (pSplat[0] == x && pSplat[1] == y)
+				continue;
+			m_LightField.Splat(pSplat[0], pSplat[1], -1);
+			pSplat[0] = x;
+			pSplat[1] = y;
+		}
+		else {
+			m_LightFieldSplats.push_back(x);
+			m_LightFieldSplats.push_back(y);
+		}
+		m_LightField.Splat(x, y, 1);
+	}
+	m_LightFieldDirty = false;
+}
+
+bool World::SampleLightField(Real const* pPosition, Real radius, Real& activation, Real* pSteering) {
+	if (!m_LightField.IsConfigured() || radius != m_LightField.GetRadius())
+		return false;
+
+	if (m_LightFieldDirty) {
+		UpdateLightField();
+	}
+	return m_LightField.Sample(pPosition[0], pPosition[1], activation, pSteering);
+}
+
+void World::SetScentField(float cellSize, float diffusion, float evaporation) {
+	if (cellSize > 0) {
+		m_Scent.Configure(mMaxBoundH, mMaxBoundV, cellSize);
+		m_Scent.SetRates(diffusion, evaporation);
+	}
+	else {
+		m_Scent = ScalarField();
+	}
+}
+
+bool World::SampleScent(Real const* pPosition, Real& concentration) {
+	if (!m_Scent.IsConfigured())
+		return false;
+
+	concentration = m_Scent.Sample(pPosition[0], pPosition[1]);
+	return true;
+}
+
+void World::SetSenseReuse(bool reuse) {
+	m_SenseReuse = reuse;
+	m_SenseReuseStats = SenseReuseStats();
+	m_SenseIdleFraction = 1.0f;
+	m_SenseColumns = 0;
+	for (size_t i = 0; i < m_State.size(); ++i) {
+		m_State[i].m_SensedStep = -1;
+		m_State[i].m_SenseNeeds = 0;
+		if (m_State[i].m_Vehicle) {
+			m_State[i].m_Vehicle->SetKeepSenses(false);
+		}
+	}
+}
+
+void World::SetLazyBrains(bool lazy, float epsilon) {
+	m_LazyBrains = lazy;
+	m_LazyEpsilon = epsilon;
+	for (size_t i = 0; i < m_State.size(); ++i) {
+		if (m_State[i].m_Vehicle) {
+			m_State[i].m_Vehicle->SetLazy(lazy, epsilon);
+		}
+	}
+}
+
+void World::SetActuatorDynamics(uint32 kind, float lag, float rateLimit) {
+	int k = DynamicsIndex(kind);
+	if (k < 0)
+		return;
+	m_ActuatorDynamics[k][0] = lag;
+	m_ActuatorDynamics[k][1] = rateLimit;
+	for (size_t i = 0; i < m_State.size(); ++i) {
+		DemoVehicle* pVehicle = m_State[i].m_Vehicle;
+		for (int a = 0; pVehicle && a < pVehicle->GetActuatorCount(); ++a) {
+			if (pVehicle->GetActuator(a)->GetKind() == kind) {
+				pVehicle->GetActuator(a)->SetDynamics(lag, rateLimit);
+			}
+		}
+	}
+	m_Engine.InvalidateActuators();
+}
+
+float World::GetActuatorLag(uint32 kind) const {
+	int k = DynamicsIndex(kind);
+	return k < 0 ? 0.0f : m_ActuatorDynamics[k][0];
+}
+
+float World::GetActuatorRateLimit(uint32 kind) const {
+	int k = DynamicsIndex(kind);
+	return k < 0 ? 0.0f : m_ActuatorDynamics[k][1];
+}
+
+namespace {
+	/// What a vehicle's senses depend on, as PhysState::m_SenseNeeds
+	enum { kTracked = 1, kNeedsLights = 2, kNeedsVehicles = 4, kNeedsEverything = 8 };
+
+	/// Below this fraction of entities standing still, too few vehicles could keep their
+	/// senses to pay for tracking the cells they are in
+	const float kMinSenseIdleFraction = 0.25f;
+
+	uint32 SenseNeeds(DemoVehicle const* pVehicle) {
+		uint32 needs = kTracked;
+		for (int i = 0; i < pVehicle->GetSensorCount(); ++i) {
+			Sensor const* pSensor = pVehicle->GetSensor(i);
+			if (pSensor->mbInternalSensor)
+				continue;
+
+			// sensors of a whole field may change without anything moving
+			uint32 filter = pSensor->GetSensedAgentKind();
+			if (pSensor->GetSensorWidth() != Sensor::kNearest)	needs |= kNeedsEverything;
+			else if ((filter & World::kLight) != 0)				needs |= kNeedsLights;
+			else if (filter != 0)								needs |= kNeedsVehicles;
+		}
+		return needs;
+	}
+}
+
+int World::SenseCell(float x, float y) const {
+	float cellSize = kCollisionQueryRadius;
+	int column = PMath::Clamp((int) floorf(x / cellSize), 0, m_SenseColumns - 1);
+	int row = PMath::Clamp((int) floorf(y / cellSize), 0, m_SenseRows - 1);
+	return row * m_SenseColumns + column;
+}
+
+void World::UpdateSenseReuse()
+{
+	INSECTAI_PROFILE_SCOPE("SenseReuse");
+	int step = ++m_SenseStep;
+
+	// new bounds change every cell, so everything is taken to have changed
+	int columns = PMath::Max(1, (int) ceilf(mMaxBoundH / kCollisionQueryRadius));
+	int rows = PMath::Max(1, (int) ceilf(mMaxBoundV / kCollisionQueryRadius));
+	if (columns != m_SenseColumns || rows != m_SenseRows) {
+		m_SenseColumns = columns;
+		m_SenseRows = rows;
+		m_SenseStamps.assign(columns * rows, step);
+		m_LightsChangedStep = step;
+	}
+
+	// in a busy scene the cells are not stamped, and everything is taken to have changed, so
+	// every vehicle senses. A scene is busy while too little of it stood still the step before
+	bool stamp = m_SenseIdleFraction >= kMinSenseIdleFraction;
+	if (!stamp) {
+		m_SensesChangedStep = step;
+	}
+
+	// whatever moved since the last step began marks the cells it left and entered, and must
+	// sense again itself. Entities outside the bounds are counted in the cells at the edge
+	int moved = 0;
+	for (std::deque<PhysState>::iterator i = m_State.begin(); i != m_State.end(); ++i) {
+		PhysState& state = *i;
+		if (state.m_SenseNeeds != 0) {
+			if (state.m_Tracked[0] == state.m_Position[0] && state.m_Tracked[1] == state.m_Position[1] &&
+				state.m_Tracked[2] == state.m_Rotation)
+				continue;
+			if (stamp && state.m_Kind == kVehicle) {
+				m_SenseStamps[SenseCell(state.m_Tracked[0], state.m_Tracked[1])] = step;
+			}
+		}
+		else {
+			state.m_SenseNeeds = state.m_Vehicle ? SenseNeeds(state.m_Vehicle) : (uint32) kTracked;
+		}
+
+		++moved;
+		state.m_Tracked[0] = state.m_Position[0];
+		state.m_Tracked[1] = state.m_Position[1];
+		state.m_Tracked[2] = state.m_Rotation;
+		if (state.m_Kind == kLight) {
+			m_LightsChangedStep = step;
+		}
+		else {
+			if (stamp) {
+				m_SenseStamps[SenseCell(state.m_Position[0], state.m_Position[1])] = step;
+			}
+			state.m_SensedStep = -1;
+		}
+	}
+	m_SenseIdleFraction = m_State.empty() ? 1.0f : 1.0f - (float) moved / m_State.size();
+
+	int vehicles = 0, reused = 0;
+	for (std::deque<PhysState>::iterator i = m_State.begin(); i != m_State.end(); ++i) {
+		PhysState& state = *i;
+		if (state.m_Kind != kVehicle || !state.m_Vehicle->IsUpdateDue())
+			continue;
+
+		++vehicles;
+		bool keep = stamp && state.m_SensedStep >= 0 && CanReuseSenses(state);
+		state.m_Vehicle->SetKeepSenses(keep);
+		if (keep) {
+			++reused;
+		}
+		else {
+			state.m_SensedStep = step;
+		}
+	}
+
+	++m_SenseReuseStats.steps;
+	m_SenseReuseStats.vehicles = vehicles;
+	m_SenseReuseStats.reused = reused;
+	m_SenseReuseStats.totalVehicles += vehicles;
+	m_SenseReuseStats.totalReused += reused;
+}
+
+bool World::CanReuseSenses(PhysState const& state) const
+{
+	// nearest lights are found anywhere, nearest vehicles within the collision query radius
+	uint32 needs = state.m_SenseNeeds;
+	if ((needs & kNeedsEverything) != 0 || m_SensesChangedStep > state.m_SensedStep)
+		return false;
+	if ((needs & kNeedsLights) != 0 && m_LightsChangedStep > state.m_SensedStep)
+		return false;
+
+	if ((needs & kNeedsVehicles) != 0) {
+		float x = state.m_Position[0], y = state.m_Position[1];
+		float radius = kCollisionQueryRadius;
+		int first = SenseCell(x - radius, y - radius);
+		int last = SenseCell(x + radius, y + radius);
+		int columns = last % m_SenseColumns - first % m_SenseColumns + 1;
+		for (int row = first; row <= last; row += m_SenseColumns) {
+			for (int cell = row; cell < row + columns; ++cell) {
+				if (m_SenseStamps[cell] > state.m_SensedStep)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void World::SetNeighbourListSkin(float skin) {
+	m_NeighbourSkin = PMath::Max(skin, 0.0f);
+	m_NeighbourListsDirty = true;
+	m_NeighbourListStats = NeighbourListStats();
+}
+
+void World::UpdateNeighbourLists() {
+	INSECTAI_PROFILE_SCOPE("NeighbourLists");
+	++m_NeighbourListStats.steps;
+
+	// a vehicle that has moved less than half the skin, and a neighbour that has too, can't
+	// have come within the query radius unless they were within radius + skin at the build.
+	// Those that have moved further lose their list, and are tested by every query instead
+	if (!m_NeighbourListsDirty) {
+		float limit = 0.25f * m_NeighbourSkin * m_NeighbourSkin;
+		for (size_t slot = 0; slot < m_State.size(); ++slot) {
+			PhysState& state = m_State[slot];
+			if (state.m_NeighbourList >= 0) {
+				float const* pOrigin = &m_NeighbourOrigin[2 * state.m_NeighbourList];
+				if (state.DistanceSquared(pOrigin[0], pOrigin[1]) > limit) {
+					state.m_NeighbourList = -1;
+					m_NeighbourMovers.push_back(&state);
+				}
+			}
+		}
+		if (m_NeighbourMovers.size() <= kMaxNeighbourListMovers)
+			return;
+	}
+	BuildNeighbourLists();
+}
+
+void World::BuildNeighbourLists() {
+	++m_NeighbourListStats.builds;
+	m_NeighbourStart.clear();
+	m_NeighbourEntries.clear();
+	m_NeighbourOrigin.clear();
+	m_NeighbourMovers.clear();
+
+	std::vector<NNProxy*> found;
+	float radius = kCollisionQueryRadius + m_NeighbourSkin;
+	for (size_t slot = 0; slot < m_State.size(); ++slot) {
+		PhysState& state = m_State[slot];
+		state.m_NeighbourList = -1;
+		if (state.m_Kind != kVehicle)
+			continue;
+
+		state.m_NeighbourList = (int) m_NeighbourStart.size();
+		m_NeighbourStart.push_back((int) m_NeighbourEntries.size());
+		m_NeighbourOrigin.push_back(state.m_Position[0]);
+		m_NeighbourOrigin.push_back(state.m_Position[1]);
+
+		found.clear();
+		m_pNN->FindNeighbours(state.m_Position, radius, kVehicle, &state, found);
+		for (size_t i = 0; i < found.size(); ++i) {
+			m_NeighbourEntries.push_back((PhysState*) found[i]);
+		}
+	}
+	m_NeighbourStart.push_back((int) m_NeighbourEntries.size());
+
+	m_NeighbourListStats.lists = (int) m_NeighbourStart.size() - 1;
+	m_NeighbourListStats.entries = (long long) m_NeighbourEntries.size();
+	m_NeighbourListsDirty = false;
+}
+
+InsectAI::DynamicState* World::GetNearest(InsectAI::Entity* pE, uint32 filter)
+{
+    InsectAI::DynamicState* pRetVal = 0;
+    if (filter != 0) {
+        Real nearest = 1.0e6f;
+        Real radius;
+
+        PhysState* pState = (PhysState*) pE->GetDynamicState();
+
+        // lights are found in the static index rather than lq, which is not that fast when
+        // the search radius is similar to the size of the database
+        if ((filter & kLight) != 0) {
+            if (m_StaticIndexDirty) {
+                BuildStaticIndex();
+            }
+            int light = m_StaticIndex.FindNearest(pState->m_Position[0], pState->m_Position[1], filter, nearest);
+            if (light >= 0) {
+                pRetVal = &m_State[m_Slot[light]];
+            }
+        }
+        else {
+            if (!m_pNN) {
+                fprintf(stderr, "nearest neighbour object not initialized\n");
+                exit(EXIT_FAILURE);
+            }
+            radius = kCollisionQueryRadius;
+
+            // a vehicle with a neighbour list only needs to look through it, and at the vehicles
+            // that have moved too far to be trusted to be in the lists they belong in
+            if (pState->m_NeighbourList >= 0 && !m_NeighbourListsDirty && (filter & kVehicle) != 0) {
+                PhysState* pNearest = 0;
+                float nearestSquared = radius * radius;
+                int end = m_NeighbourStart[pState->m_NeighbourList + 1];
+                for (int i = m_NeighbourStart[pState->m_NeighbourList]; i < end; ++i) {
+                    float distSquared = pState->DistanceSquared(m_NeighbourEntries[i]);
+                    if (distSquared < nearestSquared) {
+                        nearestSquared = distSquared;
+                        pNearest = m_NeighbourEntries[i];
+                    }
+                }
+                for (size_t i = 0; i < m_NeighbourMovers.size(); ++i) {
+                    float distSquared = pState->DistanceSquared(m_NeighbourMovers[i]);
+                    if (distSquared < nearestSquared) {
+                        nearestSquared = distSquared;
+                        pNearest = m_NeighbourMovers[i];
+                    }
+                }
+                return pNearest;
+            }
+
+            PhysState* pNearest = (PhysState*) m_pNN->FindNearestNeighbour(pState->GetPosition(), radius, filter, pState);
+            return pNearest;
+        }
+
+    }
+    return pRetVal;
+}
+
+InsectAI::DynamicState* World::GetNearestInView(InsectAI::Entity* pE, uint32 filter, Real cosHalfAngle, Real nearRadius)
+{
+    if (filter == 0 || (filter & kLight) != 0) {
+        return GetNearest(pE, filter);
+    }
+    if (!m_pNN) {
+        fprintf(stderr, "nearest neighbour object not initialized\n");
+        exit(EXIT_FAILURE);
+    }
+
+    PhysState* pState = (PhysState*) pE->GetDynamicState();
+    Real radius = kCollisionQueryRadius;
+    Real forward[2] = { sinf(pState->m_Rotation), cosf(pState->m_Rotation) };
+
+    if (pState->m_NeighbourList >= 0 && !m_NeighbourListsDirty && (filter & kVehicle) != 0) {
+        PhysState* pNearest = 0;
+        float nearestSquared = radius * radius;
+        int end = m_NeighbourStart[pState->m_NeighbourList + 1];
+        for (int i = m_NeighbourStart[pState->m_NeighbourList]; i < end; ++i) {
+            PhysState* pOther = m_NeighbourEntries[i];
+            float distSquared = pState->DistanceSquared(pOther);
+            if (distSquared < nearestSquared &&
+                NearestNeighbours::InView(pOther->m_Position[0] - pState->m_Position[0], pOther->m_Position[1] - pState->m_Position[1],
+                                          distSquared, forward, cosHalfAngle, nearRadius)) {
+                nearestSquared = distSquared;
+                pNearest = pOther;
+            }
+        }
+        for (size_t i = 0; i < m_NeighbourMovers.size(); ++i) {
+            PhysState* pOther = m_NeighbourMovers[i];
+            float distSquared = pState->DistanceSquared(pOther);
+            if (distSquared < nearestSquared &&
+                NearestNeighbours::InView(pOther->m_Position[0] - pState->m_Position[0], pOther->m_Position[1] - pState->m_Position[1],
+                                          distSquared, forward, cosHalfAngle, nearRadius)) {
+                nearestSquared = distSquared;
+                pNearest = pOther;
+            }
+        }
+        return pNearest;
+    }
+
+    return (PhysState*) m_pNN->FindNearestNeighbourInView(pState->GetPosition(), radius, forward, cosHalfAngle, nearRadius, filter, pState);
+}
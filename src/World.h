@@ -0,0 +1,385 @@
+
+/** @file	World.h
+	@brief	A simulation-only world of lights and vehicles, with no rendering or input
+	*/
+
+#ifndef _WORLD_H_
+#define _WORLD_H_
+
+#include "InsectAI.h"
+#include "KDTree.h"
+#include "LightField.h"
+#include "NearestNeighbours.h"
+#include "ScalarField.h"
+
+#include <deque>
+#include <vector>
+
+class BrainDescription;
+class PhysState;
+class DemoVehicle;
+class ReplayRecorder;
+
+class PhysState : public InsectAI::DynamicState, public NNProxy {
+public:
+			PhysState() : m_Rotation(0.0f), m_Vehicle(0), m_Kind(0), m_NeighbourList(-1), m_SensedStep(-1), m_SenseNeeds(0) { m_Position[0] = k0; m_Position[1] = k0; m_Position[2] = k0; }
+	virtual ~PhysState() { }
+
+			float			DistanceSquared(float x, float y) const {
+				float dx = x - m_Position[0];
+				float dy = y - m_Position[1];
+				float distSquared = dx * dx + dy * dy;
+				return distSquared;
+			}
+
+			float			DistanceSquared(PhysState const* pRHS) const {
+				return DistanceSquared(pRHS->m_Position[0], pRHS->m_Position[1]);
+			}
+
+			// implements the DynamicState API
+			Real const*const	GetPosition() const { return &m_Position[0]; }
+			Real const			GetHeading() const { return m_Rotation; }
+			Real const			GetPitch() const { return k0; }
+
+			// implements the NNProxy API
+			float const*const	GetPositionVectorPtr() const { return &m_Position[0]; }
+			uint32	GetSearchMask() const { return m_Kind; }
+
+			float				m_Rotation;
+			PMath::Vec3f		m_Position;
+			DemoVehicle*		m_Vehicle;		///< vehicles are tracked here, so we can render their brains
+			uint32				m_Kind;			///< the kind of the AI
+			int					m_NeighbourList;	///< the vehicle's cached neighbours, or -1 if it has none
+			int					m_SensedStep;		///< while senses are reused, the step the vehicle last sensed at, or -1 if it must sense
+			uint32				m_SenseNeeds;		///< what the vehicle's senses depend on, or 0 until it is tracked
+			float				m_Tracked[3];		///< x, y and heading as the last step began, while senses are reused
+};
+
+class DemoVehicle : public InsectAI::Vehicle {
+public:
+	DemoVehicle(PhysState* pState) : m_pState(pState) { }
+	virtual ~DemoVehicle() { }
+	InsectAI::DynamicState* GetDynamicState() { return m_pState; }
+	PhysState* m_pState;				///< This is used to quickly get the phys state from a vehicle during sensing
+};
+
+class DemoLight : public InsectAI::Light {
+public:
+	DemoLight(PhysState* pState) : m_pState(pState) { }
+	virtual ~DemoLight() { }
+	InsectAI::DynamicState* GetDynamicState() { return m_pState; }
+	PhysState* m_pState;				///< This is used to quickly get the phys state from a vehicle during sensing
+};
+
+/// @struct	StepTimes
+/// @brief	Wall clock seconds spent in each stage of World::Step
+struct StepTimes {
+	StepTimes() : clearSenses(0), sense(0), update(0), move(0), wrap(0), scent(0) { }
+
+	double clearSenses;		///< Engine::ClearAllSenses, and choosing the vehicles that keep their senses
+	double sense;			///< Engine::SenseAll, including the spatial queries
+	double update;			///< Engine::UpdateAll, the brains
+	double move;			///< MoveEntities, including the proxy rebinning
+	double wrap;			///< WrapAround
+	double scent;			///< ScalarField::Step of the scent field
+};
+
+/// @struct	NeighbourListStats
+/// @brief	How often a world's neighbour lists were rebuilt, and how long they were
+struct NeighbourListStats {
+	NeighbourListStats() : steps(0), builds(0), entries(0), lists(0) { }
+
+	int			steps;			///< steps taken with the lists enabled
+	int			builds;			///< of which rebuilt the lists
+	long long	entries;		///< neighbours listed by the last build
+	int			lists;			///< vehicles listed by the last build
+};
+
+/// @struct	SenseReuseStats
+/// @brief	How many vehicles kept their senses instead of sensing again
+struct SenseReuseStats {
+	SenseReuseStats() : steps(0), vehicles(0), reused(0), totalVehicles(0), totalReused(0) { }
+
+	int			steps;			///< steps taken with reuse enabled
+	int			vehicles;		///< vehicles in the last step
+	int			reused;			///< of which kept their senses
+	long long	totalVehicles;	///< over every step
+	long long	totalReused;
+};
+
+/** @class	World
+	@brief	Owns the entities of a simulation, their physical state, and the spatial database.
+			The interactive Demo derives from World and adds rendering and input; headless tools
+			use a World directly.
+	*/
+
+class World : public InsectAI::EntityDatabase {
+	friend class Snapshot;
+
+public:
+			World();
+	virtual ~World();
+
+			enum { kVehicle = 1, kLight = 2 };	// bit masks, so we can or them together for searches
+
+			/// Set the extent of the world, and rebuild the spatial database to suit it
+			void	SetBounds(float width, float height);
+
+			/// An open world has no edges: entities are not wrapped around at the bounds, and the
+			/// spatial database is a sparse hash over the whole plane, so queries cost the same
+			/// however far entities wander. The bounds still place new vehicles and size the sensors
+			void	SetOpenWorld(bool open);
+			bool	IsOpenWorld() const { return m_OpenWorld; }
+
+			/// Rebuild the spatial database with square sub-bricks of about the given size
+			void	SetGridCellSize(float cellSize);
+			float	GetGridCellSize() const { return m_GridCellSize; }
+
+			/// Keep the spatial database at this many resolutions, each NearestNeighbours::kLevelRatio
+			/// times coarser than the last, for queries much wider than a sub-brick. Open worlds
+			/// keep a single level
+			void	SetGridLevels(int levels);
+			int		GetGridLevels() const { return m_GridLevels; }
+
+			/// In adaptive mode, every kGridTuneInterval steps the world estimates the cost of its
+			/// queries at other cell sizes, from the bin occupancy and the number and mean radius
+			/// of the queries made since, and rebuilds the spatial database if another size is
+			/// estimated to be much cheaper. The estimate weighs a bin visit against a distance
+			/// test by a fixed factor, so it can settle an octave from the fastest cell size; it
+			/// is off unless asked for
+			void	SetAdaptiveGrid(bool adaptive) { m_AdaptiveGrid = adaptive; m_TicksSinceGridTune = 0; }
+			bool	IsAdaptiveGrid() const { return m_AdaptiveGrid; }
+
+			/// Run the adaptive grid's estimate now
+			/// @return true if the grid was rebuilt
+			bool	TuneGrid();
+
+			/// Every interval steps, store the entities in Z order of their positions, so that
+			/// neighbours are near each other in memory and are sensed one after another.
+			/// Entity indices are handles that are not affected by the order. 0 turns it off
+			void	SetSortInterval(int interval) { m_SortInterval = interval; m_TicksSinceSort = 0; }
+			int		GetSortInterval() const { return m_SortInterval; }
+
+			/// Put the entities in Z order now
+			void	SortEntities();
+
+			/// Cache, for each vehicle, the vehicles within the collision query radius plus a skin,
+			/// so that collision sensing scans a short list instead of querying the spatial
+			/// database. Vehicles that move more than half the skin from where they were when the
+			/// lists were built lose their list and are tested by every other vehicle instead;
+			/// the lists are rebuilt once there are more than kMaxNeighbourListMovers of them.
+			/// The nearest vehicle found is the one the spatial database would find. 0 turns it off
+			void	SetNeighbourListSkin(float skin);
+			float	GetNeighbourListSkin() const { return m_NeighbourSkin; }
+			NeighbourListStats const& GetNeighbourListStats() const { return m_NeighbourListStats; }
+
+			/// Let a vehicle keep its senses from the step it last sensed at, rather than clearing
+			/// and sensing again, while neither it nor anything it could sense has moved, turned,
+			/// arrived or left since. Vehicles are tracked in cells of the collision query radius
+			/// and lights as a whole; vehicles with sensors of a whole field always sense.
+			/// Kept senses keep the noise they drew, so a world with reuse departs from one without
+			/// once a noisy sensor is kept. While less than a quarter of the entities stood still
+			/// over the last step, the cells are not tracked and every vehicle senses, so a busy
+			/// scene pays little for reuse. Like the grid, reuse is not saved in snapshots, and a
+			/// restored world senses every vehicle on its first step
+			void	SetSenseReuse(bool reuse);
+			bool	IsSenseReuse() const { return m_SenseReuse; }
+			SenseReuseStats const& GetSenseReuseStats() const { return m_SenseReuseStats; }
+
+			/// The fraction of vehicles that kept their senses in the last step
+			float	GetSenseReuseFraction() const {
+				return m_SenseReuseStats.vehicles ? (float) m_SenseReuseStats.reused / m_SenseReuseStats.vehicles : 0.0f;
+			}
+
+			/// Make every vehicle's brain, and those of vehicles added later, evaluate only the nodes
+			/// whose inputs changed by more than epsilon; see Vehicle::SetLazy. Off by default, since
+			/// it only pays in scenes where much stays still. Not saved in snapshots
+			void	SetLazyBrains(bool lazy, float epsilon = 0.0f);
+			bool	IsLazyBrains() const { return m_LazyBrains; }
+
+			/// Give every actuator of a kind, in vehicles now and later, a lag in seconds and a
+			/// rate limit per second; see Actuator::SetDynamics. 0 and 0 remove them. Vehicles
+			/// added later keep dynamics of their own for kinds the world gives none. Saved in
+			/// snapshots along with every actuator's own dynamics
+			void	SetActuatorDynamics(uint32 kind, float lag, float rateLimit);
+			float	GetActuatorLag(uint32 kind) const;
+			float	GetActuatorRateLimit(uint32 kind) const;
+
+			/// Think about distant vehicles less often: the priority puts each vehicle in one of
+			/// levels buckets after it updates, and a vehicle in bucket n senses and updates every
+			/// 2^n ticks with the time accumulated since, while every vehicle keeps moving every
+			/// tick. The priority is not owned, and a null priority updates everything every tick.
+			/// Like reuse, the schedule is not saved in snapshots
+			void	SetUpdatePriority(InsectAI::UpdatePriority* pPriority, int levels = 3) { m_Engine.SetUpdatePriority(pPriority, levels); }
+			InsectAI::Engine const& GetEngine() const { return m_Engine; }
+
+			/// Advance the simulation.
+			/// If pTimes is not null, the time spent in each stage is accumulated into it
+			void	Step(float dt, StepTimes* pTimes = 0);
+
+			/// Restart the world's random number stream. Every world owns its own stream, so
+			/// worlds with the same seed and inputs evolve identically, on any thread
+			void	Seed(uint32 seed) { m_RandomState = PMath::RandomSeed(seed); }
+
+			void	ClearAll();
+			void	BuildTestBrain(InsectAI::Vehicle* pVehicle, uint32 brainType);
+			void	CreatePopulation(uint32 brainType, int count);
+			void	CreatePopulationScaling(int count);
+			void	CreateLightSeekingAvoider();
+
+			/// Add count vehicles with the given test brain to the running world
+			void	SpawnVehicles(uint32 brainType, int count);
+
+			/// Add count vehicles with a described brain, its lengths in widths of the world
+			void	SpawnVehicles(BrainDescription const& brain, int count);
+
+			/// Move an entity, as the user does by dragging it in the demo
+			void	PlaceEntity(int index, float x, float y);
+
+			/// Add a light at a position
+			/// @return the entity index of the light
+			int		CreateLight(float x, float y);
+
+			/// The entity index of the nearest light within the range of light sensors, or -1.
+			/// Lights only move when they are placed, so they are kept in a static KDTree that is
+			/// rebuilt after edits, and the query is O(log lights) whatever the population
+			int		FindNearestLight(float x, float y);
+
+			/// Rasterise every light into a field with nodes cellSize apart, which light sensors of
+			/// the given radius sample instead of querying the nearest light. A cell size of 0 turns
+			/// the field off. The field covers the bounds; in open worlds, sensors beyond them see
+			/// the field at its edge
+			void	SetLightField(float cellSize, float radius);
+			LightField const& GetLightField() const { return m_LightField; }
+
+			/// Give the world a scent field of square cells over its bounds, which deposit actuators
+			/// lay scent into and field sensors smell. Every step the field diffuses and evaporates at
+			/// the given rates, per second. A cell size of 0 removes it
+			void	SetScentField(float cellSize, float diffusion, float evaporation);
+			ScalarField& GetScentField() { return m_Scent; }
+			ScalarField const& GetScentField() const { return m_Scent; }
+			int		GetEntityCount() const { return (int) m_State.size(); }
+			int		GetLightCount() const { return (int) m_Lights.size(); }
+			int		GetLight(int i) const { return m_Lights[i]; }		///< entity index of the i'th light
+			const PhysState& GetEntityState(int index) const { return m_State[m_Slot[index]]; }
+			int		FindClosestEntity(float x, float y, float maxDistance);
+			void	MoveEntities();
+
+			/// Wrap all the agents around a rectangular planar universe
+			void	WrapAround(float left, float right, float bottom, float top);
+
+			const char*	GetName() const { return m_Name; }
+			uint32		GetRandomState() const { return m_RandomState; }
+
+			/// A hash of every entity's position and heading, and the random number state.
+			/// Two worlds with the same checksum are, for all practical purposes, in the same state
+			uint32		Checksum() const;
+
+			/// Send every subsequent step, spawn and placement to a recorder, starting with a
+			/// snapshot of the world as it is now. The recorder is not owned; pass 0 to stop recording
+			void		SetRecorder(ReplayRecorder* pRecorder);
+
+			InsectAI::DynamicState* GetNearest(InsectAI::Entity*, uint32 filter);
+
+			/// Vehicles are found with a sector query; lights have no sector query in the static
+			/// index, and are found as by GetNearest
+			InsectAI::DynamicState* GetNearestInView(InsectAI::Entity*, uint32 filter, Real cosHalfAngle, Real nearRadius);
+
+			bool	SampleLightField(Real const* pPosition, Real radius, Real& activation, Real* pSteering);
+			bool	SampleScent(Real const* pPosition, Real& concentration);
+
+    /// radius of the spatial query for vehicles; should account for 2 * maximum velocity of a bug
+    static const float kCollisionQueryRadius;
+
+    /// a skin that rebuilds the neighbour lists about every ten steps at the demo's speeds
+    static const float kDefaultNeighbourListSkin;
+
+    enum { kGridTuneInterval = 30, kDefaultSortInterval = 120, kMaxNeighbourListMovers = 16 };
+
+    float mMaxBoundH, mMaxBoundV;
+    NearestNeighbours*        m_pNN;
+
+protected:
+
+	void	AddAllProxies();
+	void	RemoveAllProxies();
+
+	void	CreateDemoZero_Zero();
+	void	CreateDemoZero_One();
+	void	CreateDemoZero_Two();
+	void	CreateDemoZero_Three();
+	void	CreateDemoOne();
+	void	CreateDemoTwo_Zero();
+	void	CreateDemoTwo();
+	void	CreateDemoThree();
+
+	int		CreateVehicle(uint32 brainType, BrainDescription const* pBrain = 0);
+	PhysState& NewState();
+
+	/// The box around every entity, as min x, min y, max x, max y
+	void	GetExtent(float* pBounds) const;
+
+	void	UpdateSenseReuse();
+	bool	CanReuseSenses(PhysState const& state) const;
+	int		SenseCell(float x, float y) const;
+
+	void	UpdateNeighbourLists();
+	void	BuildNeighbourLists();
+	void	SetStorageOrder(std::vector<int> const& handles);
+	void	BuildStaticIndex();
+	void	UpdateLightField();
+	void	AddEntity(PhysState& state, InsectAI::Entity* pEntity);
+
+	// Entity indices are stable for the lifetime of a world, and are handles to the storage
+	// slots, which are reordered by SortEntities. A deque is used so that growing the world
+	// never moves a PhysState, because vehicles and the lq bins hold pointers to them
+	std::deque<PhysState>	m_State;				///< by slot
+	std::vector<int>		m_Slot;					///< slot of each entity index
+	std::vector<int>		m_Handle;				///< entity index in each slot
+	std::vector<int>		m_AI;					///< Engine ID of each entity, by entity index
+	std::vector<int>		m_Lights;				///< entity indices of the lights
+	KDTree					m_StaticIndex;			///< the lights, by entity index
+	bool					m_StaticIndexDirty;		///< a light was added, removed or moved since the build
+	LightField				m_LightField;			///< unconfigured when off
+	float					m_LightFieldCellSize;
+	bool					m_LightFieldDirty;		///< a light was added, removed or moved since the update
+	std::vector<float>		m_LightFieldSplats;		///< x, y each light was splatted at, by light
+	ScalarField				m_Scent;				///< unconfigured when off
+
+	const char*				m_Name;
+	InsectAI::Engine		m_Engine;
+	uint32					m_RandomState;			///< randf draws from this while the world is creating or stepping
+	ReplayRecorder*			m_pRecorder;			///< receives the world's inputs while recording
+	float					m_GridCellSize;			///< edge of a sub-brick of the spatial database
+	int						m_GridLevels;
+	bool					m_OpenWorld;
+	bool					m_AdaptiveGrid;
+	int						m_TicksSinceGridTune;
+	int						m_SortInterval;
+	int						m_TicksSinceSort;
+
+	float					m_NeighbourSkin;		///< 0 when the lists are off
+	bool					m_NeighbourListsDirty;	///< entities were added or moved in memory since the build
+	std::vector<int>		m_NeighbourStart;		///< first entry of each list, and one past the last
+	std::vector<PhysState*>	m_NeighbourEntries;
+	std::vector<float>		m_NeighbourOrigin;		///< x, y of each listed vehicle at the build
+	std::vector<PhysState*>	m_NeighbourMovers;		///< vehicles that lost their list since the build
+	NeighbourListStats		m_NeighbourListStats;
+
+	bool					m_SenseReuse;
+	int						m_SenseStep;			///< steps taken with reuse enabled
+	int						m_LightsChangedStep;	///< the step at which a light last moved, arrived or left
+	int						m_SensesChangedStep;	///< the last busy step, at which the cells were not stamped
+	float					m_SenseIdleFraction;	///< of the entities that stood still over the last step
+	int						m_SenseColumns;
+	int						m_SenseRows;
+	std::vector<int>		m_SenseStamps;			///< the step at which a vehicle last moved in, out of or within each cell
+	SenseReuseStats			m_SenseReuseStats;
+
+	bool					m_LazyBrains;
+	float					m_LazyEpsilon;
+	float					m_ActuatorDynamics[3][2];	///< lag and rate limit of motors, steering and deposits
+};
+
+
+#endif
@@ -1,19 +1,59 @@
 
-
 #include "InsectAI.h"
 
 namespace InsectAI {
 
-	Actuator::Actuator(uint32 kind) : mKind(kind) {
+	Actuator::Actuator(uint32 kind)
+	: mpInput(0), mActivation(0.0f), mSteeringActivation(0.0f), mTarget(0.0f), mSteeringTarget(0.0f),
+	  mKind(kind), mLag(0.0f), mRateLimit(0.0f) {
 	}
 
 	Actuator::~Actuator() {
 	}
 
+void Actuator::SetInput(Sensor* pSensor) {
+	mpInput = pSensor;
+	mInputs.assign(1, pSensor);
+	mWeights.assign(1, 1.0f);
+}
+
+void Actuator::AddInput(Sensor* pSensor, float weight) {
+	if (mInputs.empty()) {
+		mpInput = pSensor;
+	}
+	mInputs.push_back(pSensor);
+	mWeights.push_back(weight);
+}
+
+bool Actuator::InputsChanged() const {
+	for (size_t i = 0; i < mInputs.size(); ++i) {
+		if (mInputs[i]->mbChanged)
+			return true;
+	}
+	return false;
+}
 
 void Actuator::Update(float dt) {
-	mActivation = mpInput->mActivation;		// to do, time integration or weighting
-	mSteeringActivation = mpInput->mSteeringActivation;
+	// a single input of weight one passes through untouched
+	if (mInputs.size() == 1 && mWeights[0] == 1.0f) {
+		mTarget = mpInput->mActivation;
+		mSteeringTarget = mpInput->mSteeringActivation;
+	}
+	else {
+		float activation = 0.0f, steering = 0.0f;
+		for (size_t i = 0; i < mInputs.size(); ++i) {
+			activation += mWeights[i] * mInputs[i]->mActivation;
+			steering += mWeights[i] * mInputs[i]->mSteeringActivation;
+		}
+		mTarget = activation;
+		mSteeringTarget = steering;
+	}
+
+	// with dynamics the engine integrates the outputs
+	if (!HasDynamics()) {
+		mActivation = mTarget;
+		mSteeringActivation = mSteeringTarget;
+	}
 }
 
-} // end namespace InsectAI
\ No newline at end of file
+} // end namespace InsectAI
@@ -4,9 +4,14 @@
 #include "Clock.h"
 
 #include "demo.h"
+#include "Profiler.h"
+#include "Replay.h"
 
 #include "raylib.h"
 
+#include <stdio.h>
+#include <string.h>
+
 #define MAXDEMO 7
 
 using PMath::randf;
@@ -28,86 +33,20 @@ void DrawUserPrompts(const char* name, const char* mouse, const char* keys)
 }
 
 Demo::Demo() :
-	m_pNN(0),
-	mCurrentDemo(0), m_AICount(0), m_DemoName(0), 
-	mMousex(0), mMousey(0), mDemoMode(0)
+	mShowBrains(false), mDemoMode(0),
+	mCurrentPick(-1), mPotentialPick(-1), mInspectingPick(-1),
+	mCurrentDemo(0), mMousex(0), mMousey(0)
 {
-	ClearAll();
 }
 
 Demo::~Demo() { 
-	delete m_pNN;
 }
 
-void Demo::BuildTestBrain(InsectAI::Vehicle* pVehicle, uint32 brainType) {
-	LightSensor* pLightSensor;
-	CollisionSensor* pCollisionSensor;
-	Actuator* pMotor;
-
-	static uint32 funcs[3] = {Function::kBuffer, Function::kInvert, Function::kSigmoid};
-
-	bool directional = (brainType > 3 && brainType < 8);
-
-	switch (brainType) {
-
-		// light activated or light seeking
-		case 0:
-		case 4:
-			{	
-				pVehicle->AllocBrain(1, 1);
-				pLightSensor = new LightSensor(directional, mMaxBoundH);
-				pMotor = new Actuator(Actuator::kMotor);
-                pMotor->SetInput(pLightSensor);
-				pVehicle->AddSensor(pLightSensor);
-				pVehicle->AddActuator(pMotor);
-			}
-			break;
-
-		// light activated or light seeking with a transfer function
-		case 1:
-		case 2:
-		case 3:
-		case 5:
-		case 6:
-		case 7:
-			{
-				pVehicle->AllocBrain(2, 1);
-				pLightSensor = new LightSensor(directional, mMaxBoundH);
-				Function* pFunc = new Function(funcs[(brainType-1) & 3]);
-                pFunc->AddInput(pLightSensor);
-
-				pMotor = new Actuator(Actuator::kMotor);
-                pMotor->SetInput(pFunc);
-
-				pVehicle->AddSensor(pFunc);
-				pVehicle->AddSensor(pLightSensor);
-				pVehicle->AddActuator(pMotor);
-			}
-			break;
-
-		// light seeking, with collision avoidance
-		case 8:
-			{
-				pVehicle->AllocBrain(3, 1);
-				pLightSensor = new LightSensor(true, mMaxBoundH);		// directional light sensor
-				pCollisionSensor = new CollisionSensor(mMaxBoundH * 0.1f);
-				Switch* pSwitch = new Switch();
-					pSwitch->SetControl(pCollisionSensor);
-					pSwitch->SetInputs(pLightSensor, pCollisionSensor);
-
-				pMotor = new Actuator(Actuator::kMotor);
-					pMotor->SetInput(pSwitch);
-
-				pVehicle->AddSensor(pCollisionSensor);
-				pVehicle->AddSensor(pSwitch);
-				pVehicle->AddSensor(pLightSensor);
-				pVehicle->AddActuator(pMotor);
-			}
-			break;
-	}
+void Demo::SetWindowSize(int width, int height, bool fullScreen) {
+	//VOpenGLMain::SetWindowSize(width, height, fullScreen);				// mRight and mTop will get set
+	SetBounds((float) width, (float) height);
 }
 
-
 static void DrawDart(PMath::Vec2f p, float scale, float rotation, Color c) {
     Vector2 v[4] = { { 0.0f, 0.75f}, {-0.5f, -0.75f}, {0, -0.35f}, {0.5f, -0.75f} };
 
@@ -139,239 +78,12 @@ void Demo::DrawFilledCircle(PMath::Vec2f p, float r, Color c) {
     ::DrawCircle(p[0], p[1], r, c);
 }
 
-void Demo::ClearAll() {
-	RemoveAllProxies();
-	m_Engine.RemoveAllEntities();
-	m_AICount = 0;
-}
-
-void Demo::CreateDemoZero_Zero() {
-    m_DemoName = "Light Sensitive - linear response";
-    ClearAll();
-    DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-    m_State[m_AICount].m_Kind = kLight;
-    m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-    m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-    DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-    m_State[m_AICount].m_Kind = kVehicle;
-    m_State[m_AICount].m_Vehicle = pVehicle;
-    m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-    BuildTestBrain(pVehicle, 0);
-    pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-    m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
 void Demo::CreateDefaultDemo() {
 	//CreateDemoZero_Zero();
     //CreateDemoZero_One();
     //CreateDemoTwo();
     CreateDemoThree();
-}
-
-void Demo::CreateDemoZero_One() {
-	m_DemoName = "Light Sensitive with Buffer - delayed response";
-
-    ClearAll();
-    DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-    m_State[m_AICount].m_Kind = kLight;
-    m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-    m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-    DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-    m_State[m_AICount].m_Vehicle = pVehicle;
-    m_State[m_AICount].m_Kind = kVehicle;
-    m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-    BuildTestBrain(pVehicle, 1);
-    pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-    m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateDemoZero_Two() {
-	m_DemoName = "Light Sensitive with Inverter";
-	ClearAll();
-	DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-		m_State[m_AICount].m_Kind = kLight;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-		m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-	DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 2);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateDemoZero_Three() {
-	m_DemoName = "Light Sensitive with Threshold";
-	ClearAll();
-	DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-		m_State[m_AICount].m_Kind = kLight;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-		m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-	DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 3);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateDemoOne() {
-	m_DemoName = "Light Sensitive Comparison";
-	ClearAll();
-	DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-		m_State[m_AICount].m_Kind = kLight;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-		m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-	DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 0);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-	pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 1);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-	pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 2);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-	pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 3);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateDemoTwo_Zero() {
-	m_DemoName = "Light Seeking - linear response";
-	ClearAll();
-	DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-		m_State[m_AICount].m_Kind = kLight;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-		m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-	DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 4);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateDemoTwo() {
-	m_DemoName = "Light Seeking Comparison";
-	ClearAll();
-	DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-		m_State[m_AICount].m_Kind = kLight;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = 0.5f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = 0.5f * mMaxBoundV;
-		m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-	DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 4);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-	pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 5);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-	pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 6);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-	pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-		m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		BuildTestBrain(pVehicle, 7);
-		pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-		m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateLightSeekingAvoider() {
-	DemoVehicle* pVehicle = new DemoVehicle(&m_State[m_AICount]);;
-		m_State[m_AICount].m_Vehicle = pVehicle;
-	m_State[m_AICount].m_Kind = kVehicle;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-	BuildTestBrain(pVehicle, 8);
-	pVehicle->mMaxSpeed = randf(0.8f, 1.0f);
-	m_AI[m_AICount++] = m_Engine.AddEntity(pVehicle);
-}
-
-void Demo::CreateDemoThree() {
-	m_DemoName = "Light Seeking with Collision Avoidance";
-	ClearAll();
-	DemoLight* pLight = new DemoLight(&m_State[m_AICount]);
-		m_State[m_AICount].m_Kind = kLight;
-		m_State[m_AICount].m_Rotation = k0;
-    m_State[m_AICount].m_Position[0] = (0.8f * randf() * mMaxBoundH) + 0.1f * mMaxBoundH;
-    m_State[m_AICount].m_Position[1] = (0.8f * randf() * mMaxBoundV) + 0.1f * mMaxBoundV;
-		m_AI[m_AICount++] = m_Engine.AddEntity(pLight);
-
-	for (int i = 0; i < 2; ++i) {
-		CreateLightSeekingAvoider();
-	}
+	mCurrentDemo = 7;
 }
 
 void Demo::Reset() {
@@ -379,11 +91,11 @@ void Demo::Reset() {
 	mDemoMode = kNone;
 	mPotentialPick = -1;
 	mCurrentPick = -1;
+	mInspectingPick = -1;
 }
 
 bool Demo::HandleKey(int key) {
 	bool handled = false;
-	int i;
 
    	switch (key) {
 		case (int) ' ':
@@ -404,7 +116,10 @@ bool Demo::HandleKey(int key) {
 				case 7:		CreateDemoThree();			break;
 			}
 
-			AddAllProxies();
+			// a new scenario can't be derived from the inputs recorded so far, so record it whole
+			if (m_pRecorder) {
+				m_pRecorder->RecordSnapshot(*this);
+			}
 			break;
 
 		case (int) 'h':
@@ -415,15 +130,7 @@ bool Demo::HandleKey(int key) {
 		case (int) '=':
 			// double the number of entities each time
 			if (mCurrentDemo == 7) {
-				int count = m_Engine.GetEntityCount() - 1; // subtract 1 for the sun
-				if (count < 100) {
-					for (i = 0; i < count; ++i) {
-						CreateLightSeekingAvoider();
-					}
-
-					RemoveAllProxies();
-					AddAllProxies();
-				}
+				SpawnVehicles(8, GetEntityCount() - (int) m_Lights.size());
 			}
 			break;
 	}
@@ -431,12 +138,11 @@ bool Demo::HandleKey(int key) {
 }
 
 void Demo::DragEntity(int id) {
-	PMath::Vec3f pos;
-    pos[0] = mMousex;
-    pos[1] = mMousey;
+	if (id < 0 || id >= GetEntityCount())
+		return;
+
 	//ConvertWindowCoordsToOrthoGL(mMousex, mMousey, pos[0], pos[1]);
-	pos[2] = k0;
-	PMath::Vec3fSet(m_State[id].m_Position, pos);
+	PlaceEntity(id, mMousex, mMousey);
 }
 
 void Demo::ChoosePotentialPick() {
@@ -480,50 +186,13 @@ void Demo::MouseUnclick(eMouseButton button) {
 	}
 }
 
-void Demo::WrapAround(float left, float right, float bottom, float top) {
-	for (int i = 0; i < m_AICount; ++i) {
-		PhysState* pState = &m_State[i];
-
-		if (pState->m_Position[0] > right)			pState->m_Position[0] = left;
-		else if (pState->m_Position[0] < left)		pState->m_Position[0] = right;
-		if (pState->m_Position[1] > top)			pState->m_Position[1] = bottom;
-		else if (pState->m_Position[1] < bottom)	pState->m_Position[1] = top;
-	}
-}
-
-void Demo::AddAllProxies() {
-	if (m_pNN) {
-		for (int i = 0; i < m_AICount; ++i) {
-			m_pNN->AddProxy(&m_State[i]);
-		}
-	}
-}
-
-void Demo::RemoveAllProxies() {
-	if (m_pNN) {
-		for (int i = 0; i < m_AICount; ++i) {
-				m_pNN->RemoveProxy(&m_State[i]);
-		}
-	}
-}
-
-void Demo::SetWindowSize(int width, int height, bool fullScreen) {
-	//VOpenGLMain::SetWindowSize(width, height, fullScreen);				// mRight and mTop will get set
-	PMath::Vec3f origin;
-	origin[0] = origin[1] = origin[2] = k0;
-	PMath::Vec3f dimensions;
-	dimensions[0] = dimensions[1] = dimensions[2] = 2.5f;
-
-	RemoveAllProxies();
-	delete m_pNN;
-	m_pNN = new NearestNeighbours(origin, dimensions, 10, 10, 10);
-	AddAllProxies();
-}
-
 
 void Demo::Update(float dt) {
-	RenderEntities();
-	DrawUserPrompts(m_DemoName, "click to drag", (mCurrentDemo != 7) ? "keys: h, space" : "keys: h, space, =");
+	{
+		INSECTAI_PROFILE_SCOPE("RenderEntities");
+		RenderEntities();
+	}
+	DrawUserPrompts(m_Name, "click to drag", (mCurrentDemo != 7) ? "keys: h, space" : "keys: h, space, =");
 
 	ChoosePotentialPick();
 
@@ -535,6 +204,10 @@ void Demo::Update(float dt) {
 		HighlightEntity(mCurrentPick, 1.1f, 0.7f, 0.7f, 0.7f);		// highlighted object
 	}
 
+	if (mInspectingPick >= GetEntityCount()) {
+		mInspectingPick = -1;
+	}
+
     DrawRectangleLines(mMaxBoundH - 200, 20, 180, 240, GREEN);
     if (mCurrentPick >= 0) {
         mInspectingPick = mCurrentPick;
@@ -589,11 +262,7 @@ void Demo::Update(float dt) {
         }
     }
     
-	m_Engine.UpdateEntities(dt, this);
-
-	MoveEntities();
-
-	WrapAround(0.0f, mMaxBoundH, 0.0f, mMaxBoundV);
+	Step(dt);
 }
 
 static void RenderCollisionSensor(CollisionSensor* pSensor, PMath::Vec2f pos, float scale) {
@@ -874,7 +543,7 @@ void Demo::RenderLight(PhysState const*const pState) {
 
 void Demo::RenderEntities()
 {
-	for (int i = 0; i < m_AICount; ++i) {
+	for (int i = 0; i < GetEntityCount(); ++i) {
 		// render agent here
 		if (m_State[i].m_Kind == kVehicle) {
 			RenderVehicle(m_State[i].m_Vehicle, &m_State[i]);
@@ -887,115 +556,11 @@ void Demo::RenderEntities()
 
 void Demo::HighlightEntity(int id, float radius, float red, float green, float blue)
 {
-	radius *= 0.02f;
-	Demo::DrawCircle(m_State[id].m_Position, radius, WHITE);
-}
-
-static void MoveVehicle(DemoVehicle* pVehicle, PhysState* pState)
-{
-    const float kSteeringSpeed = 0.0025f;
-
-	// connect actuators to physics
-	for (int i = 0; i < pVehicle->GetActuatorCount(); ++i) {
-		Actuator* pActuator = pVehicle->GetActuator(i);
-		switch (pActuator->GetKind()) {
-			case Actuator::kMotor:
-				pState->m_Rotation += kSteeringSpeed * pActuator->mSteeringActivation;
-				//mRotation = 0.25f * kPi;
-				if (pState->m_Rotation < 0.0f) pState->m_Rotation += 2.0f * kPi;
-				else if (pState->m_Rotation > 2.0f * kPi) pState->m_Rotation -= 2.0f * kPi;
-
-                const float forceScale = 1.f; // @TODO make this physical
-				float activation = forceScale * pActuator->mActivation;
-                // rotation of zero moves forward on y axis
-				pState->m_Position[0] += pVehicle->mMaxSpeed * sinf(pState->m_Rotation) * activation;
-				pState->m_Position[1] += pVehicle->mMaxSpeed * cosf(pState->m_Rotation) * activation;
-				break;
-		}
-	}
-}
-
-void Demo::MoveEntities()
-{
-	for (int i = 0; i < m_AICount; ++i) {
-		// render agent here
-		if (m_State[i].m_Kind == kVehicle) {
-			MoveVehicle(m_State[i].m_Vehicle, &m_State[i]);
-			m_pNN->UpdateProxy(&m_State[i]);
-		}
-	}
-}
-
-int Demo::FindClosestEntity(float x, float y, float maxDistance)
-{
-	int best = -1;
-
-	maxDistance *= maxDistance;
-	float bestDistance = 1.0e7f;
-
-	for (int i = 0; i < m_AICount; ++i) {
-		float distSquared = m_State[i].DistanceSquared(x, y);
-
-		if (distSquared < bestDistance && distSquared < maxDistance) {
-			best = i;
-			bestDistance = distSquared;
-		}
-	}
-
-	return best;
-}
-
-
-InsectAI::DynamicState* Demo::GetNearest(InsectAI::Entity* pE, uint32 filter)
-{
-    InsectAI::DynamicState* pRetVal = 0;
-    if (filter != 0) {
-        Real nearest = 1.0e6f;
-        Real radius;
-
-        PhysState* pState = (PhysState*) pE->GetDynamicState();
-
-        // if it's a light, simply search the entire database for the closest light
-        // (lq is not that fast when the search radius is similar to the size of the database)
-        if ((filter & kLight) != 0) {
-            for (int i = 0; i < m_AICount; ++i) {
-                if ((m_State[i].m_Kind & filter) != 0) {
-                    if (m_State[i].m_Vehicle != pE) {
-                        Real distSquared = pState->DistanceSquared(&m_State[i]);
-                        if (distSquared < nearest) {
-                            nearest = distSquared;
-                            pRetVal = &m_State[i];
-                        }
-                    }
-                }
-            }
-        }
-        else {
-            if (!m_pNN) {
-                fprintf(stderr, "nearest neighbour object not initialized\n");
-                exit(EXIT_FAILURE);
-            }
-            radius = 150;//0.15f;    // this should really account for 2 * maximum velocity of a bug
-            PhysState* pNearest = (PhysState*) m_pNN->FindNearestNeighbour(pState->GetPosition(), radius, filter, pState);
-            return pNearest;
-
-            // brute force search for comparison
-            for (int i = 0; i < m_AICount; ++i) {
-                if ((m_State[i].m_Kind & filter) != 0) {
-                    if (m_State[i].m_Vehicle != pE) {
-                        Real distSquared = pState->DistanceSquared(&m_State[i]);
-                        if (distSquared < nearest) {
-                            nearest = distSquared;
-                            pRetVal = &m_State[i];
-                        }
-                    }
-                }
-            }
-            return pNearest;
-        }
+	if (id < 0 || id >= GetEntityCount())
+		return;
 
-    }
-    return pRetVal;
+	radius *= 0.02f;
+	Demo::DrawCircle(GetEntityState(id).m_Position, radius, WHITE);
 }
 
 
@@ -1025,13 +590,33 @@ int main(int argc, char **argv)
 	int height = screenHeight;
 
 	Demo* pDemo = new Demo();
-    pDemo->mMaxBoundH = width;
-    pDemo->mMaxBoundV = height;
+    pDemo->SetWindowSize(width, height, false);
+	pDemo->SetSortInterval(World::kDefaultSortInterval);
+	pDemo->SetNeighbourListSkin(World::kDefaultNeighbourListSkin);
 	pDemo->Reset();
-    pDemo->m_pNN = new NearestNeighbours((PMath::Vec3f) {0,0,0},
-                                         (PMath::Vec3f) {(float)width, (float)height, 0},
-                                          10, 10, 10);
     pDemo->CreateDefaultDemo();
+
+	// --trace <json> writes a Chrome trace of the session on exit, if profiling was compiled in
+	const char* pTracePath = 0;
+	for (int arg = 1; arg + 1 < argc; ++arg) {
+		if (!strcmp(argv[arg], "--trace")) {
+			pTracePath = argv[arg + 1];
+		}
+	}
+
+	// --record <log> streams the session's inputs to a log that insect-ai-headless can replay
+	ReplayRecorder recorder;
+	for (int arg = 1; arg + 1 < argc; ++arg) {
+		if (!strcmp(argv[arg], "--record")) {
+			if (recorder.Open(argv[arg + 1])) {
+				pDemo->SetRecorder(&recorder);
+				fprintf(stdout, "Recording to %s\n", argv[arg + 1]);
+			}
+			else {
+				fprintf(stderr, "could not record to %s\n", argv[arg + 1]);
+			}
+		}
+	}
     
     bool mouseDown = false;
 
@@ -1072,5 +657,15 @@ int main(int argc, char **argv)
 
         EndDrawing();
 	}
+
+	pDemo->SetRecorder(0);
+	recorder.Close();
+
+	if (pTracePath) {
+		if (!Profiler::IsEnabled())
+			fprintf(stderr, "built without INSECTAI_PROFILE, no trace was recorded\n");
+		else if (Profiler::WriteChromeTrace(pTracePath))
+			Profiler::WriteHistograms(stdout);
+	}
 	return EXIT_SUCCESS;
 }
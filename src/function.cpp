@@ -3,7 +3,7 @@
 
 namespace InsectAI {
 
-	Function::Function(uint32 func) : Sensor(), mFunction(func) {
+	Function::Function(uint32 func) : Sensor(), mFunction(func), mSlope(24.0f), mRate(4.0f) {
 		m_Kind = GetStaticKind();
 		m_SensedAgent = 0;
 		mbClearEachFrame = false;
@@ -16,7 +16,7 @@ namespace InsectAI {
 
 void Function::Update(float dt) {
 	int count = (int) mInputs.size();
-	if (count >= 0) {
+	if (count > 0) {
 		float input = mInputs[0]->mActivation;
 		float steeringInput = mInputs[0]->mSteeringActivation;
 
@@ -24,7 +24,7 @@ void Function::Update(float dt) {
 			case kSigmoid:
 				if (input <= 0.0f) mActivation = 0.0f;
 				else if (input >= 1.0f) mActivation = 1.0f;
-				else mActivation = (1.0f / (1.0f + expf(-(input-0.5f)*24.0f)));	// 24 controls the speed of the slope. -0.5f shifts the range to be centered about 0.5 instead of 0
+				else mActivation = (1.0f / (1.0f + expf(-(input-0.5f)*mSlope)));	// the slope, 24 by default, controls the speed of the step. -0.5f shifts the range to be centered about 0.5 instead of 0
 				break;
 
 			case kInvert:
@@ -33,7 +33,7 @@ void Function::Update(float dt) {
 
 			case kBuffer:
 			default:
-				mActivation = mActivation + (input - mActivation) * 4.0f * dt;	// hysteresis of 0.25 seconds
+				mActivation = mActivation + (input - mActivation) * mRate * dt;	// hysteresis of 1/rate seconds, 0.25 by default
 				break;
 		}
 
@@ -46,6 +46,24 @@ void Function::Update(float dt) {
 }
 
 
+bool Function::InputsChanged() const {
+	for (size_t i = 0; i < mInputs.size(); ++i) {
+		if (mInputs[i]->mbChanged)
+			return true;
+	}
+	return false;
+}
+
+bool Function::IsSettled(float epsilon, float dt) const {
+	// anything but an inverter or a sigmoid buffers, as Update does
+	if (mFunction == kInvert || mFunction == kSigmoid || mInputs.empty())
+		return true;
+
+	// a buffer whose step has rounded away never reaches its input, but won't move again
+	float input = mInputs[0]->mActivation;
+	return fabsf(input - mActivation) <= epsilon || mActivation + (input - mActivation) * mRate * dt == mActivation;
+}
+
 Switch::Switch() : mpA(0), mpB(0), mpSwitch(0) {
 		m_Kind = GetStaticKind();
 		m_SensedAgent = 0;
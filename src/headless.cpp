@@ -0,0 +1,1925 @@
+
+/** @file	headless.cpp
+	@brief	Runs InsectAI simulations without a window, for batch runs and benchmarks
+	*/
+
+#include "PMath.h"
+#include "InsectAI.h"
+#include "InsectAI_StaticBrain.h"
+#include "World.h"
+#include "Batch.h"
+#include "BrainDescription.h"
+#include "Evolution.h"
+#include "Profiler.h"
+#include "Replay.h"
+#include "Snapshot.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static double Seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Population scaling report. Worlds of 1k, 10k, ... up to maxCount light seeking avoiders
+/// are built at the density of the interactive demo, and the time per tick spent in each
+/// stage of World::Step is printed, so it can be seen which stage stops scaling first.
+static int RunScalingReport(int maxCount)
+{
+	const float dt = 1.0f / 60.0f;
+
+	fprintf(stdout, "%9s %6s %10s %9s %9s %9s %9s %9s %10s %9s\n",
+			"agents", "ticks", "spawn ms", "clear ms", "sense ms", "brain ms", "move ms", "wrap ms", "tick ms", "us/agent");
+
+	for (int count = 1000; count <= maxCount; count *= 10) {
+		// grow the world with the population so that each agent has as many neighbours as in the demo
+		float scale = sqrtf((float) count / 1000.0f);
+
+		double start = Seconds();
+		World* pWorld = new World();
+		pWorld->SetBounds(1000.0f * scale, 600.0f * scale);
+		pWorld->CreatePopulationScaling(count);
+		double spawn = Seconds() - start;
+
+		pWorld->Step(dt);		// first tick settles the brains, don't count it
+
+		int ticks = PMath::Clamp(100000 / count, 5, 100);
+		StepTimes times;
+		for (int i = 0; i < ticks; ++i) {
+			pWorld->Step(dt, &times);
+		}
+
+		double ms = 1000.0 / ticks;
+		double total = times.clearSenses + times.sense + times.update + times.move + times.wrap;
+		fprintf(stdout, "%9d %6d %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f %10.3f %9.3f\n",
+				count, ticks, spawn * 1000.0,
+				times.clearSenses * ms, times.sense * ms, times.update * ms, times.move * ms, times.wrap * ms,
+				total * ms, total * ms * 1000.0 / count);
+		fflush(stdout);
+
+		delete pWorld;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Sweep the test brains over many short, independent worlds and report the throughput
+static int RunBatch(int worlds, int threads, const char* pPath)
+{
+	BatchRunner runner(threads);
+	for (int i = 0; i < worlds; ++i) {
+		BatchExperiment experiment;
+		experiment.brainType = (uint32) (i % 9);
+		experiment.seed = (uint32) (i / 9 + 1);
+		runner.Add(experiment);
+	}
+
+	double seconds = runner.Run();
+
+	const std::vector<BatchResult>& results = runner.GetResults();
+	int reached = 0;
+	long long ticks = 0;
+	for (size_t i = 0; i < results.size(); ++i) {
+		ticks += results[i].experiment.ticks;
+		if (results[i].reached > 0)
+			++reached;
+	}
+
+	fprintf(stdout, "%d worlds on %d threads in %.3f s: %.1f worlds/s, %.0f ticks/s; %d worlds reached the light\n",
+			worlds, runner.GetThreadCount(), seconds, worlds / seconds, ticks / seconds, reached);
+
+	if (pPath) {
+		if (!runner.WriteCSV(pPath)) {
+			fprintf(stderr, "could not write %s\n", pPath);
+			return EXIT_FAILURE;
+		}
+		fprintf(stdout, "results written to %s\n", pPath);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Checkpoint a world, restore it from the mapped file, and check the copy evolves identically.
+/// Also compares the cost of restoring against building the same population from scratch.
+static int RunSnapshotCheck(int count, const char* pPath)
+{
+	const float dt = 1.0f / 60.0f;
+	float scale = sqrtf((float) count / 1000.0f);
+
+	double start = Seconds();
+	World original;
+	original.Seed(1);
+	original.SetBounds(1000.0f * scale, 600.0f * scale);
+	original.CreatePopulation(8, count);
+	double build = Seconds() - start;
+
+	// sorted storage is part of the state, as it decides the order of the sensors' noise
+	original.SetSortInterval(World::kDefaultSortInterval);
+	original.SortEntities();
+
+	for (int i = 0; i < 60; ++i) {
+		original.Step(dt);
+	}
+
+	Snapshot snapshot;
+	start = Seconds();
+	snapshot.Capture(original);
+	double capture = Seconds() - start;
+
+	start = Seconds();
+	bool written = snapshot.Write(pPath);
+	double write = Seconds() - start;
+	if (!written) {
+		fprintf(stderr, "could not write %s\n", pPath);
+		return EXIT_FAILURE;
+	}
+
+	Snapshot mapped;
+	start = Seconds();
+	bool ok = mapped.Map(pPath);
+	double map = Seconds() - start;
+	if (!ok) {
+		fprintf(stderr, "could not map %s\n", pPath);
+		return EXIT_FAILURE;
+	}
+
+	World copy;
+	start = Seconds();
+	ok = mapped.Restore(copy);
+	double restore = Seconds() - start;
+	if (!ok) {
+		fprintf(stderr, "%s is not a valid snapshot\n", pPath);
+		return EXIT_FAILURE;
+	}
+
+	// the original and the restored copy must now march in lock step
+	const int ticks = 120;
+	int diverged = -1;
+	for (int tick = 1; tick <= ticks && diverged < 0; ++tick) {
+		original.Step(dt);
+		copy.Step(dt);
+		for (int i = 0; i < original.GetEntityCount(); ++i) {
+			PhysState const& a = original.GetEntityState(i);
+			PhysState const& b = copy.GetEntityState(i);
+			if (a.m_Position[0] != b.m_Position[0] || a.m_Position[1] != b.m_Position[1] || a.m_Rotation != b.m_Rotation) {
+				diverged = tick;
+				break;
+			}
+		}
+	}
+
+	fprintf(stdout, "%d entities, %.1f KB snapshot\n", original.GetEntityCount(), snapshot.GetSize() / 1024.0);
+	fprintf(stdout, "build %.3f ms, capture %.3f ms, write %.3f ms, map %.3f ms, restore %.3f ms\n",
+			build * 1000.0, capture * 1000.0, write * 1000.0, map * 1000.0, restore * 1000.0);
+	if (diverged >= 0) {
+		fprintf(stdout, "restored world diverged at tick %d\n", diverged);
+		return EXIT_FAILURE;
+	}
+	fprintf(stdout, "restored world matched the original for %d ticks\n", ticks);
+	return EXIT_SUCCESS;
+}
+
+/// Record a scripted session, the way the demo records a user: the population grows now and
+/// then, and the light is dragged around, so that every kind of input ends up in the log
+static int RunRecord(const char* pPath, int count, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+
+	World world;
+	world.Seed(1);
+	world.SetBounds(1000.0f, 600.0f);
+	world.CreatePopulation(8, count);
+	world.SetSortInterval(World::kDefaultSortInterval);
+
+	ReplayRecorder recorder;
+	if (!recorder.Open(pPath)) {
+		fprintf(stderr, "could not write %s\n", pPath);
+		return EXIT_FAILURE;
+	}
+	world.SetRecorder(&recorder);
+
+	double start = Seconds();
+	for (int tick = 0; tick < ticks; ++tick) {
+		if (tick % 600 == 300) {
+			world.SpawnVehicles(8, count / 4 + 1);
+		}
+		if (tick % 120 < 30) {
+			float angle = tick * 0.05f;
+			world.PlaceEntity(world.GetLight(0), 500.0f + 200.0f * cosf(angle), 300.0f + 200.0f * sinf(angle));
+		}
+		world.Step(dt);
+	}
+	double seconds = Seconds() - start;
+
+	world.SetRecorder(0);
+	if (!recorder.Close()) {
+		fprintf(stderr, "writing %s failed\n", pPath);
+		return EXIT_FAILURE;
+	}
+	fprintf(stdout, "recorded %d ticks of %d entities to %s in %.3f s\n", ticks, world.GetEntityCount(), pPath, seconds);
+	return EXIT_SUCCESS;
+}
+
+/// Replay a log from the demo or the record command, and report where it diverged, if it did
+static int RunReplay(const char* pPath)
+{
+	ReplayResult result = Replay(pPath);
+	fprintf(stdout, "replayed %d ticks in %.3f s, %d checksums compared\n", result.steps, result.seconds, result.checksums);
+	if (!result.ok) {
+		fprintf(stderr, "%s is not a complete replay log\n", pPath);
+		return EXIT_FAILURE;
+	}
+	if (result.divergedTick >= 0) {
+		fprintf(stdout, "diverged from the recording by tick %d\n", result.divergedTick);
+		return EXIT_FAILURE;
+	}
+	fprintf(stdout, "matched the recording\n");
+	return EXIT_SUCCESS;
+}
+
+/// Step a population with the profiler recording, then write a Chrome trace and print
+/// a histogram of each phase
+static int RunProfile(int count, int ticks, const char* pPath)
+{
+	if (!Profiler::IsEnabled()) {
+		fprintf(stderr, "built without INSECTAI_PROFILE; configure with -DINSECTAI_PROFILE=ON\n");
+		return EXIT_FAILURE;
+	}
+
+	const float dt = 1.0f / 60.0f;
+	float scale = sqrtf((float) count / 1000.0f);
+
+	World world;
+	world.SetBounds(1000.0f * scale, 600.0f * scale);
+	world.CreatePopulationScaling(count);
+
+	Profiler::Reset();
+	for (int i = 0; i < ticks; ++i) {
+		world.Step(dt);
+	}
+
+	Profiler::WriteHistograms(stdout);
+	if (!Profiler::WriteChromeTrace(pPath)) {
+		fprintf(stderr, "could not write %s\n", pPath);
+		return EXIT_FAILURE;
+	}
+	fprintf(stdout, "trace written to %s\n", pPath);
+	return EXIT_SUCCESS;
+}
+
+/// Step a population and report what the spatial database does per tick: how many bins and
+/// proxies each query touches, how often proxies change bins, and how full the bins are
+static int RunGridStats(int count, int ticks)
+{
+	if (!NNStats::IsEnabled()) {
+		fprintf(stderr, "built without INSECTAI_LQ_STATS; configure with -DINSECTAI_LQ_STATS=ON\n");
+		return EXIT_FAILURE;
+	}
+
+	const float dt = 1.0f / 60.0f;
+	float scale = sqrtf((float) count / 1000.0f);
+
+	World world;
+	world.SetBounds(1000.0f * scale, 600.0f * scale);
+	world.CreatePopulationScaling(count);
+	world.Step(dt);
+
+	lqStats total;
+	memset(&total, 0, sizeof(total));
+	unsigned long long nearestQueries = 0, nearestFound = 0;
+	for (int i = 0; i < ticks; ++i) {
+		world.m_pNN->ResetStats();
+		world.Step(dt);
+
+		NNStats stats;
+		world.m_pNN->GetStats(stats);
+		total.queries += stats.lq.queries;
+		total.binsVisited += stats.lq.binsVisited;
+		total.proxiesTested += stats.lq.proxiesTested;
+		total.callbacks += stats.lq.callbacks;
+		total.otherVisits += stats.lq.otherVisits;
+		total.otherTested += stats.lq.otherTested;
+		total.updates += stats.lq.updates;
+		total.rebins += stats.lq.rebins;
+		nearestQueries += stats.nearestQueries;
+		nearestFound += stats.nearestFound;
+	}
+
+	double queries = total.queries > 0 ? (double) total.queries : 1.0;
+	double updates = total.updates > 0 ? (double) total.updates : 1.0;
+	fprintf(stdout, "%d agents, %d ticks\n", count, ticks);
+	fprintf(stdout, "per tick:  %.0f queries, %.0f proxy tests, %.0f updates, %.0f rebins\n",
+			total.queries / (double) ticks, total.proxiesTested / (double) ticks,
+			total.updates / (double) ticks, total.rebins / (double) ticks);
+	fprintf(stdout, "per query: %.2f bins, %.1f proxies tested, %.1f within radius, %.1f%% touched other (%.1f tests)\n",
+			total.binsVisited / queries, total.proxiesTested / queries, total.callbacks / queries,
+			100.0 * total.otherVisits / queries, total.otherTested / queries);
+	fprintf(stdout, "nearest:   %.1f%% of %llu queries found a neighbour; %.2f%% of updates rebinned\n",
+			nearestQueries ? 100.0 * nearestFound / nearestQueries : 0.0, nearestQueries, 100.0 * total.rebins / updates);
+
+	NNStats stats;
+	world.m_pNN->GetStats(stats);
+	fprintf(stdout, "bins:      %d, %d empty, at most %d proxies, %d in other\n",
+			stats.bins, stats.emptyBins, stats.maxOccupancy, stats.otherOccupancy);
+	for (int b = 0; b < NNStats::kOccupancyBuckets; ++b) {
+		if (stats.occupancy[b] > 0) {
+			fprintf(stdout, "  %6d-%-6d proxies: %d bins\n", 1 << b, (2 << b) - 1, stats.occupancy[b]);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Mean wall clock seconds per step over a few steps
+static double TimeSteps(World& world, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+	double start = Seconds();
+	for (int i = 0; i < ticks; ++i) {
+		world.Step(dt);
+	}
+	return (Seconds() - start) / ticks;
+}
+
+/// Grow one world from 10 agents to maxCount, and at each size compare the step time of the
+/// default grid, the best of a sweep of fixed cell sizes, and the cell size the adaptive grid
+/// settles on after running at that size for a tuning interval
+static int RunGridTuning(int maxCount)
+{
+	const float width = 10000.0f;
+	const float height = 6000.0f;
+
+	World world;
+	world.Seed(1);
+	world.SetBounds(width, height);
+	world.CreatePopulation(8, 10);
+
+	fprintf(stdout, "%8s | %8s %10s | %8s %10s | %8s %10s %7s\n",
+			"agents", "default", "ms", "best", "ms", "adaptive", "ms", "ratio");
+
+	for (int count = 10; count <= maxCount; count *= 10) {
+		int vehicles = world.GetEntityCount() - world.GetLightCount();
+		world.SpawnVehicles(8, count - vehicles);
+		int ticks = PMath::Clamp(200000 / count, 2, 200);
+
+		// let the adaptive grid react to the new population, starting from wherever it was
+		world.SetAdaptiveGrid(true);
+		TimeSteps(world, World::kGridTuneInterval);
+		world.SetAdaptiveGrid(false);
+		float adaptiveCell = world.GetGridCellSize();
+		double adaptive = TimeSteps(world, ticks);
+
+		world.SetGridCellSize(World::kCollisionQueryRadius);
+		double fixed = TimeSteps(world, ticks);
+
+		// the cost is unimodal in the cell size, so stop the sweep once it is well past the best
+		float bestCell = 0;
+		double best = 1.0e30;
+		for (float cell = World::kCollisionQueryRadius / 8.0f; cell < 2.0f * width; cell *= 2.0f) {
+			world.SetGridCellSize(cell);
+			double t = TimeSteps(world, ticks);
+			if (t < best) {
+				best = t;
+				bestCell = cell;
+			}
+			else if (t > 4.0 * best) {
+				break;
+			}
+		}
+		world.SetGridCellSize(adaptiveCell);
+
+		fprintf(stdout, "%8d | %8.1f %10.3f | %8.1f %10.3f | %8.1f %10.3f %7.2f\n",
+				count, World::kCollisionQueryRadius, fixed * 1000.0, bestCell, best * 1000.0,
+				adaptiveCell, adaptive * 1000.0, adaptive / best);
+		fflush(stdout);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Compare nearest light queries on the static index against a scan of every light, checking
+/// that both find the same light, for worlds of 1 to maxLights lights
+static int RunLightIndex(int maxLights)
+{
+	const float width = 10000.0f;
+	const float height = 6000.0f;
+	const int queries = 100000;
+
+	fprintf(stdout, "%8s %12s %12s %9s\n", "lights", "index ns", "scan ns", "speedup");
+
+	uint32 randomState = PMath::RandomSeed(7);
+	PMath::RandomScope random(randomState);
+	for (int count = 1; count <= maxLights; count *= 10) {
+		World world;
+		world.SetBounds(width, height);
+		for (int i = 0; i < count; ++i) {
+			world.CreateLight(PMath::randf() * width, PMath::randf() * height);
+		}
+
+		std::vector<float> points(2 * queries);
+		for (int i = 0; i < 2 * queries; i += 2) {
+			points[i] = PMath::randf() * width;
+			points[i + 1] = PMath::randf() * height;
+		}
+
+		world.FindNearestLight(0, 0);		// builds the index
+		std::vector<int> found(queries);
+		double start = Seconds();
+		for (int i = 0; i < queries; ++i) {
+			found[i] = world.FindNearestLight(points[2 * i], points[2 * i + 1]);
+		}
+		double index = Seconds() - start;
+
+		int mismatches = 0;
+		start = Seconds();
+		for (int i = 0; i < queries; ++i) {
+			float nearest = 1.0e6f;
+			int best = -1;
+			for (int l = 0; l < world.GetLightCount(); ++l) {
+				float distanceSquared = world.GetEntityState(world.GetLight(l)).DistanceSquared(points[2 * i], points[2 * i + 1]);
+				if (distanceSquared < nearest) {
+					nearest = distanceSquared;
+					best = world.GetLight(l);
+				}
+			}
+			if (best != found[i]) {
+				++mismatches;
+			}
+		}
+		double scan = Seconds() - start;
+
+		fprintf(stdout, "%8d %12.1f %12.1f %9.1f\n", count, index * 1.0e9 / queries, scan * 1.0e9 / queries, scan / index);
+		if (mismatches > 0) {
+			fprintf(stdout, "%d queries found a different light than the scan\n", mismatches);
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Mixed population spatial queries. A fixed number of vehicles shares the database with
+/// an increasing number of lights, and each vehicle looks for its nearest other vehicle, as
+/// the collision sensors do. The database with a lattice per kind is timed against one
+/// holding every kind, where each proxy in range has its mask tested.
+static int RunKindSegregation(int vehicles, int maxLights)
+{
+	// the density of the interactive demo, and a cell the size of the collision query
+	const float width = 10000.0f;
+	const float height = 6000.0f;
+	const float radius = World::kCollisionQueryRadius;
+	const int passes = 5;
+
+	PMath::Vec3f origin;
+	origin[0] = origin[1] = k0;
+	origin[2] = -kHalf;
+	PMath::Vec3f dimensions;
+	dimensions[0] = width;
+	dimensions[1] = height;
+	dimensions[2] = k1;
+	int divx = (int) ceilf(width / radius);
+	int divy = (int) ceilf(height / radius);
+
+	fprintf(stdout, "%8s %8s %14s %14s %9s\n", "vehicles", "lights", "segregated ns", "combined ns", "speedup");
+
+	uint32 randomState = PMath::RandomSeed(11);
+	PMath::RandomScope random(randomState);
+	for (int lights = 0; lights <= maxLights; lights = (lights == 0) ? PMath::Max(1, vehicles / 10) : lights * 10) {
+		std::vector<PhysState> states(vehicles + lights);
+		for (size_t i = 0; i < states.size(); ++i) {
+			states[i].m_Kind = ((int) i < vehicles) ? World::kVehicle : World::kLight;
+			states[i].m_Position[0] = PMath::randf() * width;
+			states[i].m_Position[1] = PMath::randf() * height;
+		}
+
+		double seconds[2];
+		std::vector<NNProxy*> found[2];
+		for (int mode = 0; mode < 2; ++mode) {
+			NearestNeighbours nn(origin, dimensions, divx, divy, 1, mode == 0);
+			for (size_t i = 0; i < states.size(); ++i) {
+				nn.AddProxy(&states[i]);
+			}
+
+			found[mode].resize(vehicles);
+			double start = Seconds();
+			for (int pass = 0; pass < passes; ++pass) {
+				for (int i = 0; i < vehicles; ++i) {
+					found[mode][i] = nn.FindNearestNeighbour(states[i].m_Position, radius, World::kVehicle, &states[i]);
+				}
+			}
+			seconds[mode] = Seconds() - start;
+
+			for (size_t i = 0; i < states.size(); ++i) {
+				nn.RemoveProxy(&states[i]);
+			}
+		}
+
+		int queries = passes * vehicles;
+		fprintf(stdout, "%8d %8d %14.1f %14.1f %9.2f\n", vehicles, lights,
+				seconds[0] * 1.0e9 / queries, seconds[1] * 1.0e9 / queries, seconds[1] / seconds[0]);
+		if (found[0] != found[1]) {
+			fprintf(stdout, "the segregated database found different neighbours\n");
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Spawn order against Z order storage. Two worlds of light seeking avoiders are built at the
+/// density of the interactive demo; one keeps its entities in spawn order, which is random in
+/// space, and the other sorts them every kDefaultSortInterval steps. The time per tick of the
+/// sense and move stages is compared, along with the cost of a sort.
+static int RunSortReport(int maxCount)
+{
+	const float dt = 1.0f / 60.0f;
+
+	fprintf(stdout, "%9s %6s %12s %12s %12s %12s %9s %9s\n",
+			"agents", "ticks", "sense ms", "sorted ms", "move ms", "sorted ms", "speedup", "sort ms");
+
+	for (int count = 10000; count <= maxCount; count *= 10) {
+		float scale = sqrtf((float) count / 1000.0f);
+		int ticks = PMath::Clamp(1000000 / count, 10, 100);
+
+		StepTimes times[2];
+		double sort = 0;
+		for (int sorted = 0; sorted < 2; ++sorted) {
+			World world;
+			world.Seed(1);
+			world.SetBounds(1000.0f * scale, 600.0f * scale);
+			world.CreatePopulationScaling(count);
+			if (sorted) {
+				world.SetSortInterval(World::kDefaultSortInterval);
+				double start = Seconds();
+				world.SortEntities();
+				sort = Seconds() - start;
+			}
+
+			world.Step(dt);		// first tick settles the brains, don't count it
+			for (int i = 0; i < ticks; ++i) {
+				world.Step(dt, &times[sorted]);
+			}
+		}
+
+		double ms = 1000.0 / ticks;
+		double before = times[0].sense + times[0].move;
+		double after = times[1].sense + times[1].move;
+		fprintf(stdout, "%9d %6d %12.3f %12.3f %12.3f %12.3f %9.2f %9.3f\n",
+				count, ticks, times[0].sense * ms, times[1].sense * ms, times[0].move * ms, times[1].move * ms,
+				before / after, sort * 1000.0);
+		fflush(stdout);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Bounded lattice against sparse hash when entities leave the lattice. Vehicles are spread
+/// at a constant density over a region 1, 2, 4 ... times the size of the lattice, centred on it,
+/// and a sample of them look for their nearest neighbour. Everything outside the lattice is in
+/// lq's "other" bin, which every query reaching outside scans.
+static int RunOpenWorld(int vehicles, int maxSpread)
+{
+	const float width = 10000.0f;
+	const float height = 6000.0f;
+	const float radius = World::kCollisionQueryRadius;
+	const int queries = 10000;
+
+	PMath::Vec3f origin;
+	origin[0] = origin[1] = k0;
+	origin[2] = -kHalf;
+	PMath::Vec3f dimensions;
+	dimensions[0] = width;
+	dimensions[1] = height;
+	dimensions[2] = k1;
+	int divx = (int) ceilf(width / radius);
+	int divy = (int) ceilf(height / radius);
+
+	fprintf(stdout, "%7s %9s %9s %11s %11s %9s %9s %9s\n",
+			"spread", "agents", "outside", "lattice ns", "hash ns", "speedup", "bins", "cells");
+
+	uint32 randomState = PMath::RandomSeed(13);
+	PMath::RandomScope random(randomState);
+	for (int spread = 1; spread <= maxSpread; spread *= 2) {
+		int count = vehicles * spread * spread;
+		float w = width * spread;
+		float h = height * spread;
+		std::vector<PhysState> states(count);
+		int outside = 0;
+		for (int i = 0; i < count; ++i) {
+			PhysState& state = states[i];
+			state.m_Kind = World::kVehicle;
+			state.m_Position[0] = 0.5f * (width - w) + PMath::randf() * w;
+			state.m_Position[1] = 0.5f * (height - h) + PMath::randf() * h;
+			if (state.m_Position[0] < 0 || state.m_Position[0] >= width || state.m_Position[1] < 0 || state.m_Position[1] >= height) {
+				++outside;
+			}
+		}
+
+		int sample = PMath::Min(count, queries);
+		int stride = count / sample;
+		double seconds[2];
+		int cells[2];
+		std::vector<float> found[2];
+		for (int mode = 0; mode < 2; ++mode) {
+			NearestNeighbours* pNN = (mode == 0) ? new NearestNeighbours(origin, dimensions, divx, divy, 1) : new NearestNeighbours(radius);
+			for (int i = 0; i < count; ++i) {
+				pNN->AddProxy(&states[i]);
+			}
+			cells[mode] = pNN->GetBinCount();
+
+			found[mode].resize(sample);
+			double start = Seconds();
+			for (int q = 0; q < sample; ++q) {
+				PhysState const& state = states[q * stride];
+				PhysState const* pNearest = (PhysState const*) pNN->FindNearestNeighbour(state.m_Position, radius, World::kVehicle, &state);
+				found[mode][q] = pNearest ? state.DistanceSquared(pNearest) : -1.0f;
+			}
+			seconds[mode] = Seconds() - start;
+
+			for (int i = 0; i < count; ++i) {
+				pNN->RemoveProxy(&states[i]);
+			}
+			delete pNN;
+		}
+
+		fprintf(stdout, "%7d %9d %8.0f%% %11.1f %11.1f %9.1f %9d %9d\n",
+				spread, count, 100.0 * outside / count,
+				seconds[0] * 1.0e9 / sample, seconds[1] * 1.0e9 / sample, seconds[0] / seconds[1], cells[0], cells[1]);
+		fflush(stdout);
+
+		// ties may pick different neighbours, but never at a different distance
+		if (found[0] != found[1]) {
+			fprintf(stdout, "the hash found different neighbours\n");
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Collision sensing through Verlet neighbour lists. The same world of light seeking avoiders
+/// is stepped with lists of several skins, and without them; the sense stage, how often the
+/// lists were rebuilt and how long they were are reported, and the worlds must end up identical.
+static int RunNeighbourLists(int count, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+	const float skins[] = { 0.0f, 5.0f, 10.0f, 20.0f, 40.0f };
+	float scale = sqrtf((float) count / 1000.0f);
+
+	fprintf(stdout, "%6s %10s %8s %10s %12s %9s\n", "skin", "sense ms", "builds", "per build", "mean length", "checksum");
+
+	uint32 reference = 0;
+	for (size_t s = 0; s < sizeof(skins) / sizeof(skins[0]); ++s) {
+		World world;
+		world.Seed(1);
+		world.SetBounds(1000.0f * scale, 600.0f * scale);
+		world.CreatePopulationScaling(count);
+		world.SetNeighbourListSkin(skins[s]);
+
+		StepTimes times;
+		for (int i = 0; i < ticks; ++i) {
+			world.Step(dt, &times);
+		}
+
+		NeighbourListStats const& stats = world.GetNeighbourListStats();
+		uint32 checksum = world.Checksum();
+		if (s == 0) {
+			reference = checksum;
+			fprintf(stdout, "%6s %10.3f %8s %10s %12s %9s\n", "off", times.sense * 1000.0 / ticks, "-", "-", "-", "-");
+		}
+		else {
+			fprintf(stdout, "%6.0f %10.3f %8d %10.1f %12.1f %9s\n", skins[s], times.sense * 1000.0 / ticks,
+					stats.builds, stats.builds > 0 ? (double) stats.steps / stats.builds : 0.0,
+					stats.lists > 0 ? (double) stats.entries / stats.lists : 0.0,
+					checksum == reference ? "same" : "differs");
+		}
+		fflush(stdout);
+		if (checksum != reference) {
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Sector queries for sensors that only look ahead. The old way, the nearest neighbour in any
+/// direction followed by a test of whether it is in front, is timed against the sector query for
+/// several half angles; queries where the old way found nothing though something was in view are
+/// counted, and every sector query is checked against a scan.
+static int RunConeQueries(int count)
+{
+	const float radius = World::kCollisionQueryRadius;
+	const float halfAngles[] = { 90.0f, 60.0f, 30.0f };
+	const int queries = 10000;
+	float scale = sqrtf((float) count / 1000.0f);
+	float width = 1000.0f * scale;
+	float height = 600.0f * scale;
+
+	PMath::Vec3f origin;
+	origin[0] = origin[1] = k0;
+	origin[2] = -kHalf;
+	PMath::Vec3f dimensions;
+	dimensions[0] = width;
+	dimensions[1] = height;
+	dimensions[2] = k1;
+	NearestNeighbours nn(origin, dimensions, (int) ceilf(width / radius), (int) ceilf(height / radius), 1);
+
+	uint32 randomState = PMath::RandomSeed(17);
+	PMath::RandomScope random(randomState);
+	std::vector<PhysState> states(count);
+	for (int i = 0; i < count; ++i) {
+		PhysState& state = states[i];
+		state.m_Kind = World::kVehicle;
+		state.m_Position[0] = PMath::randf() * width;
+		state.m_Position[1] = PMath::randf() * height;
+		state.m_Rotation = PMath::randf(0.0f, 2.0f * kPi);
+		nn.AddProxy(&state);
+	}
+
+	fprintf(stdout, "%10s %12s %12s %9s %9s\n", "half angle", "nearest ns", "sector ns", "speedup", "missed");
+
+	int sample = PMath::Min(count, queries);
+	int stride = count / sample;
+	for (size_t a = 0; a < sizeof(halfAngles) / sizeof(halfAngles[0]); ++a) {
+		float cosHalfAngle = cosf(halfAngles[a] * kPi / 180.0f);
+		std::vector<PhysState const*> nearest(sample), inView(sample);
+
+		double start = Seconds();
+		for (int q = 0; q < sample; ++q) {
+			PhysState const& state = states[q * stride];
+			float forward[2] = { sinf(state.m_Rotation), cosf(state.m_Rotation) };
+			PhysState const* pNearest = (PhysState const*) nn.FindNearestNeighbour(state.m_Position, radius, World::kVehicle, &state);
+			if (pNearest && !NearestNeighbours::InView(pNearest->m_Position[0] - state.m_Position[0], pNearest->m_Position[1] - state.m_Position[1],
+													   state.DistanceSquared(pNearest), forward, cosHalfAngle, k0)) {
+				pNearest = 0;
+			}
+			nearest[q] = pNearest;
+		}
+		double nearestSeconds = Seconds() - start;
+
+		start = Seconds();
+		for (int q = 0; q < sample; ++q) {
+			PhysState const& state = states[q * stride];
+			float forward[2] = { sinf(state.m_Rotation), cosf(state.m_Rotation) };
+			inView[q] = (PhysState const*) nn.FindNearestNeighbourInView(state.m_Position, radius, forward, cosHalfAngle, k0, World::kVehicle, &state);
+		}
+		double sectorSeconds = Seconds() - start;
+
+		int missed = 0;
+		for (int q = 0; q < sample; ++q) {
+			PhysState const& state = states[q * stride];
+			float forward[2] = { sinf(state.m_Rotation), cosf(state.m_Rotation) };
+			float best = radius * radius;
+			for (int i = 0; i < count; ++i) {
+				float distSquared = state.DistanceSquared(&states[i]);
+				if (&states[i] != &state && distSquared < best &&
+					NearestNeighbours::InView(states[i].m_Position[0] - state.m_Position[0], states[i].m_Position[1] - state.m_Position[1],
+											  distSquared, forward, cosHalfAngle, k0)) {
+					best = distSquared;
+				}
+			}
+			float found = inView[q] ? state.DistanceSquared(inView[q]) : radius * radius;
+			if (found != best) {
+				fprintf(stdout, "the sector query disagrees with a scan at query %d\n", q);
+				return EXIT_FAILURE;
+			}
+			if (inView[q] && !nearest[q]) {
+				++missed;
+			}
+		}
+
+		fprintf(stdout, "%10.0f %12.1f %12.1f %9.2f %8.1f%%\n", halfAngles[a],
+				nearestSeconds * 1.0e9 / sample, sectorSeconds * 1.0e9 / sample, nearestSeconds / sectorSeconds,
+				100.0 * missed / sample);
+		fflush(stdout);
+	}
+
+	for (int i = 0; i < count; ++i) {
+		nn.RemoveProxy(&states[i]);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Light fields for many-light scenes. For increasing numbers of lights, a light sensor's
+/// summed activation is sampled from the field and computed exactly by visiting every light;
+/// the nearest light query is timed alongside, as what sensing cost before. The time to
+/// rasterise the lights, and the largest errors of the field against the exact sums, relative to
+/// the largest sums, are reported.
+static int RunLightField(int maxLights, float cellSize)
+{
+	const float width = 10000.0f;
+	const float height = 6000.0f;
+	const float radius = width;				// as the test brains' light sensors
+	const int queries = 100000;
+
+	fprintf(stdout, "%8s %10s %10s %12s %12s %10s %12s\n",
+			"lights", "field ns", "index ns", "exact ns", "splat ms", "max error", "steer error");
+
+	uint32 randomState = PMath::RandomSeed(11);
+	PMath::RandomScope random(randomState);
+	for (int count = 1; count <= maxLights; count *= 10) {
+		World world;
+		world.SetBounds(width, height);
+		world.SetLightField(cellSize, radius);
+		for (int i = 0; i < count; ++i) {
+			world.CreateLight(PMath::randf() * width, PMath::randf() * height);
+		}
+
+		std::vector<float> points(2 * queries);
+		for (int i = 0; i < 2 * queries; i += 2) {
+			points[i] = PMath::randf() * width;
+			points[i + 1] = PMath::randf() * height;
+		}
+
+		float activation;
+		PMath::Vec2f steering;
+		double start = Seconds();
+		world.SampleLightField(&points[0], radius, activation, steering);		// splats the lights
+		double splat = Seconds() - start;
+
+		std::vector<float> field(3 * queries);
+		start = Seconds();
+		for (int i = 0; i < queries; ++i) {
+			world.SampleLightField(&points[2 * i], radius, field[3 * i], &field[3 * i + 1]);
+		}
+		double sample = Seconds() - start;
+
+		world.FindNearestLight(0, 0);		// builds the index
+		start = Seconds();
+		for (int i = 0; i < queries; ++i) {
+			world.FindNearestLight(points[2 * i], points[2 * i + 1]);
+		}
+		double index = Seconds() - start;
+
+		// the exact sums, of the same terms the field is made of
+		double maxError = 0, maxActivation = 0, maxSteeringError = 0, maxSteering = 0;
+		int exactQueries = PMath::Min(queries, 100000000 / count);
+		start = Seconds();
+		for (int i = 0; i < exactQueries; ++i) {
+			double sum = 0, steer[2] = { 0, 0 };
+			for (int l = 0; l < world.GetLightCount(); ++l) {
+				PhysState const& light = world.GetEntityState(world.GetLight(l));
+				double dx = light.m_Position[0] - points[2 * i];
+				double dy = light.m_Position[1] - points[2 * i + 1];
+				double falloff = 1.0 - sqrt(dx * dx + dy * dy) / radius;
+				if (falloff > 0) {
+					sum += falloff * falloff;
+					steer[0] += dx * falloff;
+					steer[1] += dy * falloff;
+				}
+			}
+			maxError = PMath::Max(maxError, fabs(sum - field[3 * i]));
+			maxActivation = PMath::Max(maxActivation, sum);
+			maxSteeringError = PMath::Max(maxSteeringError, PMath::Max(fabs(steer[0] - field[3 * i + 1]), fabs(steer[1] - field[3 * i + 2])));
+			maxSteering = PMath::Max(maxSteering, PMath::Max(fabs(steer[0]), fabs(steer[1])));
+		}
+		double exact = Seconds() - start;
+
+		fprintf(stdout, "%8d %10.1f %10.1f %12.1f %12.3f %9.3f%% %11.3f%%\n", count,
+				sample * 1.0e9 / queries, index * 1.0e9 / queries, exact * 1.0e9 / exactQueries, splat * 1000.0,
+				100.0 * maxError / PMath::Max(maxActivation, 1.0e-6), 100.0 * maxSteeringError / PMath::Max(maxSteering, 1.0e-6));
+		fflush(stdout);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Mixed query radii on a multi-resolution lattice. Nearest neighbour and gather queries of the
+/// collision query radius, of the collision sensors' tenth of the world, and of the light
+/// sensors' whole world, are timed on a lattice of collision radius sub-bricks with one level
+/// and with several; every query must find the same as on the single level.
+static int RunGridLevels(int count, int levels)
+{
+	const float width = 10000.0f;
+	const float height = 6000.0f;
+	const float cell = World::kCollisionQueryRadius;
+	const float radii[] = { cell, 0.1f * width, width };
+	const int queries = 10000;
+
+	PMath::Vec3f origin;
+	origin[0] = origin[1] = k0;
+	origin[2] = -kHalf;
+	PMath::Vec3f dimensions;
+	dimensions[0] = width;
+	dimensions[1] = height;
+	dimensions[2] = k1;
+	int divx = (int) ceilf(width / cell);
+	int divy = (int) ceilf(height / cell);
+
+	uint32 randomState = PMath::RandomSeed(19);
+	PMath::RandomScope random(randomState);
+	std::vector<PhysState> states(count);
+	for (int i = 0; i < count; ++i) {
+		states[i].m_Kind = World::kVehicle;
+		states[i].m_Position[0] = PMath::randf() * width;
+		states[i].m_Position[1] = PMath::randf() * height;
+	}
+
+	fprintf(stdout, "%8s %7s %11s %11s %9s %11s %11s %9s\n",
+			"radius", "levels", "nearest ns", "1 level ns", "speedup", "gather ns", "1 level ns", "speedup");
+
+	int sample = PMath::Min(count, queries);
+	int stride = count / sample;
+	for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); ++r) {
+		float radius = radii[r];
+		double nearestSeconds[2], gatherSeconds[2];
+		std::vector<float> nearest[2];
+		std::vector<size_t> gathered[2];
+		int levelsUsed = 1;
+		for (int mode = 0; mode < 2; ++mode) {
+			NearestNeighbours nn(origin, dimensions, divx, divy, 1, true, mode == 0 ? levels : 1);
+			if (mode == 0) {
+				levelsUsed = nn.GetLevelCount();
+			}
+			for (int i = 0; i < count; ++i) {
+				nn.AddProxy(&states[i]);
+			}
+
+			nearest[mode].resize(sample);
+			double start = Seconds();
+			for (int q = 0; q < sample; ++q) {
+				PhysState const& state = states[q * stride];
+				PhysState const* pNearest = (PhysState const*) nn.FindNearestNeighbour(state.m_Position, radius, World::kVehicle, &state);
+				nearest[mode][q] = pNearest ? state.DistanceSquared(pNearest) : -1.0f;
+			}
+			nearestSeconds[mode] = Seconds() - start;
+
+			// gathering the whole world finds everything whatever the levels, so it is left out
+			std::vector<NNProxy*> found;
+			int gathers = (radius < width) ? sample : 0;
+			gathered[mode].resize(gathers);
+			start = Seconds();
+			for (int q = 0; q < gathers; ++q) {
+				PhysState const& state = states[q * stride];
+				found.clear();
+				nn.FindNeighbours(state.m_Position, radius, World::kVehicle, &state, found);
+				gathered[mode][q] = found.size();
+			}
+			gatherSeconds[mode] = gathers > 0 ? (Seconds() - start) / gathers : 0;
+
+			for (int i = 0; i < count; ++i) {
+				nn.RemoveProxy(&states[i]);
+			}
+		}
+
+		fprintf(stdout, "%8.0f %7d %11.1f %11.1f %9.2f", radius, levelsUsed,
+				nearestSeconds[0] * 1.0e9 / sample, nearestSeconds[1] * 1.0e9 / sample, nearestSeconds[1] / nearestSeconds[0]);
+		if (gatherSeconds[0] > 0) {
+			fprintf(stdout, " %11.1f %11.1f %9.2f\n", gatherSeconds[0] * 1.0e9, gatherSeconds[1] * 1.0e9, gatherSeconds[1] / gatherSeconds[0]);
+		}
+		else {
+			fprintf(stdout, " %11s %11s %9s\n", "-", "-", "-");
+		}
+		fflush(stdout);
+
+		if (nearest[0] != nearest[1] || gathered[0] != gathered[1]) {
+			fprintf(stdout, "the levels found different neighbours\n");
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/// The scent field's stencil on a size by size grid, with the scalar and SIMD kernels, on one
+/// thread and up to maxThreads, double buffered and in place; every variant must leave the
+/// field exactly as the scalar kernel does. Then a world of trail laying vehicles is stepped
+/// with a scent field, and checkpointed and restored mid-run to check the field is restored too.
+static int RunScentField(int size, int maxThreads)
+{
+	const float dt = 1.0f / 60.0f;
+	const int steps = 60;
+
+	ScalarField field;
+	field.Configure((float) size, (float) size, 1.0f);
+	field.SetRates(6.0f, 0.5f);
+
+	uint32 randomState = PMath::RandomSeed(23);
+	{
+		PMath::RandomScope random(randomState);
+		for (int i = 0; i < 10000; ++i) {
+			field.Deposit(PMath::randf() * size, PMath::randf() * size, PMath::randf(0.5f, 1.0f));
+		}
+	}
+	std::vector<float> initial(field.GetCells(), field.GetCells() + (size_t) size * size);
+	std::vector<float> reference;
+
+	fprintf(stdout, "%dx%d cells, %d steps\n", size, size, steps);
+	fprintf(stdout, "%7s %8s %12s %10s %12s %8s\n", "kernel", "threads", "buffers", "ms/step", "Mcells/s", "result");
+
+	struct Variant { bool vectorized; int threads; bool doubleBuffered; };
+	std::vector<Variant> variants;
+	Variant scalar = { false, 1, true };
+	variants.push_back(scalar);
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		Variant v = { true, threads, true };
+		variants.push_back(v);
+	}
+	Variant inPlace = { true, maxThreads, false };
+	variants.push_back(inPlace);
+
+	bool same = true;
+	for (size_t i = 0; i < variants.size(); ++i) {
+		Variant const& v = variants[i];
+		field.SetVectorized(v.vectorized);
+		field.SetThreadCount(v.threads);
+		field.SetDoubleBuffered(v.doubleBuffered);
+		memcpy(field.GetCells(), &initial[0], initial.size() * sizeof(float));
+
+		double start = Seconds();
+		for (int step = 0; step < steps; ++step) {
+			field.Step(dt);
+		}
+		double seconds = (Seconds() - start) / steps;
+
+		bool match = true;
+		if (reference.empty()) {
+			reference.assign(field.GetCells(), field.GetCells() + initial.size());
+		}
+		else {
+			match = memcmp(&reference[0], field.GetCells(), initial.size() * sizeof(float)) == 0;
+		}
+		same = same && match;
+
+		fprintf(stdout, "%7s %8d %12s %10.3f %12.1f %8s\n", (v.vectorized && ScalarField::IsVectorAvailable()) ? "simd" : "scalar",
+				v.threads, v.doubleBuffered ? "double" : "in place", seconds * 1000.0,
+				(double) size * size / seconds / 1.0e6, match ? "same" : "DIFFERS");
+		fflush(stdout);
+	}
+
+	// trail followers, through a checkpoint
+	World original;
+	original.Seed(5);
+	original.SetBounds(1000.0f, 600.0f);
+	original.SetScentField(2.0f, 20.0f, 0.2f);
+	original.CreatePopulation(9, 2000);
+	for (int i = 0; i < 120; ++i) {
+		original.Step(dt);
+	}
+
+	Snapshot snapshot;
+	snapshot.Capture(original);
+	World copy;
+	if (!snapshot.Restore(copy)) {
+		fprintf(stderr, "could not restore the trail world\n");
+		return EXIT_FAILURE;
+	}
+
+	StepTimes times;
+	const int ticks = 240;
+	for (int i = 0; i < ticks; ++i) {
+		original.Step(dt, &times);
+		copy.Step(dt);
+	}
+	bool restored = original.Checksum() == copy.Checksum() &&
+					original.GetScentField().GetTotal() == copy.GetScentField().GetTotal();
+
+	fprintf(stdout, "%d trail followers on %dx%d scent cells: %.3f ms/tick in the field, %.3f ms/tick in all; scent %.1f; restored world %s\n",
+			original.GetEntityCount() - 1, original.GetScentField().GetColumns(), original.GetScentField().GetRows(),
+			times.scent * 1000.0 / ticks,
+			(times.clearSenses + times.sense + times.update + times.move + times.wrap + times.scent) * 1000.0 / ticks,
+			original.GetScentField().GetTotal(), restored ? "matched" : "DIFFERS");
+
+	return (same && restored) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Test brain 8 without its motor: it senses as a light seeking avoider does, collision
+/// queries and all, but never moves or turns
+static const char* kParkedAvoiderBrain =
+	"collision	avoid	radius 0.1\n"
+	"switch		choose	avoid seek avoid\n"
+	"light		seek	directional\n";
+
+/// Sense reuse with idle vehicles. Worlds of count light seeking avoiders, of which a fraction
+/// are parked, are stepped with and without reuse, and the light is moved half way through.
+/// The parked avoiders still make collision queries, so the timings show what reuse saves;
+/// the two worlds take turns at each tick, and at which goes first, so that neither is timed
+/// with a warmer cache. Kept senses keep their noise, so the check is made on a world that
+/// draws none: light sensing vehicles, half of them parked, must end in the same state with
+/// every sensor reading the same.
+static int RunSenseReuse(int count, int ticks)
+{
+	BrainDescription parked;
+	if (!parked.Parse(kParkedAvoiderBrain)) {
+		fprintf(stderr, "parked avoider: %s\n", parked.GetError());
+		return EXIT_FAILURE;
+	}
+
+	const float dt = 1.0f / 60.0f;
+	const float idleFractions[] = { 0.0f, 0.5f, 0.9f, 0.99f, 1.0f };
+	float scale = sqrtf((float) count / 1000.0f);
+
+	fprintf(stdout, "%8s %6s %12s %12s %9s %10s\n", "vehicles", "idle", "sense ms", "reuse ms", "speedup", "reused");
+
+	for (int f = 0; f <= (int) (sizeof(idleFractions) / sizeof(idleFractions[0])); ++f) {
+		bool check = f == (int) (sizeof(idleFractions) / sizeof(idleFractions[0]));
+		int idle = check ? count / 2 : (int) (idleFractions[f] * count);
+		World worlds[2];
+		StepTimes times[2];
+		for (int w = 0; w < 2; ++w) {
+			World& world = worlds[w];
+			world.Seed(3);
+			world.SetBounds(1000.0f * scale, 600.0f * scale);
+			if (check) {
+				world.CreatePopulation(0, idle);
+				for (int i = 1; i < world.GetEntityCount(); ++i) {
+					world.GetEntityState(i).m_Vehicle->mMaxSpeed = 0;
+				}
+			}
+			else {
+				world.CreatePopulation(8, 0);
+				world.SpawnVehicles(parked, idle);
+			}
+			world.SpawnVehicles(check ? 0 : 8, count - idle);
+			world.SetSenseReuse(w == 1);
+		}
+
+		for (int tick = 0; tick < ticks; ++tick) {
+			for (int turn = 0; turn < 2; ++turn) {
+				int w = (tick + turn) & 1;
+				World& world = worlds[w];
+				if (tick == ticks / 2) {
+					world.PlaceEntity(0, 0.25f * world.mMaxBoundH, 0.25f * world.mMaxBoundV);
+				}
+				world.Step(dt, &times[w]);
+			}
+		}
+
+		SenseReuseStats const& stats = worlds[1].GetSenseReuseStats();
+		double reused = 100.0 * stats.totalReused / PMath::Max(stats.totalVehicles, 1LL);
+		if (!check) {
+			double sense = (times[0].clearSenses + times[0].sense) * 1000.0 / ticks;
+			double reuse = (times[1].clearSenses + times[1].sense) * 1000.0 / ticks;
+			fprintf(stdout, "%8d %5.0f%% %12.3f %12.3f %9.2f %9.1f%%\n", count, 100.0f * idleFractions[f], sense, reuse, sense / reuse, reused);
+			fflush(stdout);
+			continue;
+		}
+
+		bool same = worlds[0].Checksum() == worlds[1].Checksum();
+		for (int i = 0; i < worlds[0].GetEntityCount() && same; ++i) {
+			DemoVehicle const* pA = worlds[0].GetEntityState(i).m_Vehicle;
+			DemoVehicle const* pB = worlds[1].GetEntityState(i).m_Vehicle;
+			for (int s = 0; pA && s < pA->GetSensorCount(); ++s) {
+				same = same && pA->GetSensor(s)->mActivation == pB->GetSensor(s)->mActivation &&
+						pA->GetSensor(s)->mSteeringActivation == pB->GetSensor(s)->mSteeringActivation;
+			}
+		}
+		fprintf(stdout, "noise free world, half parked: %.1f%% reused, %s\n", reused, same ? "same as without reuse" : "DIFFERS from without reuse");
+		return same ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Level of detail scheduling. A world of light seeking avoiders is stepped with every vehicle
+/// updated every tick, then with vehicles far from a focus at the centre put in slower buckets,
+/// one more level at a time. The buckets are staggered, so the vehicles updated per tick should
+/// stay close to their mean rather than arriving all at once.
+static int RunLevelOfDetail(int count, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+	float scale = sqrtf((float) count / 1000.0f);
+
+	fprintf(stdout, "%8s %6s %14s %9s %10s %10s %10s\n", "vehicles", "levels", "sense+update ms", "speedup", "mean/tick", "min/tick", "max/tick");
+
+	double full = 0;
+	for (int levels = 1; levels <= 4; ++levels) {
+		World world;
+		world.Seed(4);
+		world.SetBounds(1000.0f * scale, 600.0f * scale);
+		world.CreatePopulation(8, count);
+
+		InsectAI::FocusPriority priority(world.mMaxBoundH / 16.0f);
+		priority.SetFocus(world.mMaxBoundH * 0.5f, world.mMaxBoundV * 0.5f);
+		world.SetUpdatePriority(levels > 1 ? &priority : 0, levels);
+
+		// let the buckets settle before timing
+		for (int tick = 0; tick < 8; ++tick) {
+			world.Step(dt);
+		}
+
+		StepTimes times;
+		long long updated = 0;
+		int fewest = count, most = 0;
+		for (int tick = 0; tick < ticks; ++tick) {
+			world.Step(dt, &times);
+			int n = world.GetEngine().GetUpdatedCount();
+			updated += n;
+			fewest = PMath::Min(fewest, n);
+			most = PMath::Max(most, n);
+		}
+
+		double ms = (times.clearSenses + times.sense + times.update) * 1000.0 / ticks;
+		if (levels == 1) {
+			full = ms;
+		}
+		fprintf(stdout, "%8d %6d %14.3f %9.2f %10.0f %10d %10d\n", count, levels, ms, full / ms, (double) updated / ticks, fewest, most);
+		fflush(stdout);
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Lazy brain evaluation. Worlds of parked vehicles with light, buffer, inverter and sigmoid
+/// brains under a still light, a steady scene whose senses draw no noise, so that only real
+/// changes propagate, and a world of moving light seeking avoiders, are updated in full and
+/// lazily once the buffers have had time to settle. An epsilon of zero must leave every world
+/// as full updates do.
+static int RunLazyBrains(int count, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+	const float epsilons[] = { -1.0f, 0.0f, 1.0e-3f, 1.0e-2f };	// -1 updates in full
+	const int kSettleTicks = 300;
+	float scale = sqrtf((float) count / 1000.0f);
+	bool allSame = true;
+
+	fprintf(stdout, "%8s %7s %8s %11s %9s %10s %s\n", "vehicles", "scene", "epsilon", "update ms", "speedup", "evaluated", "");
+
+	for (int scene = 0; scene < 2; ++scene) {
+		bool steady = scene == 0;
+		double full = 0;
+		uint32 fullChecksum = 0;
+		for (int e = 0; e < (int) (sizeof(epsilons) / sizeof(epsilons[0])); ++e) {
+			World world;
+			world.Seed(6);
+			world.SetBounds(1000.0f * scale, 600.0f * scale);
+			if (steady) {
+				world.CreatePopulation(1, count / 4);
+				world.SpawnVehicles(2, count / 4);
+				world.SpawnVehicles(3, count / 4);
+				world.SpawnVehicles(0, count - 3 * (count / 4));
+				for (int i = 0; i < world.GetEntityCount(); ++i) {
+					if (world.GetEntityState(i).m_Vehicle) {
+						world.GetEntityState(i).m_Vehicle->mMaxSpeed = 0;
+					}
+				}
+			}
+			else {
+				world.CreatePopulation(8, count);
+			}
+
+			// a buffer takes a few seconds to ease onto its input
+			for (int tick = 0; tick < kSettleTicks; ++tick) {
+				world.Step(dt);
+			}
+			if (epsilons[e] >= 0) {
+				world.SetLazyBrains(true, epsilons[e]);
+			}
+
+			StepTimes times;
+			for (int tick = 0; tick < ticks; ++tick) {
+				world.Step(dt, &times);
+			}
+
+			long long evaluated = 0, skipped = 0;
+			for (int i = 0; i < world.GetEntityCount(); ++i) {
+				DemoVehicle const* pVehicle = world.GetEntityState(i).m_Vehicle;
+				if (pVehicle) {
+					evaluated += pVehicle->GetEvaluatedCount();
+					skipped += pVehicle->GetSkippedCount();
+				}
+			}
+
+			double ms = times.update * 1000.0 / ticks;
+			char epsilon[16] = "full";
+			char const* verdict = "";
+			if (epsilons[e] < 0) {
+				full = ms;
+				fullChecksum = world.Checksum();
+				evaluated = 1;
+			}
+			else {
+				snprintf(epsilon, sizeof(epsilon), "%g", epsilons[e]);
+				if (epsilons[e] == 0) {
+					bool same = world.Checksum() == fullChecksum;
+					allSame = allSame && same;
+					verdict = same ? "same as full" : "DIFFERS from full";
+				}
+			}
+			fprintf(stdout, "%8d %7s %8s %11.3f %9.2f %9.1f%% %s\n", count, steady ? "steady" : "moving", epsilon, ms, full / ms,
+					100.0 * evaluated / PMath::Max(evaluated + skipped, 1LL), verdict);
+			fflush(stdout);
+		}
+	}
+	return allSame ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Test brain 8, described; brains/avoider.brain has it with comments
+static const char* kAvoiderBrain =
+	"collision	avoid	radius 0.1\n"
+	"switch		choose	avoid seek avoid\n"
+	"light		seek	directional\n"
+	"motor		choose\n";
+
+/// Described brains. A description is parsed from text, written in binary and mapped back,
+/// and vehicles are built from the mapping without parsing it again. The avoider built from
+/// its description must then behave exactly as test brain 8 does.
+static int RunBrainDescription(int count, const char* pTextPath, const char* pBinaryPath)
+{
+	const float dt = 1.0f / 60.0f;
+	float scale = sqrtf((float) count / 1000.0f);
+
+	BrainDescription parsed;
+	const int parses = 1000;
+	double start = Seconds();
+	for (int i = 0; i < parses; ++i) {
+		bool ok = pTextPath ? parsed.ParseFile(pTextPath) : parsed.Parse(kAvoiderBrain);
+		if (!ok) {
+			fprintf(stderr, "%s: %s\n", pTextPath ? pTextPath : "avoider", parsed.GetError());
+			return EXIT_FAILURE;
+		}
+	}
+	double parse = (Seconds() - start) / parses;
+
+	if (!parsed.Write(pBinaryPath)) {
+		fprintf(stderr, "could not write %s\n", pBinaryPath);
+		return EXIT_FAILURE;
+	}
+	BrainDescription mapped;
+	start = Seconds();
+	bool ok = mapped.Map(pBinaryPath);
+	double map = Seconds() - start;
+	if (!ok) {
+		fprintf(stderr, "%s is not a valid brain\n", pBinaryPath);
+		return EXIT_FAILURE;
+	}
+
+	World described, coded;
+	described.Seed(7);
+	described.SetBounds(1000.0f * scale, 600.0f * scale);
+	described.CreatePopulation(8, 0);
+	start = Seconds();
+	described.SpawnVehicles(mapped, count);
+	double build = Seconds() - start;
+
+	coded.Seed(7);
+	coded.SetBounds(1000.0f * scale, 600.0f * scale);
+	coded.CreatePopulation(8, 0);
+	start = Seconds();
+	coded.SpawnVehicles(8, count);
+	double buildCoded = Seconds() - start;
+
+	fprintf(stdout, "%d sensors, %d actuators, %d bytes: parse %.2f us, map %.2f us\n",
+			mapped.GetSensorCount(), mapped.GetActuatorCount(), (int) mapped.GetSize(), parse * 1.0e6, map * 1.0e6);
+	fprintf(stdout, "%d vehicles: %.3f us each from the description, %.3f us each from test brain 8, %.3f us each parsing every time\n",
+			count, build * 1.0e6 / count, buildCoded * 1.0e6 / count, (build / count + parse) * 1.0e6);
+
+	if (pTextPath)
+		return EXIT_SUCCESS;
+
+	for (int tick = 0; tick < 120; ++tick) {
+		described.Step(dt);
+		coded.Step(dt);
+	}
+	bool same = described.Checksum() == coded.Checksum();
+	fprintf(stdout, "after 120 ticks the described avoiders %s\n", same ? "match test brain 8" : "DIFFER from test brain 8");
+	return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// A brain of neurons over many senses: count of them, as separate Neurons or as one Layer
+static void BuildNeuralBrain(DemoVehicle* pVehicle, int neurons, int inputs, uint32 activation, int variant)
+{
+	pVehicle->AllocBrain(inputs + (variant == 0 ? neurons : 1), 1);
+	std::vector<InsectAI::Sensor*> senses;
+	for (int j = 0; j < inputs; ++j) {
+		senses.push_back(new InsectAI::LightSensor(true, 1.0f));
+		pVehicle->AddSensor(senses.back());
+	}
+
+	InsectAI::Sensor* pFirst;
+	if (variant == 0) {
+		for (int n = 0; n < neurons; ++n) {
+			InsectAI::Neuron* pNeuron = new InsectAI::Neuron(activation);
+			for (int j = 0; j < inputs; ++j) {
+				pNeuron->AddInput(senses[j], PMath::randf(-1.0f, 1.0f));
+			}
+			pNeuron->mBias = PMath::randf(-0.5f, 0.5f);
+			pVehicle->AddSensor(pNeuron);
+		}
+		pFirst = pVehicle->GetSensor(inputs);
+	}
+	else {
+		InsectAI::Layer* pLayer = new InsectAI::Layer(neurons, activation);
+		pLayer->SetVectorized(variant == 2);
+		for (int j = 0; j < inputs; ++j) {
+			pLayer->AddInput(senses[j]);
+		}
+		// the same stream of weights as the neurons draw
+		for (int n = 0; n < neurons; ++n) {
+			for (int j = 0; j < inputs; ++j) {
+				pLayer->SetWeight(n, j, PMath::randf(-1.0f, 1.0f));
+			}
+			pLayer->SetBias(n, PMath::randf(-0.5f, 0.5f));
+		}
+		pVehicle->AddSensor(pLayer);
+		pFirst = pLayer;
+	}
+
+	InsectAI::Actuator* pMotor = new InsectAI::Actuator(InsectAI::Actuator::kMotor);
+	pMotor->SetInput(pFirst);
+	pVehicle->AddActuator(pMotor);
+}
+
+/// Weighted neurons. Vehicles with a brain of neurons over many senses are updated with the
+/// neurons as separate nodes, and as one layer with the scalar and the SSE2 product. The
+/// senses are set to new values every tick, and every neuron of every variant must agree
+static int RunNeurons(int count, int neurons, int inputs)
+{
+	const float dt = 1.0f / 60.0f;
+	const int ticks = 100;
+	const uint32 activations[] = { InsectAI::kNeuronRelu, InsectAI::kNeuronSigmoid, InsectAI::kNeuronTanh, InsectAI::kNeuronBuffer };
+	const char* names[] = { "relu", "sigmoid", "tanh", "buffer" };
+	bool allSame = true;
+
+	fprintf(stdout, "%d vehicles of %d neurons over %d senses%s\n", count, neurons, inputs,
+			InsectAI::Layer::IsVectorAvailable() ? "" : "; no SSE2, so both layers are scalar");
+	fprintf(stdout, "%10s %12s %12s %12s %9s %s\n", "activation", "neurons ms", "scalar ms", "layer ms", "speedup", "");
+
+	for (int a = 0; a < (int) (sizeof(activations) / sizeof(activations[0])); ++a) {
+		double ms[3];
+		std::vector<float> outputs[3];
+		for (int variant = 0; variant < 3; ++variant) {
+			uint32 random = PMath::RandomSeed(11);
+			PMath::RandomScope scope(random);
+
+			std::vector<PhysState> states(count);
+			std::vector<DemoVehicle*> vehicles;
+			for (int i = 0; i < count; ++i) {
+				vehicles.push_back(new DemoVehicle(&states[i]));
+				BuildNeuralBrain(vehicles.back(), neurons, inputs, activations[a], variant);
+			}
+
+			double elapsed = 0;
+			for (int tick = 0; tick < ticks; ++tick) {
+				for (int i = 0; i < count; ++i) {
+					for (int j = 0; j < inputs; ++j) {
+						InsectAI::Sensor* pSense = vehicles[i]->GetSensor(j);
+						pSense->mActivation = PMath::randf();
+						pSense->mSteeringActivation = PMath::randf(-1.0f, 1.0f);
+					}
+				}
+				double start = Seconds();
+				for (int i = 0; i < count; ++i) {
+					vehicles[i]->Update(dt);
+				}
+				elapsed += Seconds() - start;
+			}
+			ms[variant] = elapsed * 1000.0 / ticks;
+
+			for (int i = 0; i < count; ++i) {
+				for (int n = 0; n < neurons; ++n) {
+					InsectAI::Sensor* pNode = vehicles[i]->GetSensor(inputs + (variant == 0 ? n : 0));
+					outputs[variant].push_back(variant == 0 ? pNode->mActivation : ((InsectAI::Layer*) pNode)->GetOutput(n));
+					outputs[variant].push_back(variant == 0 ? pNode->mSteeringActivation : ((InsectAI::Layer*) pNode)->GetSteeringOutput(n));
+				}
+				delete vehicles[i];
+			}
+		}
+
+		bool same = outputs[0] == outputs[1] && outputs[0] == outputs[2];
+		allSame = allSame && same;
+		fprintf(stdout, "%10s %12.3f %12.3f %12.3f %9.2f %s\n", names[a], ms[0], ms[1], ms[2], ms[0] / ms[2],
+				same ? "same" : "DIFFERS");
+		fflush(stdout);
+	}
+	return allSame ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Actuator dynamics. Avoiders switch between seeking and fleeing, and their motors jump when
+/// they do; with a lag, and a rate limit, the motors ease instead. The outputs' mean and
+/// largest change per tick, after the motors have come up from rest, measure how smooth they are. Then the engine's pass over every
+/// actuator with dynamics is timed against integrating them vehicle by vehicle, which must
+/// give the same outputs
+static int RunActuators(int count, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+	const float lags[] = { 0.0f, 0.1f, 0.1f };
+	const float rates[] = { 0.0f, 0.0f, 4.0f };
+	const int warmup = 30;			// ticks for lagged motors to come up from rest
+	float scale = sqrtf((float) count / 1000.0f);
+
+	fprintf(stdout, "%8s %6s %6s %11s %12s %12s\n", "vehicles", "lag", "rate", "update ms", "mean change", "max change");
+	for (int d = 0; d < 3; ++d) {
+		World world;
+		world.Seed(7);
+		world.SetBounds(1000.0f * scale, 600.0f * scale);
+		world.CreatePopulation(8, count);
+		world.SetActuatorDynamics(InsectAI::Actuator::kMotor, lags[d], rates[d]);
+
+		std::vector<float> last;
+		double change = 0, maxChange = 0;
+		long long samples = 0;
+		StepTimes times;
+		for (int tick = 0; tick < ticks; ++tick) {
+			world.Step(dt, &times);
+			int v = 0;
+			for (int i = 0; i < world.GetEntityCount(); ++i) {
+				DemoVehicle const* pVehicle = world.GetEntityState(i).m_Vehicle;
+				if (!pVehicle)
+					continue;
+				float activation = pVehicle->GetActuator(0)->mActivation;
+				if (tick > warmup) {
+					double delta = fabs(activation - last[v]);
+					change += delta;
+					maxChange = PMath::Max(maxChange, delta);
+					++samples;
+				}
+				else {
+					last.push_back(0);
+				}
+				last[v++] = activation;
+			}
+		}
+		fprintf(stdout, "%8d %6g %6g %11.3f %12.5f %12.5f\n", count, lags[d], rates[d], times.update * 1000.0 / ticks,
+				change / PMath::Max(samples, 1LL), maxChange);
+		fflush(stdout);
+	}
+
+	// the integration alone, over an engine of bare vehicles
+	std::vector<float> outputs[2];
+	double ms[2];
+	for (int variant = 0; variant < 2; ++variant) {
+		uint32 random = PMath::RandomSeed(8);
+		PMath::RandomScope scope(random);
+
+		std::vector<PhysState> states(count);
+		std::vector<DemoVehicle*> vehicles;
+		InsectAI::Engine engine;
+		InsectAI::LightSensor sense(true, 1.0f);
+		for (int i = 0; i < count; ++i) {
+			DemoVehicle* pVehicle = new DemoVehicle(&states[i]);
+			pVehicle->AllocBrain(0, 2);
+			InsectAI::Actuator* pMotor = new InsectAI::Actuator(InsectAI::Actuator::kMotor);
+			pMotor->SetInput(&sense);
+			pMotor->SetDynamics(0.1f, 4.0f);
+			pVehicle->AddActuator(pMotor);
+			InsectAI::Actuator* pDeposit = new InsectAI::Actuator(InsectAI::Actuator::kDeposit);
+			pDeposit->SetInput(&sense);
+			pDeposit->SetDynamics(0.25f, 0.0f);
+			pVehicle->AddActuator(pDeposit);
+			engine.AddEntity(pVehicle);
+			vehicles.push_back(pVehicle);
+		}
+
+		double elapsed = 0;
+		for (int tick = 0; tick < ticks; ++tick) {
+			for (int i = 0; i < count; ++i) {
+				for (int a = 0; a < 2; ++a) {
+					vehicles[i]->GetActuator(a)->mTarget = PMath::randf();
+					vehicles[i]->GetActuator(a)->mSteeringTarget = PMath::randf(-1.0f, 1.0f);
+				}
+			}
+			double start = Seconds();
+			if (variant == 0) {
+				for (int i = 0; i < count; ++i) {
+					InsectAI::Agent* pAgent = vehicles[i];
+					for (int a = 0; a < pAgent->GetActuatorCount(); ++a) {
+						if (pAgent->GetActuator(a)->HasDynamics()) {
+							pAgent->GetActuator(a)->Integrate(dt);
+						}
+					}
+				}
+			}
+			else {
+				engine.IntegrateActuators(dt);
+			}
+			elapsed += Seconds() - start;
+		}
+		ms[variant] = elapsed * 1000.0 / ticks;
+
+		for (int i = 0; i < count; ++i) {
+			for (int a = 0; a < 2; ++a) {
+				outputs[variant].push_back(vehicles[i]->GetActuator(a)->mActivation);
+				outputs[variant].push_back(vehicles[i]->GetActuator(a)->mSteeringActivation);
+			}
+		}
+		engine.RemoveAllEntities();
+		for (int i = 0; i < count; ++i) {
+			delete vehicles[i];
+		}
+	}
+
+	bool same = outputs[0] == outputs[1];
+	fprintf(stdout, "%d actuators integrated in %.3f ms vehicle by vehicle, %.3f ms in one pass, %.1f ns each; %s\n",
+			2 * count, ms[0], ms[1], ms[1] * 1.0e6 / (2 * count), same ? "same" : "DIFFERS");
+	return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Time one test brain's dynamic graph against its static form. Every tick the raw senses
+/// are set to new values, the vehicles update their dynamic brains, and the static brain
+/// evaluates the same senses, loaded into its lanes; its outputs must match the actuators'.
+/// Gathering the senses from the sensors and scattering the outputs to the actuators, as a
+/// world of sensor objects would need, is timed apart
+template <class Brain>
+static bool RunStaticBrain(uint32 brainType, int count, int ticks)
+{
+	const float dt = 1.0f / 60.0f;
+	uint32 random = PMath::RandomSeed(12);
+	PMath::RandomScope scope(random);
+
+	World world;
+	std::vector<PhysState> states(count);
+	std::vector<DemoVehicle*> vehicles;
+	for (int i = 0; i < count; ++i) {
+		vehicles.push_back(new DemoVehicle(&states[i]));
+		world.BuildTestBrain(vehicles.back(), brainType);
+	}
+
+	Brain brain;
+	brain.Resize(count);
+	double dynamicTime = 0, staticTime = 0, gatherTime = 0;
+	bool same = true;
+	for (int tick = 0; tick < ticks; ++tick) {
+		for (int i = 0; i < count; ++i) {
+			for (int s = 0; s < vehicles[i]->GetSensorCount(); ++s) {
+				InsectAI::Sensor* pSensor = vehicles[i]->GetSensor(s);
+				if (!pSensor->mbInternalSensor) {
+					pSensor->mActivation = PMath::randf();
+					pSensor->mSteeringActivation = PMath::randf(-1.0f, 1.0f);
+				}
+			}
+		}
+
+		double start = Seconds();
+		for (int i = 0; i < count; ++i) {
+			vehicles[i]->Update(dt);
+		}
+		double updated = Seconds();
+		for (int i = 0; i < count; ++i) {
+			brain.Gather(i, vehicles[i], dt);
+		}
+		double gathered = Seconds();
+		brain.Evaluate();
+		double evaluated = Seconds();
+
+		for (int i = 0; i < count; ++i) {
+			for (int o = 0; o < Brain::kOutputs; ++o) {
+				InsectAI::Actuator const* pActuator = vehicles[i]->GetActuator(o);
+				same = same && brain.GetOutput(i, o) == pActuator->mActivation && brain.GetOutputSteering(i, o) == pActuator->mSteeringActivation;
+			}
+		}
+		double scatter = Seconds();
+		for (int i = 0; i < count; ++i) {
+			brain.Scatter(i, vehicles[i]);
+		}
+		double scattered = Seconds();
+
+		dynamicTime += updated - start;
+		staticTime += evaluated - gathered;
+		gatherTime += (gathered - updated) + (scattered - scatter);
+	}
+
+	fprintf(stdout, "%6u %8d %12.3f %12.3f %9.2f %16.3f %s\n", brainType, count, dynamicTime * 1000.0 / ticks, staticTime * 1000.0 / ticks,
+			dynamicTime / staticTime, gatherTime * 1000.0 / ticks, same ? "same" : "DIFFERS");
+	fflush(stdout);
+	for (int i = 0; i < count; ++i) {
+		delete vehicles[i];
+	}
+	return same;
+}
+
+/// Static brains, the test brains with their topology fixed at compile time, against the
+/// dynamic graphs that build them at run time
+static int RunStaticBrains(int count, int ticks)
+{
+	fprintf(stdout, "%6s %8s %12s %12s %9s %16s\n", "brain", "vehicles", "dynamic ms", "static ms", "speedup", "gather+scatter ms");
+	bool same = RunStaticBrain<InsectAI::StaticLightBrain>(0, count, ticks);
+	same = RunStaticBrain<InsectAI::StaticBufferedLightBrain>(1, count, ticks) && same;
+	same = RunStaticBrain<InsectAI::StaticInvertedLightBrain>(2, count, ticks) && same;
+	same = RunStaticBrain<InsectAI::StaticThresholdLightBrain>(3, count, ticks) && same;
+	same = RunStaticBrain<InsectAI::StaticAvoiderBrain>(8, count, ticks) && same;
+	same = RunStaticBrain<InsectAI::StaticTrailBrain>(9, count, ticks) && same;
+	return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Evolve brains, carrying on from the checkpoint if there is one and saving it after every
+/// generation
+static int RunEvolution(int generations, int genomes, int threads, const char* pCheckpoint)
+{
+	EvolutionSettings settings;
+	settings.genomes = genomes;
+	settings.threads = threads;
+	Evolution evolution(settings);
+	if (pCheckpoint && evolution.LoadCheckpoint(pCheckpoint)) {
+		fprintf(stdout, "resumed from %s at generation %d\n", pCheckpoint, evolution.GetGeneration());
+	}
+
+	fprintf(stdout, "%10s %10s %10s %14s\n", "generation", "best", "mean", "evaluations/min");
+	double seconds = 0;
+	int evaluations = 0;
+	for (int g = 0; g < generations; ++g) {
+		int before = evolution.GetEvaluationCount();
+		double step = evolution.Step();
+		seconds += step;
+		evaluations += evolution.GetEvaluationCount() - before;
+		fprintf(stdout, "%10d %10.4f %10.4f %14.0f\n", evolution.GetGeneration(), evolution.GetBestFitness(), evolution.GetMeanFitness(),
+				(evolution.GetEvaluationCount() - before) * 60.0 / step);
+		fflush(stdout);
+		if (pCheckpoint && !evolution.SaveCheckpoint(pCheckpoint)) {
+			fprintf(stderr, "could not write %s\n", pCheckpoint);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (seconds > 0) {
+		fprintf(stdout, "%d evaluations of %d vehicles for %d ticks in %.2f s on %d threads: %.0f per minute\n", evaluations,
+				evolution.GetSettings().vehicles, evolution.GetSettings().ticks, seconds, BatchRunner(threads).GetThreadCount(),
+				evaluations * 60.0 / seconds);
+		fprintf(stdout, "the fittest brain, with a top speed of %.3f:\n%s", evolution.GetBest().maxSpeed, evolution.GetBest().Describe().c_str());
+	}
+	return EXIT_SUCCESS;
+}
+
+static void Usage()
+{
+	fprintf(stderr, "usage: insect-ai-headless <command> [args]\n"
+					"  scale [maxAgents]   per stage tick times for 1k to maxAgents (default 1M) agents\n"
+					"  batch [worlds] [threads] [results.csv]\n"
+					"                      run independent worlds in parallel, sweeping the test brains\n"
+					"  snapshot [agents] [file]\n"
+					"                      checkpoint a world, restore it from the file, and check it replays identically\n"
+					"  record <log> [agents] [ticks]\n"
+					"                      record a scripted session, as the demo's --record does\n"
+					"  replay <log>        re-run a recorded session and report the first divergent tick\n"
+					"  profile [agents] [ticks] [trace.json]\n"
+					"                      per phase histograms and a Chrome trace; needs INSECTAI_PROFILE\n"
+					"  tune [maxAgents]    grow a world to maxAgents (default 100k), comparing fixed and adaptive grids\n"
+					"  lights [maxLights]  nearest light queries on the static index against a scan\n"
+					"  field [maxLights] [cellSize]\n"
+					"                      light sensing from a rasterised light field, against the nearest light and an exact sum\n"
+					"  sort [maxAgents]    sense and move times with spawn order and Z order storage, 10k to maxAgents (default 100k)\n"
+					"  verlet [agents] [ticks]\n"
+					"                      collision sensing with neighbour lists of several skins, and without\n"
+					"  cone [agents]       nearest in front by sector query, against nearest then a facing test\n"
+					"  scent [size] [maxThreads]\n"
+					"                      the scent field's diffusion with each kernel, thread count and buffering, and a trail world\n"
+					"  reuse [agents] [ticks]\n"
+					"                      sensing with and without reuse of unchanged senses, as more of the vehicles idle\n"
+					"  brain [agents] [text] [binary]\n"
+					"                      parse a brain description (the avoider by default), map its binary form and build agents from it\n"
+					"  neurons [agents] [neurons] [inputs]\n"
+					"                      brains of weighted neurons, as separate nodes and as a layer with and without SSE2\n"
+					"  actuators [agents] [ticks]\n"
+					"                      motors with a lag and a rate limit, and the engine's pass integrating them\n"
+					"  static [agents] [ticks]\n"
+					"                      the test brains as dynamic graphs and with their topology fixed at compile time\n"
+					"  evolve [generations] [genomes] [threads] [checkpoint]\n"
+					"                      evolve brains in parallel worlds, resuming from and saving to the checkpoint\n"
+					"  lazy [agents] [ticks]\n"
+					"                      brain updates in full and evaluating only what changed, in steady and moving scenes\n"
+					"  lod [agents] [ticks]\n"
+					"                      sensing and updating with distant vehicles in slower, staggered buckets\n"
+					"  levels [agents] [levels]\n"
+					"                      queries of mixed radii on a multi-resolution lattice, against a single level\n"
+					"  open [vehicles] [maxSpread]\n"
+					"                      queries on the bounded lattice and the sparse hash as agents leave the bounds\n"
+					"  kinds [vehicles] [maxLights]\n"
+					"                      vehicle queries among lights, with and without a lattice per kind\n"
+					"  grid [agents] [ticks]\n"
+					"                      spatial database statistics per tick; needs INSECTAI_LQ_STATS\n");
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	if (!strcmp(argv[1], "scale")) {
+		int maxCount = (argc > 2) ? atoi(argv[2]) : 1000000;
+		return RunScalingReport(maxCount);
+	}
+
+	if (!strcmp(argv[1], "batch")) {
+		int worlds = (argc > 2) ? atoi(argv[2]) : 180;
+		int threads = (argc > 3) ? atoi(argv[3]) : 0;
+		return RunBatch(worlds, threads, (argc > 4) ? argv[4] : 0);
+	}
+
+	if (!strcmp(argv[1], "snapshot")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		return RunSnapshotCheck(count, (argc > 3) ? argv[3] : "insectai.snapshot");
+	}
+
+	if (!strcmp(argv[1], "record") && argc > 2) {
+		int count = (argc > 3) ? atoi(argv[3]) : 200;
+		int ticks = (argc > 4) ? atoi(argv[4]) : 3600;
+		return RunRecord(argv[2], count, ticks);
+	}
+
+	if (!strcmp(argv[1], "replay") && argc > 2) {
+		return RunReplay(argv[2]);
+	}
+
+	if (!strcmp(argv[1], "profile")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 100;
+		return RunProfile(count, ticks, (argc > 4) ? argv[4] : "insectai-trace.json");
+	}
+
+	if (!strcmp(argv[1], "tune")) {
+		int maxCount = (argc > 2) ? atoi(argv[2]) : 100000;
+		return RunGridTuning(maxCount);
+	}
+
+	if (!strcmp(argv[1], "lights")) {
+		int maxLights = (argc > 2) ? atoi(argv[2]) : 10000;
+		return RunLightIndex(maxLights);
+	}
+
+	if (!strcmp(argv[1], "field")) {
+		int maxLights = (argc > 2) ? atoi(argv[2]) : 10000;
+		float cellSize = (argc > 3) ? (float) atof(argv[3]) : 50.0f;
+		return RunLightField(maxLights, cellSize);
+	}
+
+	if (!strcmp(argv[1], "sort")) {
+		int maxCount = (argc > 2) ? atoi(argv[2]) : 100000;
+		return RunSortReport(maxCount);
+	}
+
+	if (!strcmp(argv[1], "verlet")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 300;
+		return RunNeighbourLists(count, ticks);
+	}
+
+	if (!strcmp(argv[1], "cone")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		return RunConeQueries(count);
+	}
+
+	if (!strcmp(argv[1], "scent")) {
+		int size = (argc > 2) ? atoi(argv[2]) : 1024;
+		int maxThreads = (argc > 3) ? atoi(argv[3]) : PMath::Max(1, (int) std::thread::hardware_concurrency());
+		return RunScentField(size, maxThreads);
+	}
+
+	if (!strcmp(argv[1], "reuse")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 200;
+		return RunSenseReuse(count, ticks);
+	}
+
+	if (!strcmp(argv[1], "brain")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		return RunBrainDescription(count, (argc > 3) ? argv[3] : 0, (argc > 4) ? argv[4] : "insectai.brain");
+	}
+
+	if (!strcmp(argv[1], "neurons")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int neurons = (argc > 3) ? atoi(argv[3]) : 16;
+		int inputs = (argc > 4) ? atoi(argv[4]) : 8;
+		return RunNeurons(count, neurons, inputs);
+	}
+
+	if (!strcmp(argv[1], "actuators")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 200;
+		return RunActuators(count, ticks);
+	}
+
+	if (!strcmp(argv[1], "static")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 100000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 100;
+		return RunStaticBrains(count, ticks);
+	}
+
+	if (!strcmp(argv[1], "evolve")) {
+		int generations = (argc > 2) ? atoi(argv[2]) : 20;
+		int genomes = (argc > 3) ? atoi(argv[3]) : 64;
+		int threads = (argc > 4) ? atoi(argv[4]) : 0;
+		return RunEvolution(generations, genomes, threads, (argc > 5) ? argv[5] : 0);
+	}
+
+	if (!strcmp(argv[1], "lazy")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 200;
+		return RunLazyBrains(count, ticks);
+	}
+
+	if (!strcmp(argv[1], "lod")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 200;
+		return RunLevelOfDetail(count, ticks);
+	}
+
+	if (!strcmp(argv[1], "levels")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int levels = (argc > 3) ? atoi(argv[3]) : 4;
+		return RunGridLevels(count, levels);
+	}
+
+	if (!strcmp(argv[1], "open")) {
+		int vehicles = (argc > 2) ? atoi(argv[2]) : 10000;
+		int maxSpread = (argc > 3) ? atoi(argv[3]) : 4;
+		return RunOpenWorld(vehicles, maxSpread);
+	}
+
+	if (!strcmp(argv[1], "kinds")) {
+		int vehicles = (argc > 2) ? atoi(argv[2]) : 10000;
+		int maxLights = (argc > 3) ? atoi(argv[3]) : 100000;
+		return RunKindSegregation(vehicles, maxLights);
+	}
+
+	if (!strcmp(argv[1], "grid")) {
+		int count = (argc > 2) ? atoi(argv[2]) : 10000;
+		int ticks = (argc > 3) ? atoi(argv[3]) : 20;
+		return RunGridStats(count, ticks);
+	}
+
+	Usage();
+	return EXIT_FAILURE;
+}
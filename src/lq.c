@@ -97,9 +97,18 @@ typedef struct lqInternalDB
     /* extra bin for "everything else" (points outside super-brick) */
     lqClientProxy* other;
 
+    /* query statistics, only counted with INSECTAI_LQ_STATS */
+    lqStats stats;
 } lqInternalDB;
 
 
+#ifdef INSECTAI_LQ_STATS
+#define lqStat(statement) statement
+#else
+#define lqStat(statement)
+#endif
+
+
 /* ------------------------------------------------------------------ */
 /* Allocate and initialize an LQ database, return a pointer to it.
    The application needs to call this before using the LQ facility.
@@ -163,6 +172,7 @@ void lqInitDatabase (lqInternalDB* lq,
         for (i=0; i<bincount; i++) lq->bins[i] = NULL;
     }
     lq->other = NULL;
+    lqResetStats (lq);
 }
 
 
@@ -290,6 +300,7 @@ void lqUpdateForNewLocation  (lqInternalDB* lq,
 {
     /* find bin for new location */
     lqClientProxy** newBin = lqBinForLocation (lq, x, y, z);
+    lqStat(++lq->stats.updates);
 
     /* store location in client object, for future reference */
     object->x = x;
@@ -299,6 +310,7 @@ void lqUpdateForNewLocation  (lqInternalDB* lq,
     /* has object moved into a new bin? */
     if (newBin != object->bin)
     {
+	lqStat(++lq->stats.rebins);
 	lqRemoveFromBin (object);
  	lqAddToBin (object, newBin);
     }
@@ -320,10 +332,14 @@ void lqUpdateForNewLocation  (lqInternalDB* lq,
 	float dy = y - co->y;                                         \
 	float dz = z - co->z;                                         \
 	float distanceSquared = (dx * dx) + (dy * dy) + (dz * dz);    \
+	lqStat(++lq->stats.proxiesTested);                            \
                                                                       \
 	/* apply function if client object within sphere */           \
 	if (distanceSquared < radiusSquared)                          \
+	{                                                             \
+	    lqStat(++lq->stats.callbacks);                            \
 	    (*func) (co->object, distanceSquared, state);             \
+	}                                                             \
                                                                       \
 	/* consider next client object in bin list */                 \
 	co = co->next;                                                \
@@ -378,6 +394,7 @@ void lqMapOverAllObjectsInLocalityClipped (lqInternalDB* lq,
 		/* get current bin's client object list */
 		bin = &lq->bins[iindex + jindex + kindex];
 		co = *bin;
+		lqStat(++lq->stats.binsVisited);
 
 #ifdef BOIDS_LQ_DEBUG
 		if (lqAnnoteEnable) drawBin (lq, bin);
@@ -410,12 +427,16 @@ void lqMapOverAllOutsideObjects (lqInternalDB* lq,
 {
     lqClientProxy* co = lq->other;
     float radiusSquared = radius * radius;
+    lqStat(unsigned long long tested = lq->stats.proxiesTested);
 
     /* traverse the "other" bin's client object list */
     lqTraverseBinClientObjectList (co,
 				   radiusSquared,
 				   func,
 				   clientQueryState);
+
+    lqStat(++lq->stats.otherVisits);
+    lqStat(lq->stats.otherTested += lq->stats.proxiesTested - tested);
 }
 
 
@@ -455,6 +476,8 @@ void lqMapOverAllObjectsInLocality (lqInternalDB* lq,
 	 ((z - radius) >= lq->originz + lq->sizez));
     int minBinX, minBinY, minBinZ, maxBinX, maxBinY, maxBinZ;
 
+    lqStat(++lq->stats.queries);
+
     /* is the sphere completely outside the "super brick"? */
     if (completelyOutside)
     {
@@ -495,6 +518,73 @@ void lqMapOverAllObjectsInLocality (lqInternalDB* lq,
 }
 
 
+/* ------------------------------------------------------------------ */
+/* Like lqMapOverAllObjectsInLocality, with the traversal clipped to a
+   box within the sphere's bounds */
+
+
+void lqMapOverAllObjectsInLocalityBox (lqInternalDB* lq,
+				       float x, float y, float z,
+				       float radius,
+				       float minx, float miny, float minz,
+				       float maxx, float maxy, float maxz,
+				       lqCallBackFunction func,
+				       void* clientQueryState)
+{
+    int partlyOut = 0;
+    int minBinX, minBinY, minBinZ, maxBinX, maxBinY, maxBinZ;
+
+    lqStat(++lq->stats.queries);
+
+    /* the box never needs to be larger than the sphere */
+    if (minx < x - radius) minx = x - radius;
+    if (miny < y - radius) miny = y - radius;
+    if (minz < z - radius) minz = z - radius;
+    if (maxx > x + radius) maxx = x + radius;
+    if (maxy > y + radius) maxy = y + radius;
+    if (maxz > z + radius) maxz = z + radius;
+
+    /* is the box completely outside the "super brick"? */
+    if ((maxx < lq->originx) ||
+	(maxy < lq->originy) ||
+	(maxz < lq->originz) ||
+	(minx >= lq->originx + lq->sizex) ||
+	(miny >= lq->originy + lq->sizey) ||
+	(minz >= lq->originz + lq->sizez))
+    {
+	lqMapOverAllOutsideObjects (lq, x, y, z, radius, func,
+				    clientQueryState);
+	return;
+    }
+
+    minBinX = (int) (((minx - lq->originx) / lq->sizex) * lq->divx);
+    minBinY = (int) (((miny - lq->originy) / lq->sizey) * lq->divy);
+    minBinZ = (int) (((minz - lq->originz) / lq->sizez) * lq->divz);
+    maxBinX = (int) (((maxx - lq->originx) / lq->sizex) * lq->divx);
+    maxBinY = (int) (((maxy - lq->originy) / lq->sizey) * lq->divy);
+    maxBinZ = (int) (((maxz - lq->originz) / lq->sizez) * lq->divz);
+
+    if (minBinX < 0)         {partlyOut = 1; minBinX = 0;}
+    if (minBinY < 0)         {partlyOut = 1; minBinY = 0;}
+    if (minBinZ < 0)         {partlyOut = 1; minBinZ = 0;}
+    if (maxBinX >= lq->divx) {partlyOut = 1; maxBinX = lq->divx - 1;}
+    if (maxBinY >= lq->divy) {partlyOut = 1; maxBinY = lq->divy - 1;}
+    if (maxBinZ >= lq->divz) {partlyOut = 1; maxBinZ = lq->divz - 1;}
+
+    if (partlyOut)
+	lqMapOverAllOutsideObjects (lq, x, y, z, radius, func,
+				    clientQueryState);
+
+    lqMapOverAllObjectsInLocalityClipped (lq,
+					  x, y, z,
+					  radius,
+					  func,
+					  clientQueryState,
+					  minBinX, minBinY, minBinZ,
+					  maxBinX, maxBinY, maxBinZ);
+}
+
+
 /* ------------------------------------------------------------------ */
 /* internal helper function */
 
@@ -622,3 +712,47 @@ void lqRemoveAllObjects (lqInternalDB* lq)
 
 
 /* ------------------------------------------------------------------ */
+
+
+/* ------------------------------------------------------------------ */
+/* Query statistics */
+
+
+void lqGetStats (lqInternalDB* lq, lqStats* stats)
+{
+    *stats = lq->stats;
+}
+
+
+void lqResetStats (lqInternalDB* lq)
+{
+    lq->stats.queries = 0;
+    lq->stats.binsVisited = 0;
+    lq->stats.proxiesTested = 0;
+    lq->stats.callbacks = 0;
+    lq->stats.otherVisits = 0;
+    lq->stats.otherTested = 0;
+    lq->stats.updates = 0;
+    lq->stats.rebins = 0;
+}
+
+
+int lqBinCount (lqInternalDB* lq)
+{
+    return lq->divx * lq->divy * lq->divz;
+}
+
+
+void lqGetBinOccupancy (lqInternalDB* lq, int* counts)
+{
+    int i;
+    int bincount = lqBinCount (lq);
+    lqClientProxy* co;
+    for (i=0; i<bincount; i++)
+    {
+	counts[i] = 0;
+	for (co = lq->bins[i]; co != NULL; co = co->next) counts[i]++;
+    }
+    counts[bincount] = 0;
+    for (co = lq->other; co != NULL; co = co->next) counts[bincount]++;
+}
@@ -215,6 +215,21 @@ void lqMapOverAllObjectsInLocality (lqDB* lq,
 				    void* clientQueryState);
 
 
+/* As lqMapOverAllObjectsInLocality, but only the sub-bricks overlapping
+   the given box are traversed.  A caller whose region of interest is a
+   part of the sphere, such as a sector, passes the bounds of that part
+   so that the sub-bricks outside it are never visited.  Objects are
+   still only reported if they are within the sphere.  */
+
+void lqMapOverAllObjectsInLocalityBox (lqDB* lq,
+				       float x, float y, float z,
+				       float radius,
+				       float minx, float miny, float minz,
+				       float maxx, float maxy, float maxz,
+				       lqCallBackFunction func,
+				       void* clientQueryState);
+
+
 /* ------------------------------------------------------------------ */
 /*                                                                    */
 /*                            Other API                               */
@@ -292,6 +307,44 @@ void lqMapOverAllObjects (lqDB* lq,
 void lqRemoveAllObjects (lqDB* lq);
 
 
+/* ------------------------------------------------------------------ */
+/* Query statistics, for tuning the lattice to a population.  The
+   counters are only kept when lq.c is compiled with INSECTAI_LQ_STATS
+   defined, so that the traversal costs nothing extra otherwise; without
+   it lqGetStats reports zeroes.  The occupancy functions always work,
+   as they only walk the bins when called. */
+
+
+typedef struct lqStats
+{
+    unsigned long long queries;        /* locality queries made */
+    unsigned long long binsVisited;    /* sub-bricks traversed by queries */
+    unsigned long long proxiesTested;  /* distance tests made by queries */
+    unsigned long long callbacks;      /* proxies found within a radius */
+    unsigned long long otherVisits;    /* queries that traversed "other" */
+    unsigned long long otherTested;    /* distance tests made in "other" */
+    unsigned long long updates;        /* calls to lqUpdateForNewLocation */
+    unsigned long long rebins;         /* updates that moved a proxy */
+} lqStats;
+
+
+void lqGetStats (lqDB* lq, lqStats* stats);
+void lqResetStats (lqDB* lq);
+
+
+/* The number of sub-bricks, not counting the "other" bin */
+
+
+int lqBinCount (lqDB* lq);
+
+
+/* Count the proxies in every bin: counts must have room for
+   lqBinCount + 1 entries, the last of which is the "other" bin. */
+
+
+void lqGetBinOccupancy (lqDB* lq, int* counts);
+
+
 /* ------------------------------------------------------------------ */
 
 
@@ -0,0 +1,200 @@
+
+#include "InsectAI.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INSECTAI_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace InsectAI {
+
+namespace {
+	/// A neuron's activation from its weighted sum; a buffer eases from its previous activation
+	/// at the given rate per second
+	inline float Activate(uint32 activation, float sum, float previous, float rate, float dt) {
+		switch (activation) {
+			case kNeuronSigmoid:	return 1.0f / (1.0f + expf(-sum));
+			case kNeuronTanh:		return tanhf(sum);
+			case kNeuronRelu:		return sum > 0.0f ? sum : 0.0f;
+			case kNeuronBuffer:
+			default:				return previous + (sum - previous) * rate * dt;	// hysteresis of 1/rate seconds, 0.25 by default
+		}
+	}
+}
+
+	Neuron::Neuron(uint32 activation) : Sensor(), mActivationFunction(activation), mBias(0.0f), mRate(4.0f), mSum(0.0f) {
+		m_Kind = GetStaticKind();
+		m_SensedAgent = 0;
+		mbClearEachFrame = false;
+		mbInternalSensor = true;
+		mbDirectional = false;
+	}
+
+	Neuron::~Neuron() {
+	}
+
+void Neuron::Update(float dt) {
+	float sum = 0.0f, steering = 0.0f;
+	for (size_t i = 0; i < mInputs.size(); ++i) {
+		sum += mWeights[i] * mInputs[i]->mActivation;
+		steering += mWeights[i] * mInputs[i]->mSteeringActivation;
+	}
+	mSum = sum + mBias;
+	mActivation = Activate(mActivationFunction, mSum, mActivation, mRate, dt);
+	mSteeringActivation = steering;
+}
+
+bool Neuron::InputsChanged() const {
+	for (size_t i = 0; i < mInputs.size(); ++i) {
+		if (mInputs[i]->mbChanged)
+			return true;
+	}
+	return false;
+}
+
+bool Neuron::IsSettled(float epsilon, float dt) const {
+	return mActivationFunction != kNeuronBuffer || fabsf(mSum - mActivation) <= epsilon ||
+		   Activate(kNeuronBuffer, mSum, mActivation, mRate, dt) == mActivation;
+}
+
+
+	Layer::Layer(int neurons, uint32 activation)
+	: Sensor(), mActivationFunction(activation), mRate(4.0f), mNeurons(neurons), mStride((neurons + 3) & ~3), mbVectorized(true) {
+		m_Kind = GetStaticKind();
+		m_SensedAgent = 0;
+		mbClearEachFrame = false;
+		mbInternalSensor = true;
+		mbDirectional = false;
+
+		mBiases.assign(mStride, 0.0f);
+		mSums.assign(mStride, 0.0f);
+		mSteering.assign(mStride, 0.0f);
+		mOutputs.assign(mStride, 0.0f);
+		mPropagated.assign(2 * mStride, 0.0f);
+	}
+
+	Layer::~Layer() {
+	}
+
+void Layer::AddInput(Sensor* pSensor) {
+	mInputs.push_back(pSensor);
+	mWeights.resize(mInputs.size() * mStride, 0.0f);
+	mActivations.resize(mInputs.size());
+	mSteeringActivations.resize(mInputs.size());
+}
+
+void Layer::SetOutput(int neuron, float activation, float steering) {
+	mOutputs[neuron] = activation;
+	mSteering[neuron] = steering;
+	if (neuron == 0) {
+		mActivation = activation;
+		mSteeringActivation = steering;
+	}
+}
+
+bool Layer::IsVectorAvailable() {
+#ifdef INSECTAI_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Layer::Update(float dt) {
+	int inputs = (int) mInputs.size();
+	for (int j = 0; j < inputs; ++j) {
+		mActivations[j] = mInputs[j]->mActivation;
+		mSteeringActivations[j] = mInputs[j]->mSteeringActivation;
+	}
+
+	// each input's column of weights scales it into four neurons' sums at once, so no
+	// horizontal adds are needed, and every neuron adds its inputs in order as Neuron does
+	float const* pWeights = inputs ? &mWeights[0] : 0;
+	int n = 0;
+#ifdef INSECTAI_SSE2
+	if (mbVectorized) {
+		for (; n < mStride; n += 4) {
+			__m128 sum = _mm_setzero_ps();
+			__m128 steering = _mm_setzero_ps();
+			for (int j = 0; j < inputs; ++j) {
+				__m128 weight = _mm_loadu_ps(pWeights + j * mStride + n);
+				sum = _mm_add_ps(sum, _mm_mul_ps(weight, _mm_set1_ps(mActivations[j])));
+				steering = _mm_add_ps(steering, _mm_mul_ps(weight, _mm_set1_ps(mSteeringActivations[j])));
+			}
+			_mm_storeu_ps(&mSums[n], _mm_add_ps(sum, _mm_loadu_ps(&mBiases[n])));
+			_mm_storeu_ps(&mSteering[n], steering);
+		}
+	}
+#endif
+	for (; n < mNeurons; ++n) {
+		float sum = 0.0f, steering = 0.0f;
+		for (int j = 0; j < inputs; ++j) {
+			sum += pWeights[j * mStride + n] * mActivations[j];
+			steering += pWeights[j * mStride + n] * mSteeringActivations[j];
+		}
+		mSums[n] = sum + mBiases[n];
+		mSteering[n] = steering;
+	}
+
+	if (mActivationFunction == kNeuronRelu) {
+		for (n = 0; n < mNeurons; ++n) {
+			mOutputs[n] = mSums[n] > 0.0f ? mSums[n] : 0.0f;
+		}
+	}
+	else {
+		for (n = 0; n < mNeurons; ++n) {
+			mOutputs[n] = Activate(mActivationFunction, mSums[n], mOutputs[n], mRate, dt);
+		}
+	}
+
+	if (mNeurons > 0) {
+		mActivation = mOutputs[0];
+		mSteeringActivation = mSteering[0];
+	}
+}
+
+bool Layer::InputsChanged() const {
+	for (size_t i = 0; i < mInputs.size(); ++i) {
+		if (mInputs[i]->mbChanged)
+			return true;
+	}
+	return false;
+}
+
+bool Layer::IsSettled(float epsilon, float dt) const {
+	if (mActivationFunction != kNeuronBuffer)
+		return true;
+	for (int n = 0; n < mNeurons; ++n) {
+		if (fabsf(mSums[n] - mOutputs[n]) > epsilon && Activate(kNeuronBuffer, mSums[n], mOutputs[n], mRate, dt) != mOutputs[n])
+			return false;
+	}
+	return true;
+}
+
+bool Layer::PropagateOutputs(float epsilon) {
+	mbChanged = false;
+	for (int n = 0; n < mNeurons; ++n) {
+		if (fabsf(mOutputs[n] - mPropagated[n]) > epsilon || fabsf(mSteering[n] - mPropagated[mStride + n]) > epsilon) {
+			mPropagated[n] = mOutputs[n];
+			mPropagated[mStride + n] = mSteering[n];
+			mbChanged = true;
+		}
+	}
+	return mbChanged;
+}
+
+
+	LayerOutput::LayerOutput(Layer* pLayer, int neuron) : Sensor(), mpLayer(pLayer), mNeuron(neuron) {
+		m_Kind = GetStaticKind();
+		m_SensedAgent = 0;
+		mbClearEachFrame = false;
+		mbInternalSensor = true;
+		mbDirectional = false;
+	}
+
+	LayerOutput::~LayerOutput() {
+	}
+
+} // end namespace InsectAI
@@ -50,7 +50,9 @@ namespace InsectAI {
 
 				// if the possible collidee is in front of us, or simply very very close
 				if ((distance < 0.5f) || (temp[1] > 0.0f)) {
-					PMath::Vec3fScale(temp, k1 / distance);
+					if (distance > kEps) {						// coincident vehicles have no direction to steer away from
+						PMath::Vec3fScale(temp, k1 / distance);
+					}
 					steeringActivation = -temp[0] + randf(0.0f, 0.1f);	// a tiny bit of noise
 
 					temp[0] = 0.0f;
@@ -94,6 +96,47 @@ void LightSensor::Sense(DynamicState* pFrom, DynamicState* pTo) {
         }
 	}
 
+	Accumulate(distance, activation, steeringActivation);
+}
+
+bool LightSensor::SenseField(DynamicState* pFrom, EntityDatabase* pDB) {
+	float activation;
+	PMath::Vec2f steering;
+	if (!pDB->SampleLightField(pFrom->GetPosition(), mSensitiveRadius, activation, steering))
+		return false;
+
+	// the field's steering vector is already weighted by distance, as Sense weighs the offset
+	float steeringActivation = 0.f;
+	if (mbDirectional && activation > 0) {
+		PMath::Vec2fRotate(steering, pFrom->GetHeading());
+		steeringActivation = steering[0] + randf(0.0f, 0.1f);	// a tiny bit of noise
+	}
+
+	// the distance at which a single light would be felt as strongly
+	activation = PMath::Clamp(activation, 0.0f, 1.0f);
+	Accumulate(1.0f - sqrtf(activation), activation, steeringActivation);
+	return true;
+}
+
+bool FieldSensor::SenseField(DynamicState* pFrom, EntityDatabase* pDB) {
+	// the right antenna, at a greater heading, lies towards local +x, where positive steering turns
+	Real const* pPosition = pFrom->GetPosition();
+	float heading = pFrom->GetHeading();
+	Real left[3] = { pPosition[0] + mAntennaLength * sinf(heading - mAntennaAngle),
+					 pPosition[1] + mAntennaLength * cosf(heading - mAntennaAngle), pPosition[2] };
+	Real right[3] = { pPosition[0] + mAntennaLength * sinf(heading + mAntennaAngle),
+					  pPosition[1] + mAntennaLength * cosf(heading + mAntennaAngle), pPosition[2] };
+
+	Real leftScent, rightScent;
+	if (!pDB->SampleScent(left, leftScent) || !pDB->SampleScent(right, rightScent))
+		return false;
+
+	mActivation = PMath::Clamp(mGain * 0.5f * (leftScent + rightScent), 0.0f, 1.0f);
+	mSteeringActivation = mGain * (rightScent - leftScent);
+	return true;
+}
+
+void LightSensor::Accumulate(float distance, float activation, float steeringActivation) {
 	if (mbChooseClosest) {
 		if (distance < mClosestDistance) {
 			mClosestDistance = distance;
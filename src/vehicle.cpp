@@ -6,7 +6,7 @@
 namespace InsectAI {
 
 
-Vehicle::Vehicle() {
+Vehicle::Vehicle() : mbLazy(false), mbPrimed(false), mbQuiet(false), mEpsilon(0.0f), mBusyUpdates(0), mFullUpdates(0), mFullPeriod(kMinFullUpdates), mEvaluated(0), mSkipped(0) {
 	m_MaxSensor = 0;
 	m_MaxActuator = 0;
 	m_Actuators = 0;
@@ -24,16 +24,38 @@ Vehicle::~Vehicle() {
 void Vehicle::ClearSenses(float dt) {
 	int i;
 	for (i = 0; i < m_MaxSensor; ++i) {
+		// a lazy brain's internal sensors hold their outputs until their inputs change
+		if (mbLazy && mFullUpdates == 0 && m_Sensors[i]->mbInternalSensor)
+			continue;
 		m_Sensors[i]->Reset();
 	}
 }
 
+void Vehicle::SetLazy(bool lazy, float epsilon) {
+	mbLazy = lazy;
+	mbPrimed = false;
+	mbQuiet = false;
+	mEpsilon = epsilon;
+	mBusyUpdates = 0;
+	mFullUpdates = 0;
+	mFullPeriod = kMinFullUpdates;
+	mEvaluated = 0;
+	mSkipped = 0;
+}
+
 bool Vehicle::Sense(EntityDatabase* pDB) {
 	bool sensed = true;
 
 	for (int i = 0; i < m_MaxSensor; ++i) {
+		// a sensor reading a field the database keeps needs no query
+		if (m_Sensors[i]->SenseField(GetDynamicState(), pDB)) {
+			continue;
+		}
 		if (m_Sensors[i]->GetSensorWidth() == Sensor::kNearest) {
-			DynamicState* pNearest = pDB->GetNearest(this, m_Sensors[i]->GetSensedAgentKind());
+			float cosHalfAngle, nearRadius;
+			DynamicState* pNearest = m_Sensors[i]->GetFieldOfView(cosHalfAngle, nearRadius)
+				? pDB->GetNearestInView(this, m_Sensors[i]->GetSensedAgentKind(), cosHalfAngle, nearRadius)
+				: pDB->GetNearest(this, m_Sensors[i]->GetSensedAgentKind());
 			if (pNearest) {
 				m_Sensors[i]->Sense(GetDynamicState(), pNearest);
 			}
@@ -47,6 +69,11 @@ bool Vehicle::Sense(EntityDatabase* pDB) {
 
 
 void Vehicle::Update(float dt) {
+	if (mbLazy && mFullUpdates == 0) {
+		UpdateLazily(dt);
+		return;
+	}
+
 	int i;
 	// run functions
 	for (i = 0; i < m_MaxSensor; ++i) {
@@ -59,6 +86,89 @@ void Vehicle::Update(float dt) {
 	for (i = 0; i < m_MaxActuator; ++i) {
 		m_Actuators[i]->Update(dt);
 	}
+
+	// a busy lazy brain updated in full for a while; its change flags went stale meanwhile,
+	// so it evaluates every node again before it skips any
+	if (mbLazy) {
+		mEvaluated += m_MaxActuator;
+		for (i = 0; i < m_MaxSensor; ++i) {
+			mEvaluated += m_Sensors[i]->mbInternalSensor ? 1 : 0;
+		}
+		if (--mFullUpdates == 0) {
+			mbPrimed = false;
+			mbQuiet = false;
+		}
+	}
+}
+
+void Vehicle::UpdateLazily(float dt) {
+	int i;
+	// the senses are fresh, so note which of them changed before anything reads them
+	bool sensesChanged = false;
+	int nodes = m_MaxActuator;
+	for (i = 0; i < m_MaxSensor; ++i) {
+		if (!m_Sensors[i]->mbInternalSensor) {
+			sensesChanged |= m_Sensors[i]->Propagate(mEpsilon);
+		}
+		else {
+			++nodes;
+		}
+	}
+
+	// nothing was evaluated last time, and nothing new has been sensed, so nothing would be now
+	if (mbQuiet && !sensesChanged) {
+		mSkipped += nodes;
+		return;
+	}
+
+	long long evaluated = mEvaluated;
+
+	// a function reading one later in the list sees its change flag from the last update,
+	// just as it sees its output from then
+	for (i = 0; i < m_MaxSensor; ++i) {
+		Sensor* pSensor = m_Sensors[i];
+		if (!pSensor->mbInternalSensor)
+			continue;
+		if (mbPrimed && !pSensor->InputsChanged() && pSensor->IsSettled(mEpsilon, dt)) {
+			pSensor->mbChanged = false;
+			++mSkipped;
+			continue;
+		}
+		pSensor->Update(dt);
+		pSensor->PropagateOutputs(mEpsilon);
+		++mEvaluated;
+
+		// until the brain is primed, what was last passed on may not be what a node earlier in
+		// the list read, so its readers look again next time
+		if (!mbPrimed) {
+			pSensor->mbChanged = true;
+		}
+	}
+
+	for (i = 0; i < m_MaxActuator; ++i) {
+		if (mbPrimed && !m_Actuators[i]->InputsChanged()) {
+			++mSkipped;
+			continue;
+		}
+		m_Actuators[i]->Update(dt);
+		++mEvaluated;
+	}
+	mbQuiet = mbPrimed && mEvaluated == evaluated;
+
+	// a brain whose every node changes, update after update, pays for the bookkeeping and
+	// skips nothing, so it is updated in full for a while, twice as long each time it is
+	// still busy when it tries skipping again
+	bool busy = mbPrimed && mEvaluated - evaluated == nodes;
+	mBusyUpdates = busy ? mBusyUpdates + 1 : 0;
+	if (mbPrimed && !busy) {
+		mFullPeriod = kMinFullUpdates;
+	}
+	else if (mBusyUpdates >= kBusyUpdates) {
+		mBusyUpdates = 0;
+		mFullUpdates = mFullPeriod;
+		mFullPeriod = PMath::Min(2 * mFullPeriod, (int) kMaxFullUpdates);
+	}
+	mbPrimed = true;
 }
 
 